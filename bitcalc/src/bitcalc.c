@@ -29,6 +29,8 @@
 
 #include "common.h"
 #include "bitmap.h"
+#include "topology.h"
+#include "trace.h"
 
 #include <getopt.h>
 #include <stdio.h>
@@ -37,9 +39,18 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sys/sysinfo.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 
 #define BITMAP_STACK_GROW_SIZE 10
 
+/* Number of batch jobs that may be read ahead of the oldest job whose
+ * result has not been printed yet */
+#define BATCH_WINDOW 1024
+
 enum bitmap_format_t {
 	format_mask,
 	format_list,
@@ -48,9 +59,84 @@ enum bitmap_format_t {
 
 static enum bitmap_format_t display_format = format_mask;
 
-static struct bitmap_t **bitmap_stack = NULL;
-static size_t bitmap_stack_depth = 0;
-static size_t bitmap_stack_depth_max = 0;
+/* Kinds of tokens, as counted by --stats and traced by bitcalc:token */
+enum calc_op_t {
+	op_list,
+	op_nr_bits,
+	op_mask,
+	op_topology,
+	op_siblings,
+	op_and,
+	op_xor,
+	op_subset,
+	op_equal,
+	op_intersects,
+	op_empty,
+	op_print_bit_count,
+	nr_calc_ops
+};
+
+static const char *const calc_op_name[nr_calc_ops] = {
+	[op_list] = "list",
+	[op_nr_bits] = "nr bits",
+	[op_mask] = "mask",
+	[op_topology] = "topology",
+	[op_siblings] = "siblings",
+	[op_and] = "and",
+	[op_xor] = "xor",
+	[op_subset] = "subset",
+	[op_equal] = "equal",
+	[op_intersects] = "intersects",
+	[op_empty] = "empty",
+	[op_print_bit_count] = "print-bit-count"
+};
+
+struct calc_stats_t {
+	unsigned long count[nr_calc_ops];
+	uint64_t ns[nr_calc_ops];
+	size_t peak_depth;
+};
+
+static int option_stats = 0;
+
+/* Totals of all evaluation stacks, batch jobs add theirs when done */
+static struct calc_stats_t total_stats;
+
+/* Evaluation state of one script. The command line and --file share one,
+ * each batch job gets its own. */
+struct calc_t {
+	struct bitmap_t **stack;
+	size_t depth;
+	size_t depth_max;
+	FILE *out;
+
+	/* Result of the last predicate, -1 if none has been evaluated. The
+	 * result is also pushed, and printed with the rest of the stack
+	 * unless testing. */
+	int test_result;
+	int testing;
+
+	struct calc_stats_t stats;
+};
+
+struct batch_slot_t {
+	char *line;
+	char *result;
+	int done;
+};
+
+/* Jobs are numbered in input order. Slot seq % BATCH_WINDOW holds job seq,
+ * which is the reorder buffer the results are printed from. */
+struct batch_t {
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t slot_done;
+	struct batch_slot_t slots[BATCH_WINDOW];
+	size_t next_read;
+	size_t next_take;
+	size_t next_print;
+	int eof;
+};
 
 static char *bitmap_str(const struct bitmap_t *set)
 {
@@ -71,46 +157,53 @@ static char *bitmap_str(const struct bitmap_t *set)
 	return str;
 }
 
-static void push_bitmap(struct bitmap_t *entry)
+static void push_bitmap(struct calc_t *calc, struct bitmap_t *entry)
 {
-	if (option_verbose > 2) {
+	/* Formatting the mask is expensive, only do it when asked for */
+	if (option_verbose > 3) {
 		char *mask = bitmap_str(entry);
 		debug("Pushing bitmap: %s\n", mask);
 		free(mask);
 	}
 
-	if (bitmap_stack_depth_max <= bitmap_stack_depth) {
-		bitmap_stack =
-		    checked_realloc(bitmap_stack,
-				    BITMAP_STACK_GROW_SIZE *
-				    sizeof(*bitmap_stack));
-		bitmap_stack_depth_max += BITMAP_STACK_GROW_SIZE;
+	if (calc->depth_max <= calc->depth) {
+		calc->depth_max += BITMAP_STACK_GROW_SIZE;
+		calc->stack = checked_realloc(calc->stack,
+					      calc->depth_max *
+					      sizeof(*calc->stack));
 	}
 
-	bitmap_stack[bitmap_stack_depth] = entry;
-	bitmap_stack_depth++;
+	calc->stack[calc->depth] = entry;
+	calc->depth++;
+	if (calc->depth > calc->stats.peak_depth)
+		calc->stats.peak_depth = calc->depth;
+
+	trace_event(push, calc->depth, bitmap_nr_bits(entry));
 }
 
-static struct bitmap_t *pop_bitmap(void)
+static struct bitmap_t *pop_bitmap(struct calc_t *calc)
 {
-	if (bitmap_stack_depth == 0)
+	if (calc->depth == 0)
 		return NULL;
 
-	bitmap_stack_depth--;
+	calc->depth--;
 
-	if (option_verbose > 2) {
-		char *mask = bitmap_str(bitmap_stack[bitmap_stack_depth]);
+	if (option_verbose > 3) {
+		char *mask = bitmap_str(calc->stack[calc->depth]);
 		debug("Popping bitmap: %s\n", mask);
 		free(mask);
 	}
 
-	return bitmap_stack[bitmap_stack_depth];
+	trace_event(pop, calc->depth, bitmap_nr_bits(calc->stack[calc->depth]));
+
+	return calc->stack[calc->depth];
 }
 
 static void execute_void_unary_operator(
+	struct calc_t *calc,
 	const char *token,
 	const char *name,
-	void (*func) (struct bitmap_t * first)
+	void (*func) (struct calc_t * calc, struct bitmap_t * first)
     )
 {
 	struct bitmap_t *first;
@@ -118,15 +211,36 @@ static void execute_void_unary_operator(
 	parse_scope = name;
 	debug("%s: Identified as %s", token, name);
 
-	if (bitmap_stack_depth < 1)
+	if (calc->depth < 1)
 		fail("Need one value, but none available");
 
-	first = pop_bitmap();
-	func(first);
+	first = pop_bitmap(calc);
+	func(calc, first);
+	bitmap_free(first);
+}
+
+static void execute_unary_operator(
+	struct calc_t *calc,
+	const char *token,
+	const char *name,
+	struct bitmap_t *(*func) (const struct bitmap_t *first)
+    )
+{
+	struct bitmap_t *first;
+
+	parse_scope = name;
+	debug("%s: Identified as %s", token, name);
+
+	if (calc->depth < 1)
+		fail("Need one value, but none available");
+
+	first = pop_bitmap(calc);
+	push_bitmap(calc, func(first));
 	bitmap_free(first);
 }
 
 static void execute_binary_operator(
+	struct calc_t *calc,
 	const char *token,
 	const char *name,
 	struct bitmap_t *(*func) (struct bitmap_t *first,
@@ -140,15 +254,50 @@ static void execute_binary_operator(
 	parse_scope = name;
 	debug("%s: Identified as %s", token, name);
 
-	if (bitmap_stack_depth < 2)
-		fail("Need two values, but %zu available", bitmap_stack_depth);
+	if (calc->depth < 2)
+		fail("Need two values, but %zu available", calc->depth);
 
-	first = pop_bitmap();
-	second = pop_bitmap();
+	first = pop_bitmap(calc);
+	second = pop_bitmap(calc);
 	result = func(first, second);
 	bitmap_free(first);
 	bitmap_free(second);
-	push_bitmap(result);
+	push_bitmap(calc, result);
+}
+
+static void execute_predicate(
+	struct calc_t *calc,
+	const char *token,
+	const char *name,
+	int (*unary) (const struct bitmap_t * set),
+	int (*binary) (const struct bitmap_t * first,
+		       const struct bitmap_t * second)
+    )
+{
+	struct bitmap_t *first;
+	struct bitmap_t *second = NULL;
+	const size_t nr_args = (binary != NULL) ? 2 : 1;
+
+	parse_scope = name;
+	debug("%s: Identified as %s", token, name);
+
+	if (calc->depth < nr_args)
+		fail("Need %zu value%s, but %zu available", nr_args,
+		     (nr_args == 1) ? "" : "s", calc->depth);
+
+	first = pop_bitmap(calc);
+	if (binary != NULL) {
+		/* The operand pushed first is the left hand side */
+		second = pop_bitmap(calc);
+		calc->test_result = binary(second, first);
+		bitmap_free(second);
+	} else {
+		calc->test_result = unary(first);
+	}
+	bitmap_free(first);
+
+	push_bitmap(calc,
+		    bitmap_alloc_from_u32_list(calc->test_result ? "1" : "0"));
 }
 
 static size_t str_to_int_hex(const char *value)
@@ -168,70 +317,341 @@ static size_t str_to_int_hex(const char *value)
 	return val;
 }
 
-static void print_bitmap_bit_count(struct bitmap_t *set)
+static void print_bitmap_bit_count(struct calc_t *calc, struct bitmap_t *set)
 {
 	const size_t count = bitmap_bit_count(set);
-	printf("%zu", count);
+	fprintf(calc->out, "%zu", count);
 }
 
-static void execute_token(const char *token)
+static enum calc_op_t execute_token_op(struct calc_t *calc, const char *token)
 {
+	enum calc_op_t op;
+
 	if (*token == '#') {
 		/* Token contains ",", assume it is a list of u32
 		 * hexadecimal values */
+		op = op_list;
 		parse_scope = "list";
 		debug("%s: Identified as %s", token, parse_scope);
-		push_bitmap(bitmap_alloc_from_list(&token[1]));
+		push_bitmap(calc, bitmap_alloc_from_list(&token[1]));
 	} else if (*token == '&') {
+		op = op_nr_bits;
 		parse_scope = "nr bits";
 		debug("%s: Identified as %s", token, parse_scope);
-		push_bitmap(bitmap_alloc_nr_bits(str_to_int_hex(&token[1])));
+		push_bitmap(calc,
+			    bitmap_alloc_nr_bits(str_to_int_hex(&token[1])));
+	} else if (*token == '@') {
+		op = op_topology;
+		parse_scope = "topology";
+		debug("%s: Identified as %s", token, parse_scope);
+		push_bitmap(calc, topology_alloc_mask(&token[1]));
+	} else if (strcmp(token, "siblings") == 0) {
+		op = op_siblings;
+		execute_unary_operator(calc, token, "unary operator 'siblings'",
+				       topology_siblings);
 	} else if (strcmp(token, "and") == 0) {
-		execute_binary_operator(token, "binary operator 'and'",
+		op = op_and;
+		execute_binary_operator(calc, token, "binary operator 'and'",
 					bitmap_and);
 	} else if (strcmp(token, "xor") == 0) {
-		execute_binary_operator(token, "binary operator 'xor'",
+		op = op_xor;
+		execute_binary_operator(calc, token, "binary operator 'xor'",
 					bitmap_xor);
+	} else if (strcmp(token, "subset") == 0) {
+		op = op_subset;
+		execute_predicate(calc, token, "predicate 'subset'",
+				  NULL, bitmap_is_subset);
+	} else if (strcmp(token, "equal") == 0) {
+		op = op_equal;
+		execute_predicate(calc, token, "predicate 'equal'",
+				  NULL, bitmap_is_equal);
+	} else if (strcmp(token, "intersects") == 0) {
+		op = op_intersects;
+		execute_predicate(calc, token, "predicate 'intersects'",
+				  NULL, bitmap_intersects);
+	} else if (strcmp(token, "empty") == 0) {
+		op = op_empty;
+		execute_predicate(calc, token, "predicate 'empty'",
+				  bitmap_is_empty, NULL);
 	} else if (strcmp(token, "print-bit-count") == 0) {
-		execute_void_unary_operator(token,
+		op = op_print_bit_count;
+		execute_void_unary_operator(calc, token,
 					"unary operator 'print-bit-count'",
 					print_bitmap_bit_count);
 	} else {
+		op = op_mask;
 		parse_scope = "mask or u32 list";
 		debug("%s: Identified as %s", token, parse_scope);
-		push_bitmap(bitmap_alloc_from_u32_list(token));
+		push_bitmap(calc, bitmap_alloc_from_u32_list(token));
 	}
 
 	parse_scope = NULL;
+
+	return op;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
 }
 
-static void execute_string(const char *const_str)
+static void execute_token(struct calc_t *calc, const char *token)
+{
+	const int timed = option_stats || trace_event_enabled(token);
+	const uint64_t start = timed ? now_ns() : 0;
+	const enum calc_op_t op = execute_token_op(calc, token);
+	uint64_t duration;
+
+	if (!timed)
+		return;
+
+	duration = now_ns() - start;
+	calc->stats.count[op]++;
+	calc->stats.ns[op] += duration;
+	trace_event(token, op, calc->depth,
+		    (calc->depth > 0) ?
+		    bitmap_nr_bits(calc->stack[calc->depth - 1]) : 0,
+		    duration);
+}
+
+static void execute_string(struct calc_t *calc, const char *const_str)
 {
 	char *str = strdup(const_str);
 	char *token;
+	char *save;
 
 	if (str == NULL)
 		fail("Out of memory, aborting");
 
-	for (token = strtok(str, " \n\r\t");
-	     token != NULL; token = strtok(NULL, " \n\r\t"))
-		execute_token(token);
+	for (token = strtok_r(str, " \n\r\t", &save);
+	     token != NULL; token = strtok_r(NULL, " \n\r\t", &save))
+		execute_token(calc, token);
 
 	free(str);
 }
 
-static void execute_stream(FILE * stream)
+static void execute_stream(struct calc_t *calc, FILE * stream)
 {
 	char *token;
 	int nr_matches;
 
 	for (nr_matches = fscanf(stream, "%ms ", &token);
 	     nr_matches == 1; nr_matches = fscanf(stream, "%ms ", &token)) {
-		execute_token(token);
+		execute_token(calc, token);
 		free(token);
 	}
 }
 
+/* Pop and print everything left on the stack, top first, on one line */
+static void print_stack(struct calc_t *calc)
+{
+	struct bitmap_t *item;
+	int first = 1;
+
+	for (item = pop_bitmap(calc); item != NULL; item = pop_bitmap(calc)) {
+		char *const bitmap = bitmap_str(item);
+		fprintf(calc->out, "%s%s", first ? "" : " ", bitmap);
+		free(bitmap);
+		bitmap_free(item);
+		first = 0;
+	}
+
+	if (first == 0)
+		fputc('\n', calc->out);
+}
+
+static void add_stats(struct calc_stats_t *total,
+		      const struct calc_stats_t *stats)
+{
+	int op;
+
+	for (op = 0; op < nr_calc_ops; op++) {
+		total->count[op] += stats->count[op];
+		total->ns[op] += stats->ns[op];
+	}
+	if (stats->peak_depth > total->peak_depth)
+		total->peak_depth = stats->peak_depth;
+}
+
+static void print_stats(void)
+{
+	struct bitmap_alloc_stats_t alloc;
+	int op;
+
+	bitmap_get_alloc_stats(&alloc);
+
+	flockfile(stderr);
+	fprintf(stderr, "%-16s %10s %14s %10s\n", "operator", "count",
+		"total ns", "avg ns");
+	for (op = 0; op < nr_calc_ops; op++) {
+		const unsigned long count = total_stats.count[op];
+
+		if (count == 0)
+			continue;
+		fprintf(stderr, "%-16s %10lu %14" PRIu64 " %10" PRIu64 "\n",
+			calc_op_name[op], count, total_stats.ns[op],
+			total_stats.ns[op] / count);
+	}
+	fprintf(stderr, "Peak stack depth: %zu\n", total_stats.peak_depth);
+	fprintf(stderr, "Bitmaps allocated: %zu, %zu spilled to heap, %zu bytes\n",
+		alloc.nr_bitmaps, alloc.nr_spilled, alloc.nr_bytes);
+	funlockfile(stderr);
+}
+
+/* Evaluate one batch line on a private stack, and return everything it
+ * printed. The result always ends with a newline, so that there is one
+ * output line per input line. */
+static char *batch_evaluate(const char *line, struct calc_stats_t *stats)
+{
+	struct calc_t calc = { NULL, 0, 0, NULL, -1, 0, { { 0 }, { 0 }, 0 } };
+	char *result = NULL;
+	size_t size;
+
+	calc.out = open_memstream(&result, &size);
+	if (calc.out == NULL)
+		fail("Failed to open memory stream: %s", strerror(errno));
+
+	execute_string(&calc, line);
+	print_stack(&calc);
+
+	if (fclose(calc.out) != 0)
+		fail("Failed to close memory stream: %s", strerror(errno));
+	free(calc.stack);
+	*stats = calc.stats;
+
+	if (size == 0 || result[size - 1] != '\n') {
+		result = checked_realloc(result, size + 2);
+		result[size] = '\n';
+		result[size + 1] = '\0';
+	}
+
+	return result;
+}
+
+static void *batch_worker(void *arg)
+{
+	struct batch_t *const batch = arg;
+
+	pthread_mutex_lock(&batch->lock);
+	for (;;) {
+		struct batch_slot_t *slot;
+		struct calc_stats_t stats;
+		char *result;
+
+		while (batch->next_take == batch->next_read && !batch->eof)
+			pthread_cond_wait(&batch->work_ready, &batch->lock);
+		if (batch->next_take == batch->next_read)
+			break;
+
+		slot = &batch->slots[batch->next_take % BATCH_WINDOW];
+		batch->next_take++;
+
+		pthread_mutex_unlock(&batch->lock);
+		result = batch_evaluate(slot->line, &stats);
+		pthread_mutex_lock(&batch->lock);
+
+		add_stats(&total_stats, &stats);
+
+		slot->result = result;
+		slot->done = 1;
+		pthread_cond_signal(&batch->slot_done);
+	}
+	pthread_mutex_unlock(&batch->lock);
+
+	return NULL;
+}
+
+/*
+ * Evaluate each line of stream as an independent script on a pool of
+ * nr_workers threads. The reading thread keeps up to BATCH_WINDOW jobs in
+ * flight and prints the results in input order as they complete.
+ */
+static void execute_batch(FILE *stream, unsigned int nr_workers)
+{
+	static struct batch_t batch = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.work_ready = PTHREAD_COND_INITIALIZER,
+		.slot_done = PTHREAD_COND_INITIALIZER
+	};
+	pthread_t *const workers = checked_malloc(nr_workers * sizeof(*workers));
+	char *line = NULL;
+	size_t line_size = 0;
+	unsigned int worker;
+	int ret;
+
+	batch.next_read = batch.next_take = batch.next_print = 0;
+	batch.eof = 0;
+
+	debug("Starting %u batch worker%s", nr_workers,
+	      (nr_workers == 1) ? "" : "s");
+	for (worker = 0; worker < nr_workers; worker++) {
+		ret = pthread_create(&workers[worker], NULL, batch_worker,
+				     &batch);
+		if (ret != 0)
+			fail("Failed to create batch worker: %s",
+			     strerror(ret));
+	}
+
+	pthread_mutex_lock(&batch.lock);
+	for (;;) {
+		struct batch_slot_t *slot;
+		char *result;
+
+		while (!batch.eof &&
+		       batch.next_read - batch.next_print < BATCH_WINDOW) {
+			ssize_t len;
+
+			pthread_mutex_unlock(&batch.lock);
+			len = getline(&line, &line_size, stream);
+			pthread_mutex_lock(&batch.lock);
+
+			if (len == -1) {
+				batch.eof = 1;
+				pthread_cond_broadcast(&batch.work_ready);
+				break;
+			}
+
+			slot = &batch.slots[batch.next_read % BATCH_WINDOW];
+			slot->line = line;
+			slot->result = NULL;
+			slot->done = 0;
+			line = NULL;
+			line_size = 0;
+			batch.next_read++;
+			pthread_cond_signal(&batch.work_ready);
+		}
+
+		if (batch.eof && batch.next_print == batch.next_read)
+			break;
+
+		slot = &batch.slots[batch.next_print % BATCH_WINDOW];
+		while (!slot->done)
+			pthread_cond_wait(&batch.slot_done, &batch.lock);
+		result = slot->result;
+		free(slot->line);
+		slot->line = NULL;
+		slot->result = NULL;
+		batch.next_print++;
+
+		pthread_mutex_unlock(&batch.lock);
+		fputs(result, stdout);
+		free(result);
+		pthread_mutex_lock(&batch.lock);
+	}
+	pthread_mutex_unlock(&batch.lock);
+
+	free(line);
+	for (worker = 0; worker < nr_workers; worker++)
+		pthread_join(workers[worker], NULL);
+	free(workers);
+
+	debug("Batch finished, %zu job%s", batch.next_read,
+	      (batch.next_read == 1) ? "" : "s");
+}
+
 /*****************************************************************************
  * This is the man page using POD text format.
  *
@@ -269,6 +689,17 @@ that should be set. The most common use case would be to create a mask
 out of the number of bits. Example:
     &13
 
+@B<topology> where B<topology> names a CPU set read from the sysfs, see
+B<--sysfs>. The topology is read once, on first use. Supported names:
+    @online, @possible, @isolated  CPU sets of the system
+    @node<N>                       CPUs of NUMA node N
+    @package<N>                    CPUs with physical package id N
+    @core<N>                       CPU N and its SMT siblings
+    @llc<N>                        CPUs sharing the last level cache with CPU N
+
+The unary operator B<siblings> expands a mask to whole cores, by adding
+the SMT siblings of every online CPU in it.
+
 The scripts are written in postfix notation, which means that all
 parameters are given first, then the operator. For a binary operator,
 there are two arguments, and for a unary operator there is one
@@ -276,6 +707,12 @@ argument. The operator will concume the number of arguments it needs,
 leaving any extra on the stack, and place the resulting mask in their
 place.
 
+The predicates B<subset>, B<equal>, B<intersects> and B<empty> consume
+their arguments and push the mask 1 if true, 0 if false. B<A B subset> is true
+when every bit in B<A> is also set in B<B>. They compare the masks word
+by word without building intermediate masks, and are meant to be used
+with B<--test>.
+
 =head1 OPTIONS
 
 B<bitcalc> will execute each option as it appears on the command line, so
@@ -285,7 +722,8 @@ scripts in files and scripts given on the ommand line.
 Note however that only the last --format or -F will take effect.
 
 B<-v,--verbose>
-       Produce informational message to stderr
+       Produce informational message to stderr. Give it four times to also
+       see every mask pushed on and popped from the stack.
 
 B<-V,--version>
        Show version information and exit
@@ -300,8 +738,42 @@ B<-F, --format=FORMAT>
        Set output format for bitmasks. Must be one of: 'mask', 'list', 'u32list'.
        Default: 'list'
 
+B<-b, --batch=FILE>
+       Evaluate each line of FILE, or stdin if FILE is '-', as an
+       independent script with its own stack. Lines are evaluated in
+       parallel and exactly one result line is printed per input line, in
+       input order. Batches are run after all other arguments have been
+       handled, so the last --format applies. An error on any line aborts
+       bitcalc.
+
+B<-j, --jobs=N>
+       Number of threads used to evaluate batch lines.
+       Default: the number of online CPUs
+
+B<-s, --sysfs=DIR>
+       Read the topology for @ tokens from DIR instead of
+       /sys/devices/system. Give it before any script using @ tokens.
+
+B<-S, --stats>
+       At exit, print to stderr how many tokens of each kind were
+       evaluated and the time spent on them, the peak stack depth, and how
+       many bitmaps were allocated. Batch jobs are included.
+
+B<-t, --test>
+       Do not print anything. Exit with status 0 if the last predicate
+       evaluated was true, 1 if it was false, and 2 on errors. Give it
+       before any script, so that errors in the script are reported with
+       status 2. The batch results are not affected.
+
 B<SCRIPT> Execute commands given on the command line. Note that you need to enclose the script code in '' (single quote characters).
 
+=head1 TRACING
+
+When built with lttng-ust, bitcalc has the tracepoints B<bitcalc:push> and
+B<bitcalc:pop> with the stack depth and mask width, and B<bitcalc:token>
+with the kind of token, stack depth, width of the result and the time it
+took. Without lttng-ust they are compiled out.
+
 =head1 EXAMPLE
 
 B<bitcalc '#0-3 #4-6 xor'>
@@ -327,6 +799,15 @@ B<echo xor | bitcalc 0xfe 0xfe00 -vv --file=->
 
 Enable debug message when handling the --file argument.
 
+B<bitcalc -Flist -j8 --batch=masks.txt>
+
+Evaluate every line of masks.txt on 8 threads, printing one list per line.
+
+B<if bitcalc --test $cpumask $rt_mask subset; then ...>
+
+Check that all CPUs in $cpumask are part of $rt_mask, whatever the number
+of CPUs.
+
 =head1 AUTHOR
 
 Mats Liljegren, Enea Software AB
@@ -379,25 +860,54 @@ static void usage(void)
 	     "The script contains a list of tokens, where a token is either a constant or a\n"
 	     "binary operator. Constants can be of two types, lists or masks. A list starts\n"
 	     "with hash character '#', and then a comma separate list of ranges. A mask is\n"
-	     "simply a hexadecimal value, optionally prefixed with 0x.\n"
+	     "simply a hexadecimal value, optionally prefixed with 0x. A topology mask starts\n"
+	     "with '@', see below.\n"
 	     "The following binary operators are supported, the script syntax and corresponding\n"
 	     "C syntax:\n"
 	     "  bitwise and:    1 2 and      1 & 2\n"
 	     "  bitwise xor:    1 2 xor      1 ^ 2\n"
+	     "The following predicates push 1 if true and 0 if false:\n"
+	     "  subset:         1 2 subset       (1 & ~2) == 0\n"
+	     "  equal:          1 2 equal        1 == 2\n"
+	     "  intersects:     1 2 intersects   (1 & 2) != 0\n"
+	     "  empty:          1 empty          1 == 0\n"
+	     "The following topology masks are read from the sysfs:\n"
+	     "  @online, @possible, @isolated  CPU sets of the system\n"
+	     "  @node<N>                       CPUs of NUMA node N\n"
+	     "  @package<N>                    CPUs of physical package N\n"
+	     "  @core<N>                       CPU N and its SMT siblings\n"
+	     "  @llc<N>                        CPUs sharing last level cache with CPU N\n"
+	     "The unary operator 'siblings' expands a mask to whole cores.\n"
 	     "\n"
 	     "Options:\n"
 	     "-V, version           Show version information and exit.\n"
 	     "-h, help              Print this help text and exit.\n"
-	     "-v, verbose           Produce informational message to stderr. Can be given"
-	     "                      multiple times for more verbosity.\n"
+	     "-v, verbose           Produce informational message to stderr. Can be given\n"
+	     "                      multiple times for more verbosity, four times also\n"
+	     "                      shows every mask pushed and popped.\n"
 	     "-f, --file=<script>   Execute file <script>, '-' means stdin.\n"
 	     "-F, --format=<format> Set output format. One of 'mask', 'list', \n"
 	     "                      and 'u32list'.\n"
 	     "                      Default: 'mask'\n"
+	     "-b, --batch=<file>    Evaluate each line of <file> as an independent script\n"
+	     "                      and print one result line per input line, '-' means\n"
+	     "                      stdin. Batches run after all other arguments.\n"
+	     "-j, --jobs=<n>        Number of threads evaluating batch lines.\n"
+	     "                      Default: number of online CPUs\n"
+	     "-s, --sysfs=<dir>     Read topology from <dir> instead of\n"
+	     "                      " TOPOLOGY_DEFAULT_ROOT ". Give it before any script.\n"
+	     "-S, --stats           Print per operator counts and time, peak stack depth\n"
+	     "                      and bitmap allocations to stderr at exit.\n"
+	     "-t, --test            Print nothing, exit with 0 if the last predicate was\n"
+	     "                      true, 1 if false and 2 on errors. Give it before any\n"
+	     "                      script.\n"
 	     "\n"
 	     "Example:\n"
 	     "   bitcalc '#1-2,4-5 #2-4 xor'\n"
-	     "   echo '#1-2,4-5 #2-4 xor' | bitcalc --file=-\n");
+	     "   echo '#1-2,4-5 #2-4 xor' | bitcalc --file=-\n"
+	     "   bitcalc -j4 --batch=masks.txt\n"
+	     "   bitcalc --test 0x6 0xe subset && echo 'within'\n"
+	     "   bitcalc -Flist '@node0 @core0 siblings xor'\n");
 }
 
 static void version(void)
@@ -419,13 +929,24 @@ int main(int argc, char *argv[])
 		{"version", no_argument, NULL, 'V'},
 		{"file", required_argument, NULL, 'f'},
 		{"format", required_argument, NULL, 'F'},
+		{"batch", required_argument, NULL, 'b'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"test", no_argument, NULL, 't'},
+		{"sysfs", required_argument, NULL, 's'},
+		{"stats", no_argument, NULL, 'S'},
 		{NULL, 0, NULL, '\0'}
 	};
-	static const char short_options[] = "-hvVf:F:";
+	static const char short_options[] = "-hvVf:F:b:j:ts:S";
 	int c;
-	struct bitmap_t *item;
 	FILE *stream;
-	int first;
+	struct calc_t calc = { NULL, 0, 0, NULL, -1, 0, { { 0 }, { 0 }, 0 } };
+	const char **batch_files = NULL;
+	size_t nr_batch_files = 0;
+	size_t batch_file;
+	unsigned int nr_jobs = 0;
+	char *check;
+
+	calc.out = stdout;
 
 	while ((c = getopt_long(argc, argv, short_options, long_options,
 				NULL)) != -1) {
@@ -442,13 +963,13 @@ int main(int argc, char *argv[])
 		case 'f':
 			if (strcmp(optarg, "-") == 0) {
 				debug("<stdin>: Executing script");
-				execute_stream(stdin);
+				execute_stream(&calc, stdin);
 			} else {
 				debug("%s: Executing script", optarg);
 				stream = fopen(optarg, "r");
 				if (stream == NULL)
 					fail("%s: Error opening file for reading: %s", optarg, strerror(errno));
-				execute_stream(stream);
+				execute_stream(&calc, stream);
 				if (fclose(stream) == -1)
 					fail("%s: Error closing stream: %s",
 					     optarg, strerror(errno));
@@ -465,8 +986,30 @@ int main(int argc, char *argv[])
 				fail("%s: %s is an unknown format",
 				     argv[optind], optarg);
 			break;
+		case 'b':
+			batch_files = checked_realloc(batch_files,
+						      (nr_batch_files + 1) *
+						      sizeof(*batch_files));
+			batch_files[nr_batch_files++] = optarg;
+			break;
+		case 'j':
+			nr_jobs = (unsigned int)strtoul(optarg, &check, 0);
+			if (optarg[0] == '\0' || check[0] != '\0' ||
+			    nr_jobs == 0)
+				fail("%s: Not a valid number of jobs", optarg);
+			break;
+		case 's':
+			topology_set_root(optarg);
+			break;
+		case 'S':
+			option_stats = 1;
+			break;
+		case 't':
+			calc.testing = 1;
+			fail_exit_status = 2;
+			break;
 		case 1:
-			execute_string(optarg);
+			execute_string(&calc, optarg);
 			break;
 		case '?':
 			exit(1);
@@ -479,19 +1022,52 @@ int main(int argc, char *argv[])
 		fail("%s: Unexpected argument", argv[optind]);
 
 	debug("Calculations finished successfully, %zu item%s in stack",
-	      bitmap_stack_depth, (bitmap_stack_depth == 1) ? "" : "s");
-	first = 1;
-	for (item = pop_bitmap(); item != NULL; item = pop_bitmap()) {
-		char *const bitmap = bitmap_str(item);
-		printf("%s%s", first ? "" : " ", bitmap);
-		bitmap_free(item);
-		first = 0;
+	      calc.depth, (calc.depth == 1) ? "" : "s");
+
+	/* The test result only covers the script, batches are run and
+	 * printed as usual */
+	if (calc.testing) {
+		struct bitmap_t *item;
+
+		if (calc.test_result == -1)
+			fail("--test given, but no predicate was evaluated");
+		for (item = pop_bitmap(&calc); item != NULL;
+		     item = pop_bitmap(&calc))
+			bitmap_free(item);
+		debug("Test result: %s", calc.test_result ? "true" : "false");
+	} else {
+		print_stack(&calc);
 	}
+	assert(calc.depth == 0);
+	free(calc.stack);
+	add_stats(&total_stats, &calc.stats);
 
-	if (first == 0)
-		putchar('\n');
+	if (nr_jobs == 0)
+		nr_jobs = (unsigned int)get_nprocs();
+
+	for (batch_file = 0; batch_file < nr_batch_files; batch_file++) {
+		const char *const name = batch_files[batch_file];
+
+		if (strcmp(name, "-") == 0) {
+			debug("<stdin>: Executing batch");
+			execute_batch(stdin, nr_jobs);
+			continue;
+		}
+
+		debug("%s: Executing batch", name);
+		stream = fopen(name, "r");
+		if (stream == NULL)
+			fail("%s: Error opening file for reading: %s", name,
+			     strerror(errno));
+		execute_batch(stream, nr_jobs);
+		if (fclose(stream) == -1)
+			fail("%s: Error closing stream: %s", name,
+			     strerror(errno));
+	}
+	free(batch_files);
 
-	assert(bitmap_stack_depth == 0);
+	if (option_stats)
+		print_stats();
 
-	return 0;
+	return (calc.testing && !calc.test_result) ? 1 : 0;
 }
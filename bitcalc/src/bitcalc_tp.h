@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * LTTng-UST tracepoint provider for bitcalc. Only included when HAVE_LTTNG
+ * is defined, use trace.h.
+ */
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER bitcalc
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "./bitcalc_tp.h"
+
+#if !defined(BITCALC_TP_H) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define BITCALC_TP_H
+
+#include <lttng/tracepoint.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Bitmap pushed on or popped from an evaluation stack */
+TRACEPOINT_EVENT_CLASS(
+	bitcalc, stack,
+	TP_ARGS(size_t, depth, size_t, nr_bits),
+	TP_FIELDS(
+		ctf_integer(size_t, depth, depth)
+		ctf_integer(size_t, nr_bits, nr_bits)
+	)
+)
+
+TRACEPOINT_EVENT_INSTANCE(
+	bitcalc, stack, push,
+	TP_ARGS(size_t, depth, size_t, nr_bits)
+)
+
+TRACEPOINT_EVENT_INSTANCE(
+	bitcalc, stack, pop,
+	TP_ARGS(size_t, depth, size_t, nr_bits)
+)
+
+/* One token evaluated. op is the index in calc_op_name[] of bitcalc.c,
+ * nr_bits the width of the top of the stack afterwards. */
+TRACEPOINT_EVENT(
+	bitcalc, token,
+	TP_ARGS(unsigned int, op, size_t, depth, size_t, nr_bits,
+		uint64_t, duration_ns),
+	TP_FIELDS(
+		ctf_integer(unsigned int, op, op)
+		ctf_integer(size_t, depth, depth)
+		ctf_integer(size_t, nr_bits, nr_bits)
+		ctf_integer(uint64_t, duration_ns, duration_ns)
+	)
+)
+
+#endif
+
+#include <lttng/tracepoint-event.h>
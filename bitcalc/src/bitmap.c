@@ -44,63 +44,116 @@
 #include <ctype.h>
 #endif
 
-#define MAX(a,b) ((a) > (b)) ? (a) : (b)
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
+
+/* Bitmaps of up to BITMAP_INLINE_BITS bits keep their words in the struct,
+ * larger ones spill to the heap. Should cover NR_CPUS of the target. */
+#ifndef BITMAP_INLINE_BITS
+#define BITMAP_INLINE_BITS 1024
+#endif
+
+#define WORD_BITS 64
+#define INLINE_WORDS ((BITMAP_INLINE_BITS + WORD_BITS - 1) / WORD_BITS)
+#define CACHE_LINE_SIZE 64
+#define NR_WORDS(nr_bits) (((nr_bits) + WORD_BITS - 1) / WORD_BITS)
 
 /*
  * Dynamic sized bitmap.
  */
 struct bitmap_t {
 	/* Allocated size of bitmap */
-	size_t size_u32;
+	size_t size_words;
 
 	/* Highest bit that has been set to a value */
 	size_t size_bits;
 
-	/* The malloc'ed bitmap */
-	uint32_t *map;
+	/* Either inline_map or a cache line aligned heap allocation. Bits
+	 * from size_bits and up are always zero. */
+	uint64_t *map;
+
+	uint64_t inline_map[INLINE_WORDS]
+		__attribute__ ((aligned(CACHE_LINE_SIZE)));
 };
 
+/* Allocation totals, shared by all threads */
+static struct bitmap_alloc_stats_t alloc_stats;
+
+static void *aligned_malloc(size_t size)
+{
+	void *mem;
+
+	if (posix_memalign(&mem, CACHE_LINE_SIZE, size) != 0)
+		fail("Out of memory allocating %zu bytes\n", size);
+
+	return mem;
+}
+
 struct bitmap_t *bitmap_alloc_zero(void)
 {
-	struct bitmap_t *const set = checked_malloc(sizeof(struct bitmap_t));
+	struct bitmap_t *const set = aligned_malloc(sizeof(struct bitmap_t));
+
+	__atomic_fetch_add(&alloc_stats.nr_bitmaps, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alloc_stats.nr_bytes, sizeof(struct bitmap_t),
+			   __ATOMIC_RELAXED);
 
 	set->size_bits = 0;
-	set->size_u32 = 0;
+	set->size_words = INLINE_WORDS;
 
-	set->map = NULL;
+	set->map = set->inline_map;
+	memset(set->inline_map, 0, sizeof(set->inline_map));
 
 	return set;
 }
 
 void bitmap_free(struct bitmap_t *set)
 {
-	set->size_u32 = 0;
+	if (set->map != set->inline_map)
+		free(set->map);
+	set->size_words = 0;
 	set->size_bits = 0;
 	free(set);
 }
 
+/* Make room for nr_bits bits, new words are zeroed */
+static void bitmap_grow(size_t nr_bits, struct bitmap_t *set)
+{
+	const size_t nr_words = NR_WORDS(nr_bits);
+	size_t new_size_words;
+	uint64_t *map;
+
+	if (nr_words <= set->size_words)
+		return;
+
+	/* Double to make growing bit by bit linear */
+	new_size_words = MAX(nr_words, 2 * set->size_words);
+	map = aligned_malloc(new_size_words * sizeof(uint64_t));
+	if (set->map == set->inline_map)
+		__atomic_fetch_add(&alloc_stats.nr_spilled, 1,
+				   __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alloc_stats.nr_bytes,
+			   new_size_words * sizeof(uint64_t),
+			   __ATOMIC_RELAXED);
+	memcpy(map, set->map, set->size_words * sizeof(uint64_t));
+	memset(&map[set->size_words], 0,
+	       (new_size_words - set->size_words) * sizeof(uint64_t));
+
+	if (set->map != set->inline_map)
+		free(set->map);
+	set->map = map;
+	set->size_words = new_size_words;
+}
+
 static void bitmap_set_bit(size_t bit, int value, struct bitmap_t *set)
 {
 	if (bit >= set->size_bits) {
+		bitmap_grow(bit + 1, set);
 		set->size_bits = bit + 1;
-		if ((set->size_bits / 32) >= set->size_u32) {
-			const size_t old_size_u32 = set->size_u32;
-
-			set->size_u32 = (set->size_bits / 32) + 1;
-
-			set->map =
-			    checked_realloc(set->map,
-					    sizeof(uint32_t) * set->size_u32);
-			memset(&set->map[old_size_u32], 0,
-			       (set->size_u32 - old_size_u32)
-			       * sizeof(uint32_t));
-		}
 	}
 
 	if (value)
-		set->map[bit / 32] |= ((uint32_t) 1 << (bit % 32));
+		set->map[bit / WORD_BITS] |= ((uint64_t) 1 << (bit % WORD_BITS));
 	else
-		set->map[bit / 32] &= ~((uint32_t) 1 << (bit % 32));
+		set->map[bit / WORD_BITS] &= ~((uint64_t) 1 << (bit % WORD_BITS));
 }
 
 struct bitmap_t *bitmap_alloc_set(size_t bit)
@@ -114,20 +167,19 @@ struct bitmap_t *bitmap_alloc_set(size_t bit)
 
 struct bitmap_t *bitmap_alloc_nr_bits(size_t nr_bits)
 {
-	size_t bit;
+	size_t word;
 	struct bitmap_t *set;
 
+	set = bitmap_alloc_zero();
 	if (nr_bits == 0)
-		return bitmap_alloc_zero();
-
-	bit = nr_bits - 1;
+		return set;
 
-	set = bitmap_alloc_set(bit);
-
-	while (bit > 0) {
-		bit--;
-		bitmap_set_bit(bit, 1, set);
-	}
+	bitmap_grow(nr_bits, set);
+	set->size_bits = nr_bits;
+	for (word = 0; word < nr_bits / WORD_BITS; word++)
+		set->map[word] = ~(uint64_t) 0;
+	if ((nr_bits % WORD_BITS) != 0)
+		set->map[word] = ((uint64_t) 1 << (nr_bits % WORD_BITS)) - 1;
 
 	return set;
 }
@@ -137,18 +189,33 @@ int bitmap_isset(size_t bit, const struct bitmap_t *set)
 	if (bit >= set->size_bits)
 		return 0;
 
-	return ((set->map[bit / 32] & (uint32_t)(1 << (bit % 32))) == 0)
-		? 0 : 1;
+	return ((set->map[bit / WORD_BITS] &
+		 ((uint64_t) 1 << (bit % WORD_BITS))) == 0) ? 0 : 1;
+}
+
+size_t bitmap_nr_bits(const struct bitmap_t *set)
+{
+	return set->size_bits;
+}
+
+void bitmap_get_alloc_stats(struct bitmap_alloc_stats_t *stats)
+{
+	stats->nr_bitmaps = __atomic_load_n(&alloc_stats.nr_bitmaps,
+					    __ATOMIC_RELAXED);
+	stats->nr_spilled = __atomic_load_n(&alloc_stats.nr_spilled,
+					    __ATOMIC_RELAXED);
+	stats->nr_bytes = __atomic_load_n(&alloc_stats.nr_bytes,
+					  __ATOMIC_RELAXED);
 }
 
 size_t bitmap_bit_count(const struct bitmap_t * set)
 {
+	const size_t nr_words = NR_WORDS(set->size_bits);
 	size_t nr_bits = 0;
-	size_t bit;
+	size_t word;
 
-	for (bit = 0; bit < set->size_bits; bit++)
-		if (bitmap_isset(bit, set))
-			nr_bits++;
+	for (word = 0; word < nr_words; word++)
+		nr_bits += (size_t) __builtin_popcountll(set->map[word]);
 
 	return nr_bits;
 }
@@ -378,32 +445,129 @@ struct bitmap_t *bitmap_alloc_from_u32_list(const char *mask)
 	return set;
 }
 
-struct bitmap_t *bitmap_and(struct bitmap_t *first, struct bitmap_t *second)
+/* Combine first and second word by word. The result is as wide as the
+ * widest of them, which decides the width of its hexadecimal output. */
+enum combine_op_t {
+	combine_and,
+	combine_xor,
+	combine_or
+};
+
+static struct bitmap_t *bitmap_combine(const struct bitmap_t *first,
+				       const struct bitmap_t *second,
+				       enum combine_op_t op)
 {
 	const size_t nr_bits = MAX(first->size_bits, second->size_bits);
-	struct bitmap_t *result = bitmap_alloc_zero();
-	size_t bit;
-
-	for (bit = 0; bit < nr_bits; bit++)
-		bitmap_set_bit(bit,
-			       bitmap_isset(bit, first) & bitmap_isset(bit,
-								       second),
-			       result);
+	const size_t first_words = NR_WORDS(first->size_bits);
+	const size_t second_words = NR_WORDS(second->size_bits);
+	struct bitmap_t *const result = bitmap_alloc_zero();
+	size_t word;
+
+	bitmap_grow(nr_bits, result);
+	result->size_bits = nr_bits;
+
+	for (word = 0; word < NR_WORDS(nr_bits); word++) {
+		const uint64_t a = (word < first_words) ? first->map[word] : 0;
+		const uint64_t b = (word < second_words) ? second->map[word] : 0;
+
+		switch (op) {
+		case combine_and:
+			result->map[word] = a & b;
+			break;
+		case combine_xor:
+			result->map[word] = a ^ b;
+			break;
+		case combine_or:
+			result->map[word] = a | b;
+			break;
+		}
+	}
 
 	return result;
 }
 
+struct bitmap_t *bitmap_and(struct bitmap_t *first, struct bitmap_t *second)
+{
+	return bitmap_combine(first, second, combine_and);
+}
+
 struct bitmap_t *bitmap_xor(struct bitmap_t *first, struct bitmap_t *second)
 {
-	const size_t nr_bits = MAX(first->size_bits, second->size_bits);
-	struct bitmap_t *result = bitmap_alloc_zero();
-	size_t bit;
+	return bitmap_combine(first, second, combine_xor);
+}
+
+struct bitmap_t *bitmap_or(const struct bitmap_t *first,
+			   const struct bitmap_t *second)
+{
+	return bitmap_combine(first, second, combine_or);
+}
 
-	for (bit = 0; bit < nr_bits; bit++)
-		bitmap_set_bit(bit,
-			       bitmap_isset(bit, first) ^ bitmap_isset(bit,
-								       second),
-			       result);
+struct bitmap_t *bitmap_copy(const struct bitmap_t *set)
+{
+	struct bitmap_t *const copy = bitmap_alloc_zero();
 
-	return result;
+	bitmap_grow(set->size_bits, copy);
+	copy->size_bits = set->size_bits;
+	memcpy(copy->map, set->map,
+	       NR_WORDS(set->size_bits) * sizeof(uint64_t));
+
+	return copy;
+}
+
+/* Word of set, or zero past its end */
+static inline uint64_t bitmap_word(const struct bitmap_t *set, size_t word)
+{
+	return (word < NR_WORDS(set->size_bits)) ? set->map[word] : 0;
+}
+
+int bitmap_is_subset(const struct bitmap_t *first,
+		     const struct bitmap_t *second)
+{
+	const size_t nr_words = NR_WORDS(first->size_bits);
+	size_t word;
+
+	for (word = 0; word < nr_words; word++)
+		if ((first->map[word] & ~bitmap_word(second, word)) != 0)
+			return 0;
+
+	return 1;
+}
+
+int bitmap_is_equal(const struct bitmap_t *first,
+		    const struct bitmap_t *second)
+{
+	const size_t nr_words = NR_WORDS(MAX(first->size_bits,
+					     second->size_bits));
+	size_t word;
+
+	for (word = 0; word < nr_words; word++)
+		if (bitmap_word(first, word) != bitmap_word(second, word))
+			return 0;
+
+	return 1;
+}
+
+int bitmap_intersects(const struct bitmap_t *first,
+		      const struct bitmap_t *second)
+{
+	const size_t nr_words = NR_WORDS(first->size_bits);
+	size_t word;
+
+	for (word = 0; word < nr_words; word++)
+		if ((first->map[word] & bitmap_word(second, word)) != 0)
+			return 1;
+
+	return 0;
+}
+
+int bitmap_is_empty(const struct bitmap_t *set)
+{
+	const size_t nr_words = NR_WORDS(set->size_bits);
+	size_t word;
+
+	for (word = 0; word < nr_words; word++)
+		if (set->map[word] != 0)
+			return 0;
+
+	return 1;
 }
@@ -51,6 +51,14 @@ extern struct bitmap_t *bitmap_and(struct bitmap_t *first,
 extern struct bitmap_t *bitmap_xor(struct bitmap_t *first,
 				   struct bitmap_t *second);
 
+/* Allocate a bitmap which is the result of or'ing first and second
+ * bit masks together. */
+extern struct bitmap_t *bitmap_or(const struct bitmap_t *first,
+				  const struct bitmap_t *second);
+
+/* Allocate a copy of set. */
+extern struct bitmap_t *bitmap_copy(const struct bitmap_t *set);
+
 /* Create a bitmap_t from a string containing a list of hexadecimal
  * unsigned 32-bit values separated by commas. This format is used by some
  * files in the sysfs. */
@@ -66,6 +74,43 @@ extern int bitmap_isset(size_t bit, const struct bitmap_t *set);
 /* Return the number of bits set in bit mask. */
 extern size_t bitmap_bit_count(const struct bitmap_t *set);
 
+/* Return the width of bit mask, one more than the highest bit ever set. */
+extern size_t bitmap_nr_bits(const struct bitmap_t *set);
+
+/* Return 1 if every bit set in first is also set in second, 0 otherwise. */
+extern int bitmap_is_subset(const struct bitmap_t *first,
+			    const struct bitmap_t *second);
+
+/* Return 1 if first and second have the same bits set, 0 otherwise. */
+extern int bitmap_is_equal(const struct bitmap_t *first,
+			   const struct bitmap_t *second);
+
+/* Return 1 if first and second have at least one bit in common,
+ * 0 otherwise. */
+extern int bitmap_intersects(const struct bitmap_t *first,
+			     const struct bitmap_t *second);
+
+/* Return 1 if no bit is set in bit mask, 0 otherwise. */
+extern int bitmap_is_empty(const struct bitmap_t *set);
+
+/*
+ * Statistics
+ */
+
+struct bitmap_alloc_stats_t {
+	/* Bitmaps allocated */
+	size_t nr_bitmaps;
+
+	/* Bitmaps that outgrew their inline words */
+	size_t nr_spilled;
+
+	/* Bytes allocated for bitmaps and their spilled words */
+	size_t nr_bytes;
+};
+
+/* Get allocation totals of all threads since the process started. */
+extern void bitmap_get_alloc_stats(struct bitmap_alloc_stats_t *stats);
+
 /*
  * Modify bitmap
  */
@@ -34,12 +34,16 @@
 #include <string.h>
 
 int option_verbose = 0;
-const char *parse_scope = NULL;
+__thread const char *parse_scope = NULL;
+int fail_exit_status = EXIT_FAILURE;
 
 void std_fail(const char *format, ...)
 {
 	va_list va;
 
+	/* Keep the prefix and the message together when several threads
+	 * log at once */
+	flockfile(stderr);
 	if (parse_scope != NULL)
 		fprintf(stderr, "Error while parsing %s: ", parse_scope);
 	else
@@ -47,8 +51,9 @@ void std_fail(const char *format, ...)
 	va_start(va, format);
 	vfprintf(stderr, format, va);
 	va_end(va);
+	funlockfile(stderr);
 
-	exit(EXIT_FAILURE);
+	exit(fail_exit_status);
 }
 
 void std_info(const char *format, ...)
@@ -58,12 +63,14 @@ void std_info(const char *format, ...)
 	if (option_verbose < 1)
 		return;
 
+	flockfile(stderr);
 	if (parse_scope != NULL)
 		fprintf(stderr, "Parsing %s: ", parse_scope);
 
 	va_start(va, format);
 	vfprintf(stderr, format, va);
 	va_end(va);
+	funlockfile(stderr);
 }
 
 void std_debug(const char *format, ...)
@@ -73,12 +80,14 @@ void std_debug(const char *format, ...)
 	if (option_verbose < 2)
 		return;
 
+	flockfile(stderr);
 	if (parse_scope != NULL)
 		fprintf(stderr, "Parsing %s: ", parse_scope);
 
 	va_start(va, format);
 	vfprintf(stderr, format, va);
 	va_end(va);
+	funlockfile(stderr);
 }
 
 void *checked_malloc(size_t size)
@@ -37,8 +37,14 @@
 #define STR(x) #x
 #define STRSTR(x) STR(x)
 
+/* option_verbose is only written while parsing options, before any threads
+ * are started. parse_scope is per thread so that concurrent parsers each
+ * report their own scope. */
 extern int option_verbose;
-extern const char *parse_scope;
+extern __thread const char *parse_scope;
+
+/* Exit status used by fail() */
+extern int fail_exit_status;
 
 extern void std_fail(const char *format, ...)
 	__attribute__((format(printf, 1, 2), noreturn));
@@ -59,29 +65,31 @@ extern void *checked_realloc(void *old_alloc, size_t new_size);
 
 #ifdef HAVE_LTTNG
 
-#define fail(fmt, ...)                        \
-        do {                                    \
-            tracef("Fail: "  __FILE__ ":" STRSTR(__LINE__) ": %s(): " fmt, __func__, ##__VA_ARGS__); \
-	    DO_LOG(std_fail, fmt, ##__VA_ARGS__); \
-        } while (0)
-
-#define info(fmt, ...)                        \
-        do {                                    \
-            tracef("Info: "  __FILE__ ":" STRSTR(__LINE__) ": %s(): " fmt, __func__, ##__VA_ARGS__); \
-            DO_LOG(std_info, fmt, ##__VA_ARGS__); \
-        } while (0)
-
-#define debug(fmt, ...)                       \
-        do {                                    \
-            tracef("Debug: " __FILE__ ":" STRSTR(__LINE__) ": %s(): " fmt, __func__, ##__VA_ARGS__); \
-            DO_LOG(std_debug, fmt, ##__VA_ARGS__); \
-        } while (0)
+/* A failure is traced with its text, once before the exit. Events on the
+ * hot paths are binary tracepoints, see trace.h. */
+#define fail(fmt, ...) \
+	do { \
+		tracef("Fail: " __FILE__ ":" STRSTR(__LINE__) ": %s(): " fmt, __func__, ##__VA_ARGS__); \
+		DO_LOG(std_fail, fmt, ##__VA_ARGS__); \
+	} while (0)
 
 #else
 
 #define fail(fmt, ...) DO_LOG(std_fail, fmt, ##__VA_ARGS__)
-#define info(fmt, ...) DO_LOG(std_info, fmt, ##__VA_ARGS__)
-#define debug(fmt, ...) DO_LOG(std_debug, fmt, ##__VA_ARGS__)
 
 #endif
+
+/* info() and debug() skip the call, and the evaluation of the arguments,
+ * when their verbosity level is not enabled. They are not traced. */
+#define info(fmt, ...) \
+	do { \
+		if (option_verbose > 0) \
+			DO_LOG(std_info, fmt, ##__VA_ARGS__); \
+	} while (0)
+#define debug(fmt, ...) \
+	do { \
+		if (option_verbose > 1) \
+			DO_LOG(std_debug, fmt, ##__VA_ARGS__); \
+	} while (0)
+
 #endif
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * This file implements topology lookups from the sysfs.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "topology.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct topology_t {
+	struct bitmap_t *online;
+	struct bitmap_t *possible;
+	struct bitmap_t *isolated;
+
+	/* Indexed by CPU, NULL or -1 for CPUs that are not online */
+	size_t nr_cpus;
+	struct bitmap_t **core;
+	struct bitmap_t **llc;
+	long *package;
+
+	/* Indexed by node id, NULL for holes in the numbering */
+	size_t nr_nodes;
+	struct bitmap_t **node;
+};
+
+static const char *topology_root = TOPOLOGY_DEFAULT_ROOT;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static struct topology_t topology;
+
+void topology_set_root(const char *root)
+{
+	topology_root = root;
+}
+
+/* Return the first line of root/path without the line break, or NULL if it
+ * cannot be read. The caller frees the string. */
+static char *read_line(const char *path)
+{
+	char file[PATH_MAX];
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *stream;
+
+	snprintf(file, sizeof(file), "%s/%s", topology_root, path);
+	stream = fopen(file, "r");
+	if (stream == NULL) {
+		debug("%s: %s", file, strerror(errno));
+		return NULL;
+	}
+
+	len = getline(&line, &size, stream);
+	fclose(stream);
+	if (len == -1) {
+		free(line);
+		return NULL;
+	}
+
+	while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == ' '))
+		line[--len] = '\0';
+
+	return line;
+}
+
+/* Allocate the bitmap in CPU list file root/path, NULL if it is missing */
+static struct bitmap_t *read_list(const char *path)
+{
+	char *const list = read_line(path);
+	struct bitmap_t *set;
+
+	if (list == NULL)
+		return NULL;
+
+	set = bitmap_alloc_from_list(list);
+	free(list);
+
+	return set;
+}
+
+/* The last level cache is the highest level cache index of the CPU */
+static struct bitmap_t *read_llc(size_t cpu)
+{
+	char path[PATH_MAX];
+	struct bitmap_t *llc = NULL;
+	long llc_level = 0;
+	int index;
+
+	for (index = 0;; index++) {
+		char *level;
+		long value;
+
+		snprintf(path, sizeof(path), "cpu/cpu%zu/cache/index%d/level",
+			 cpu, index);
+		level = read_line(path);
+		if (level == NULL)
+			break;
+		value = strtol(level, NULL, 10);
+		free(level);
+
+		if (value > llc_level) {
+			struct bitmap_t *shared;
+
+			snprintf(path, sizeof(path),
+				 "cpu/cpu%zu/cache/index%d/shared_cpu_list",
+				 cpu, index);
+			shared = read_list(path);
+			if (shared == NULL)
+				continue;
+			if (llc != NULL)
+				bitmap_free(llc);
+			llc = shared;
+			llc_level = value;
+		}
+	}
+
+	return llc;
+}
+
+static void load_cpus(void)
+{
+	size_t remaining = bitmap_bit_count(topology.possible);
+	size_t cpu;
+
+	topology.nr_cpus = 0;
+	for (cpu = 0; remaining > 0; cpu++)
+		if (bitmap_isset(cpu, topology.possible)) {
+			topology.nr_cpus = cpu + 1;
+			remaining--;
+		}
+
+	topology.core = checked_malloc(topology.nr_cpus *
+				       sizeof(*topology.core));
+	topology.llc = checked_malloc(topology.nr_cpus *
+				      sizeof(*topology.llc));
+	topology.package = checked_malloc(topology.nr_cpus *
+					  sizeof(*topology.package));
+
+	for (cpu = 0; cpu < topology.nr_cpus; cpu++) {
+		char path[PATH_MAX];
+		char *package;
+
+		topology.package[cpu] = -1;
+		if (!bitmap_isset(cpu, topology.online))
+			continue;
+
+		snprintf(path, sizeof(path),
+			 "cpu/cpu%zu/topology/core_cpus_list", cpu);
+		topology.core[cpu] = read_list(path);
+		if (topology.core[cpu] == NULL) {
+			/* Name used before Linux 5.7 */
+			snprintf(path, sizeof(path),
+				 "cpu/cpu%zu/topology/thread_siblings_list",
+				 cpu);
+			topology.core[cpu] = read_list(path);
+		}
+
+		topology.llc[cpu] = read_llc(cpu);
+
+		snprintf(path, sizeof(path),
+			 "cpu/cpu%zu/topology/physical_package_id", cpu);
+		package = read_line(path);
+		if (package != NULL) {
+			topology.package[cpu] = strtol(package, NULL, 10);
+			free(package);
+		}
+	}
+}
+
+static void load_nodes(void)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "%s/node", topology_root);
+	dir = opendir(path);
+	if (dir == NULL) {
+		debug("%s: %s", path, strerror(errno));
+		return;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		char *end;
+		size_t node;
+
+		if (strncmp(entry->d_name, "node", 4) != 0)
+			continue;
+		node = strtoul(&entry->d_name[4], &end, 10);
+		if (end == &entry->d_name[4] || *end != '\0')
+			continue;
+
+		if (node >= topology.nr_nodes) {
+			size_t n;
+
+			topology.node = checked_realloc(topology.node,
+							(node + 1) *
+							sizeof(*topology.node));
+			for (n = topology.nr_nodes; n <= node; n++)
+				topology.node[n] = NULL;
+			topology.nr_nodes = node + 1;
+		}
+
+		snprintf(path, sizeof(path), "node/node%zu/cpulist", node);
+		topology.node[node] = read_list(path);
+	}
+
+	closedir(dir);
+}
+
+static void load_topology(void)
+{
+	debug("%s: Loading topology", topology_root);
+
+	topology.online = read_list("cpu/online");
+	topology.possible = read_list("cpu/possible");
+	if (topology.online == NULL || topology.possible == NULL)
+		fail("%s: No CPU topology found", topology_root);
+
+	/* Only present if the kernel has isolcpus support */
+	topology.isolated = read_list("cpu/isolated");
+	if (topology.isolated == NULL)
+		topology.isolated = bitmap_alloc_zero();
+
+	load_cpus();
+	load_nodes();
+}
+
+/* Return the number following prefix in name, or -1 if name does not
+ * consist of prefix and a decimal number */
+static long token_index(const char *name, const char *prefix)
+{
+	const size_t len = strlen(prefix);
+	char *end;
+	long index;
+
+	if (strncmp(name, prefix, len) != 0 || name[len] < '0' ||
+	    name[len] > '9')
+		return -1;
+
+	index = strtol(&name[len], &end, 10);
+	if (*end != '\0')
+		return -1;
+
+	return index;
+}
+
+/* Mask of CPU cpu in per_cpu, fails if the CPU has none */
+static struct bitmap_t *alloc_cpu_mask(const char *name, long cpu,
+				       struct bitmap_t **per_cpu)
+{
+	if ((size_t)cpu >= topology.nr_cpus || per_cpu[cpu] == NULL)
+		fail("@%s: CPU %ld is not online or has no such topology",
+		     name, cpu);
+
+	return bitmap_copy(per_cpu[cpu]);
+}
+
+struct bitmap_t *topology_alloc_mask(const char *name)
+{
+	long index;
+
+	pthread_once(&topology_once, load_topology);
+
+	if (strcmp(name, "online") == 0)
+		return bitmap_copy(topology.online);
+	if (strcmp(name, "possible") == 0)
+		return bitmap_copy(topology.possible);
+	if (strcmp(name, "isolated") == 0)
+		return bitmap_copy(topology.isolated);
+
+	if ((index = token_index(name, "core")) != -1)
+		return alloc_cpu_mask(name, index, topology.core);
+	if ((index = token_index(name, "llc")) != -1)
+		return alloc_cpu_mask(name, index, topology.llc);
+
+	if ((index = token_index(name, "node")) != -1) {
+		if ((size_t)index >= topology.nr_nodes ||
+		    topology.node[index] == NULL)
+			fail("@%s: No such NUMA node", name);
+		return bitmap_copy(topology.node[index]);
+	}
+
+	if ((index = token_index(name, "package")) != -1) {
+		struct bitmap_t *set = bitmap_alloc_zero();
+		size_t cpu;
+
+		for (cpu = 0; cpu < topology.nr_cpus; cpu++) {
+			struct bitmap_t *bit;
+			struct bitmap_t *merged;
+
+			if (topology.package[cpu] != index)
+				continue;
+			bit = bitmap_alloc_set(cpu);
+			merged = bitmap_or(set, bit);
+			bitmap_free(bit);
+			bitmap_free(set);
+			set = merged;
+		}
+
+		if (bitmap_is_empty(set))
+			fail("@%s: No such package", name);
+		return set;
+	}
+
+	fail("@%s: Unknown topology token", name);
+}
+
+struct bitmap_t *topology_siblings(const struct bitmap_t *set)
+{
+	struct bitmap_t *result = bitmap_copy(set);
+	size_t cpu;
+
+	pthread_once(&topology_once, load_topology);
+
+	for (cpu = 0; cpu < topology.nr_cpus; cpu++) {
+		struct bitmap_t *merged;
+
+		if (topology.core[cpu] == NULL || !bitmap_isset(cpu, set))
+			continue;
+		merged = bitmap_or(result, topology.core[cpu]);
+		bitmap_free(result);
+		result = merged;
+	}
+
+	return result;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "bitmap.h"
+
+/* Default directory the CPU and NUMA topology is read from */
+#define TOPOLOGY_DEFAULT_ROOT "/sys/devices/system"
+
+/* Read topology from root instead of TOPOLOGY_DEFAULT_ROOT. Must be called
+ * before the first lookup. */
+extern void topology_set_root(const char *root);
+
+/* Allocate the mask named by a topology token, without its leading '@':
+ *   online, possible, isolated  CPU sets of the system
+ *   node<N>                     CPUs of NUMA node N
+ *   package<N>                  CPUs with physical package id N
+ *   core<N>                     CPU N and its SMT siblings
+ *   llc<N>                      CPUs sharing the last level cache with CPU N
+ * The topology is loaded on the first call and cached for the rest of the
+ * process. */
+extern struct bitmap_t *topology_alloc_mask(const char *name);
+
+/* Allocate set expanded to whole cores. Bits that are not online CPUs are
+ * kept as they are. */
+extern struct bitmap_t *topology_siblings(const struct bitmap_t *set);
+
+#endif
@@ -353,6 +353,109 @@ START_TEST(test_bitmap_nr_bits)
 }
 END_TEST
 
+/*
+ * Checks bitmaps that spill from the inline words to the heap, and word wise
+ * operations between an inline and a spilled bitmap.
+ */
+START_TEST(test_bitmap_spill)
+{
+	static const size_t last_bit = BITMAP_INLINE_BITS * 3 + 7;
+	struct bitmap_t * const small = bitmap_alloc_nr_bits(100);
+	struct bitmap_t * const large = bitmap_alloc_set(last_bit);
+	struct bitmap_t *result;
+
+	info("%s: Test case entry", __func__);
+
+	ck_assert(small->map == small->inline_map);
+	ck_assert(large->map != large->inline_map);
+	ck_assert(((uintptr_t) large->map % CACHE_LINE_SIZE) == 0);
+
+	bitmap_set_bit(5, 1, large);
+	ck_assert_int_eq(bitmap_bit_count(large), 2);
+
+	result = bitmap_and(small, large);
+	ck_assert_int_eq(result->size_bits, last_bit + 1);
+	ck_assert_int_eq(bitmap_bit_count(result), 1);
+	ck_assert(bitmap_isset(5, result));
+	bitmap_free(result);
+
+	result = bitmap_xor(small, large);
+	ck_assert_int_eq(bitmap_bit_count(result), 100);
+	ck_assert(!bitmap_isset(5, result));
+	ck_assert(bitmap_isset(last_bit, result));
+	bitmap_free(result);
+
+	bitmap_free(small);
+	bitmap_free(large);
+
+	info("%s: Test case exit", __func__);
+}
+END_TEST
+
+START_TEST(test_bitmap_predicates)
+{
+	struct bitmap_t *const empty = bitmap_alloc_zero();
+	struct bitmap_t *const zero = bitmap_alloc_from_u32_list("0,0,0,0");
+	struct bitmap_t *const low = bitmap_alloc_from_list("1-2");
+	struct bitmap_t *const wide = bitmap_alloc_from_list("0-3,2000");
+	struct bitmap_t *const high = bitmap_alloc_from_list("2000");
+
+	info("%s: Test case enter", __func__);
+
+	ck_assert_int_eq(bitmap_is_subset(low, wide), 1);
+	ck_assert_int_eq(bitmap_is_subset(wide, low), 0);
+	ck_assert_int_eq(bitmap_is_subset(empty, low), 1);
+	ck_assert_int_eq(bitmap_is_subset(high, wide), 1);
+
+	ck_assert_int_eq(bitmap_is_equal(empty, zero), 1);
+	ck_assert_int_eq(bitmap_is_equal(zero, empty), 1);
+	ck_assert_int_eq(bitmap_is_equal(low, low), 1);
+	ck_assert_int_eq(bitmap_is_equal(low, wide), 0);
+	ck_assert_int_eq(bitmap_is_equal(wide, low), 0);
+
+	ck_assert_int_eq(bitmap_intersects(low, wide), 1);
+	ck_assert_int_eq(bitmap_intersects(high, low), 0);
+	ck_assert_int_eq(bitmap_intersects(wide, high), 1);
+	ck_assert_int_eq(bitmap_intersects(empty, wide), 0);
+
+	ck_assert_int_eq(bitmap_is_empty(empty), 1);
+	ck_assert_int_eq(bitmap_is_empty(zero), 1);
+	ck_assert_int_eq(bitmap_is_empty(high), 0);
+
+	bitmap_free(empty);
+	bitmap_free(zero);
+	bitmap_free(low);
+	bitmap_free(wide);
+	bitmap_free(high);
+
+	info("%s: Test case exit", __func__);
+}
+END_TEST
+
+START_TEST(test_bitmap_or_copy)
+{
+	struct bitmap_t *const low = bitmap_alloc_from_list("1-2");
+	struct bitmap_t *const high = bitmap_alloc_from_list("2,2000");
+	struct bitmap_t *const result = bitmap_or(low, high);
+	struct bitmap_t *const copy = bitmap_copy(result);
+	char *list;
+
+	info("%s: Test case enter", __func__);
+
+	list = bitmap_list(copy);
+	ck_assert(strcmp(list, "1-2,2000") == 0);
+	free(list);
+	ck_assert_int_eq(bitmap_is_equal(result, copy), 1);
+
+	bitmap_free(low);
+	bitmap_free(high);
+	bitmap_free(result);
+	bitmap_free(copy);
+
+	info("%s: Test case exit", __func__);
+}
+END_TEST
+
 static Suite *suite_bitmap(void)
 {
 	Suite *s = suite_create("bitmap");
@@ -371,6 +474,9 @@ static Suite *suite_bitmap(void)
 	tcase_add_test(tc_core, test_bitmap_u32list);
 	tcase_add_test(tc_core, test_bitmap_u32list_2);
 	tcase_add_test(tc_core, test_bitmap_nr_bits);
+	tcase_add_test(tc_core, test_bitmap_spill);
+	tcase_add_test(tc_core, test_bitmap_predicates);
+	tcase_add_test(tc_core, test_bitmap_or_copy);
 	suite_add_tcase(s, tc_core);
 
 	return s;
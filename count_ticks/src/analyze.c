@@ -0,0 +1,887 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Offline analysis of trace logs saved by "count_ticks --file". Each log is
+ * mapped into memory and split on line boundaries into one chunk per job.
+ * The jobs count ticks and tick gaps per CPU in parallel, and the chunk
+ * results are then merged in file order.
+ *
+ * With --why, the timer:tick_stop events in the logs are used to explain
+ * the ticks: each time nohz fails to stop the tick, the kernel reports
+ * which dependency kept it running. The failures are counted per CPU,
+ * dependency and task, and ranked in the output.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "histogram.h"
+#include "report.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+#define DEFAULT_PHASE "run"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* Tick gap histogram layout, 100 us buckets up to 100 ms */
+#define GAP_HIST_RESOLUTION_NS 100000
+#define GAP_HIST_BUCKETS 1000
+
+/* Do not bother starting more than one job per this many bytes of log */
+#define MIN_CHUNK_SIZE (1024 * 1024)
+
+#define NO_TIMESTAMP UINT64_MAX
+
+/* Task names are "<comm>-<pid>", where comm is at most 16 characters */
+#define TASK_NAME_SIZE 32
+
+/* Number of tasks to list for each tick dependency */
+#define TOP_TASKS 3
+
+/* Highest CPU number accepted from a log, the kernel's NR_CPUS limit.
+ * Anything above it is a corrupt line in a long capture. */
+#define MAX_CPU 8191
+
+/* Tick dependencies, as named by the tick_stop event since Linux 4.6 */
+enum tick_dep_t {
+	dep_posix_timer,
+	dep_perf_events,
+	dep_sched,
+	dep_clock_unstable,
+	dep_rcu,
+	dep_rcu_exp,
+	dep_other,
+	nr_tick_deps
+};
+
+static const struct {
+	/* Name in the trace, and in lower case in the report */
+	const char *name;
+	const char *metric;
+
+	/* What the dependency means, and how to get rid of it */
+	const char *cause;
+	const char *fix;
+} tick_deps[nr_tick_deps] = {
+	{ "POSIX_TIMER", "posix_timer",
+	  "A task has a POSIX CPU time timer armed",
+	  "Stop the timer, or 'partrt move' the task to the non-real time partition" },
+	{ "PERF_EVENTS", "perf_events",
+	  "Perf events are counting on the CPU, e.g. the NMI watchdog",
+	  "Do not pass -w to 'partrt create', so that the watchdog is disabled" },
+	{ "SCHED", "sched",
+	  "More than one task is runnable on the CPU",
+	  "Start one task per CPU with 'partrt run', and do not pass -k, -q or -u to 'partrt create'" },
+	{ "CLOCK_UNSTABLE", "clock_unstable",
+	  "The scheduler clock is unstable",
+	  "No partrt knob, boot with tsc=reliable if the TSC is known to be stable" },
+	{ "RCU", "rcu",
+	  "RCU needs the CPU for a grace period or callbacks",
+	  "Boot with rcu_nocbs=<rt cpus>, and do not pass -k to 'partrt create'" },
+	{ "RCU_EXP", "rcu_exp",
+	  "An expedited RCU grace period is in progress",
+	  "Boot with rcupdate.rcu_normal=1, and do not pass -k to 'partrt create'" },
+	{ NULL, "other",
+	  "Unknown dependency",
+	  "No known fix" },
+};
+
+struct task_count_t {
+	char name[TASK_NAME_SIZE];
+	uint64_t count;
+};
+
+/* Failures to stop the tick because of one dependency */
+struct dep_count_t {
+	uint64_t count;
+	uint64_t first_ns;
+	uint64_t last_ns;
+
+	/* Tasks that ran when the tick could not be stopped */
+	struct task_count_t *tasks;
+	size_t nr_tasks;
+};
+
+struct cpu_ticks_t {
+	uint64_t ticks;
+
+	/* First and last tick seen. Used for the gap between two chunks
+	 * when merging them. */
+	uint64_t first_ns;
+	uint64_t last_ns;
+
+	struct histogram_t gaps;
+
+	/* Times the tick was stopped, and failures to stop it */
+	uint64_t tick_stops;
+	uint64_t tick_stop_failures;
+	struct dep_count_t deps[nr_tick_deps];
+};
+
+struct chunk_t {
+	pthread_t thread;
+
+	/* Log lines to analyze, start and end are on line boundaries */
+	const char *start;
+	const char *end;
+
+	/* Indexed by CPU number */
+	struct cpu_ticks_t *cpus;
+	size_t nr_cpus;
+};
+
+static unsigned long option_jobs = 0;
+static int option_batch = 0;
+static int option_why = 0;
+static const char *option_report = NULL;
+static const char *option_phase = DEFAULT_PHASE;
+
+/* CPUs to count ticks on, NULL means all CPUs in the logs */
+static struct bitmap_t *cpu_filter = NULL;
+
+static unsigned long str_to_ulong(const char *value, const char *what)
+{
+	char *check;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(value, &check, 0);
+	if ((value[0] == '\0') || (check[0] != '\0') || (errno != 0))
+		fail("'%s': Not a valid %s", value, what);
+
+	return val;
+}
+
+static struct cpu_ticks_t *chunk_cpu(struct chunk_t *chunk, size_t cpu)
+{
+	size_t idx;
+
+	if (cpu < chunk->nr_cpus)
+		return &chunk->cpus[cpu];
+
+	chunk->cpus = checked_realloc(chunk->cpus,
+				      (cpu + 1) * sizeof(*chunk->cpus));
+	for (idx = chunk->nr_cpus; idx <= cpu; idx++) {
+		chunk->cpus[idx].ticks = 0;
+		chunk->cpus[idx].first_ns = NO_TIMESTAMP;
+		chunk->cpus[idx].last_ns = NO_TIMESTAMP;
+		histogram_init(&chunk->cpus[idx].gaps, GAP_HIST_RESOLUTION_NS,
+			       GAP_HIST_BUCKETS);
+		chunk->cpus[idx].tick_stops = 0;
+		chunk->cpus[idx].tick_stop_failures = 0;
+		memset(chunk->cpus[idx].deps, 0, sizeof(chunk->cpus[idx].deps));
+	}
+	chunk->nr_cpus = cpu + 1;
+
+	return &chunk->cpus[cpu];
+}
+
+static void chunk_destroy(struct chunk_t *chunk)
+{
+	size_t idx;
+
+	for (idx = 0; idx < chunk->nr_cpus; idx++) {
+		enum tick_dep_t dep;
+
+		histogram_destroy(&chunk->cpus[idx].gaps);
+		for (dep = 0; dep < nr_tick_deps; dep++)
+			free(chunk->cpus[idx].deps[dep].tasks);
+	}
+	free(chunk->cpus);
+	chunk->cpus = NULL;
+	chunk->nr_cpus = 0;
+}
+
+/* Add count failures caused by task, between first_ns and last_ns */
+static void dep_add(struct dep_count_t *dep, const char *task,
+		    size_t task_len, uint64_t count, uint64_t first_ns,
+		    uint64_t last_ns)
+{
+	size_t idx;
+
+	if (task_len >= TASK_NAME_SIZE)
+		task_len = TASK_NAME_SIZE - 1;
+
+	dep->count += count;
+	if ((dep->first_ns == 0) || (first_ns < dep->first_ns))
+		dep->first_ns = first_ns;
+	if (last_ns > dep->last_ns)
+		dep->last_ns = last_ns;
+
+	for (idx = 0; idx < dep->nr_tasks; idx++) {
+		if ((strncmp(dep->tasks[idx].name, task, task_len) == 0) &&
+		    (dep->tasks[idx].name[task_len] == '\0')) {
+			dep->tasks[idx].count += count;
+			return;
+		}
+	}
+
+	dep->tasks = checked_realloc(dep->tasks,
+				     (dep->nr_tasks + 1) * sizeof(*dep->tasks));
+	memcpy(dep->tasks[idx].name, task, task_len);
+	dep->tasks[idx].name[task_len] = '\0';
+	dep->tasks[idx].count = count;
+	dep->nr_tasks++;
+}
+
+static int task_count_cmp(const void *first, const void *second)
+{
+	const struct task_count_t *const a = first;
+	const struct task_count_t *const b = second;
+
+	if (a->count != b->count)
+		return (a->count > b->count) ? -1 : 1;
+
+	return strcmp(a->name, b->name);
+}
+
+/*
+ * Log parsing. The function tracer writes lines like
+ *   <task>-<pid> [<cpu>] <flags> <seconds>.<fraction>: <function> <-<parent>
+ * where the flags column is missing in old kernels and the task name may
+ * contain anything, including spaces and brackets. Trace events have the
+ * event name and its fields in place of the function. Lines are parsed by hand
+ * since a regular expression per line would dominate the analysis time.
+ */
+
+/* Parse decimal digits at pos. Returns the position after the last digit,
+ * or NULL if there is no digit at pos. */
+static const char *parse_digits(const char *pos, const char *end,
+				uint64_t *value, int *nr_digits)
+{
+	const char *const start = pos;
+
+	*value = 0;
+	while ((pos < end) && (*pos >= '0') && (*pos <= '9')) {
+		*value = *value * 10 + (uint64_t) (*pos - '0');
+		pos++;
+	}
+	*nr_digits = (int) (pos - start);
+
+	return (pos == start) ? NULL : pos;
+}
+
+/* Find the first " [<cpu>] " field with a CPU number up to MAX_CPU.
+ * Returns the position after it, and the start of the field in task_end. */
+static const char *parse_cpu(const char *pos, const char *end, uint64_t *cpu,
+			     const char **task_end)
+{
+	const char *const line = pos;
+	int nr_digits;
+
+	while ((pos = memchr(pos, '[', (size_t) (end - pos))) != NULL) {
+		const char *const after = parse_digits(pos + 1, end, cpu,
+						       &nr_digits);
+
+		if ((pos > line) && (pos[-1] == ' ') && (after != NULL) &&
+		    (nr_digits <= 5) && (*cpu <= MAX_CPU) &&
+		    (end - after >= 2) && (after[0] == ']') && (after[1] == ' ')) {
+			*task_end = pos - 1;
+			return after + 2;
+		}
+		pos++;
+	}
+
+	return NULL;
+}
+
+/* Parse "<seconds>.<fraction>:" into nanoseconds. Returns the position
+ * after the colon, or NULL if pos is not at a time stamp. */
+static const char *parse_timestamp(const char *pos, const char *end,
+				   uint64_t *ns)
+{
+	uint64_t sec;
+	uint64_t frac;
+	int nr_digits;
+
+	pos = parse_digits(pos, end, &sec, &nr_digits);
+	if ((pos == NULL) || (pos == end) || (*pos != '.'))
+		return NULL;
+	pos = parse_digits(pos + 1, end, &frac, &nr_digits);
+	if ((pos == NULL) || (pos == end) || (*pos != ':'))
+		return NULL;
+
+	for (; nr_digits < 9; nr_digits++)
+		frac *= 10;
+	for (; nr_digits > 9; nr_digits--)
+		frac /= 10;
+	*ns = sec * NSEC_PER_SEC + frac;
+
+	return pos + 1;
+}
+
+static const char *skip_blanks(const char *pos, const char *end)
+{
+	while ((pos < end) && (*pos == ' '))
+		pos++;
+
+	return pos;
+}
+
+/* Returns true if the function name at pos is the tick handler. It was
+ * renamed from scheduler_tick to sched_tick in Linux 6.10. */
+static int is_tick(const char *pos, const char *end)
+{
+	static const char *const tick_functions[] = {
+		"scheduler_tick",
+		"sched_tick"
+	};
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(tick_functions) / sizeof(tick_functions[0]); idx++) {
+		const size_t len = strlen(tick_functions[idx]);
+
+		if (((size_t) (end - pos) >= len) &&
+		    (memcmp(pos, tick_functions[idx], len) == 0) &&
+		    (((size_t) (end - pos) == len) || (pos[len] == ' ')))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Returns the position after prefix if the text at pos starts with it,
+ * NULL otherwise */
+static const char *skip_prefix(const char *pos, const char *end,
+			       const char *prefix)
+{
+	const size_t len = strlen(prefix);
+
+	if (((size_t) (end - pos) < len) || (memcmp(pos, prefix, len) != 0))
+		return NULL;
+
+	return pos + len;
+}
+
+/* Parse the fields of a tick_stop event:
+ *   tick_stop: success=<0|1> dependency=<name>
+ * The task is the one that ran on the CPU when the event occurred. */
+static void parse_tick_stop(struct cpu_ticks_t *cpu_ticks, const char *pos,
+			    const char *end, const char *task,
+			    const char *task_end, uint64_t ns)
+{
+	const char *dep_end;
+	enum tick_dep_t dep;
+
+	pos = skip_prefix(skip_blanks(pos, end), end, "success=");
+	if ((pos == NULL) || (pos == end))
+		return;
+	if (*pos != '0') {
+		cpu_ticks->tick_stops++;
+		return;
+	}
+
+	pos = skip_prefix(skip_blanks(pos + 1, end), end, "dependency=");
+	if (pos == NULL)
+		return;
+	dep_end = pos;
+	while ((dep_end < end) && (*dep_end != ' ') && (*dep_end != '\r'))
+		dep_end++;
+
+	for (dep = 0; dep < dep_other; dep++)
+		if ((strlen(tick_deps[dep].name) == (size_t) (dep_end - pos)) &&
+		    (memcmp(tick_deps[dep].name, pos, (size_t) (dep_end - pos)) == 0))
+			break;
+
+	/* The task column is padded */
+	while ((task_end > task) && (task_end[-1] == ' '))
+		task_end--;
+
+	cpu_ticks->tick_stop_failures++;
+	dep_add(&cpu_ticks->deps[dep], task, (size_t) (task_end - task), 1,
+		ns, ns);
+}
+
+static void parse_line(struct chunk_t *chunk, const char *pos,
+		       const char *end)
+{
+	const char *task;
+	const char *task_end;
+	struct cpu_ticks_t *cpu_ticks;
+	const char *next;
+	uint64_t cpu;
+	uint64_t ns;
+
+	if ((pos == end) || (*pos == '#'))
+		return;
+
+	task = skip_blanks(pos, end);
+	pos = parse_cpu(pos, end, &cpu, &task_end);
+	if (pos == NULL)
+		return;
+	pos = skip_blanks(pos, end);
+
+	next = parse_timestamp(pos, end, &ns);
+	if (next == NULL) {
+		/* Skip the flags column */
+		while ((pos < end) && (*pos != ' '))
+			pos++;
+		next = parse_timestamp(skip_blanks(pos, end), end, &ns);
+		if (next == NULL)
+			return;
+	}
+
+	next = skip_blanks(next, end);
+	if (!is_tick(next, end)) {
+		if (!option_why)
+			return;
+		next = skip_prefix(next, end, "tick_stop:");
+		if (next == NULL)
+			return;
+		if ((cpu_filter != NULL) &&
+		    !bitmap_isset((size_t) cpu, cpu_filter))
+			return;
+		parse_tick_stop(chunk_cpu(chunk, (size_t) cpu), next, end,
+				task, task_end, ns);
+		return;
+	}
+	if ((cpu_filter != NULL) && !bitmap_isset((size_t) cpu, cpu_filter))
+		return;
+
+	cpu_ticks = chunk_cpu(chunk, (size_t) cpu);
+	cpu_ticks->ticks++;
+	if (cpu_ticks->first_ns == NO_TIMESTAMP)
+		cpu_ticks->first_ns = ns;
+	else if (ns >= cpu_ticks->last_ns)
+		histogram_add(&cpu_ticks->gaps, ns - cpu_ticks->last_ns);
+	cpu_ticks->last_ns = ns;
+}
+
+static void *analyze_chunk(void *arg)
+{
+	struct chunk_t *const chunk = arg;
+	const char *pos = chunk->start;
+
+	while (pos < chunk->end) {
+		const char *eol = memchr(pos, '\n',
+					 (size_t) (chunk->end - pos));
+
+		if (eol == NULL)
+			eol = chunk->end;
+		parse_line(chunk, pos, eol);
+		pos = eol + 1;
+	}
+
+	return NULL;
+}
+
+/* Add the result of chunk to total. Chunks of a file must be merged in
+ * order, since the gap between the last tick in total and the first tick
+ * in chunk is counted here. */
+static void merge_chunk(struct chunk_t *total, const struct chunk_t *chunk)
+{
+	size_t cpu;
+
+	for (cpu = 0; cpu < chunk->nr_cpus; cpu++) {
+		const struct cpu_ticks_t *const src = &chunk->cpus[cpu];
+		struct cpu_ticks_t *dst;
+		enum tick_dep_t dep;
+
+		if ((src->ticks == 0) && (src->tick_stops == 0) &&
+		    (src->tick_stop_failures == 0))
+			continue;
+
+		dst = chunk_cpu(total, cpu);
+		dst->tick_stops += src->tick_stops;
+		dst->tick_stop_failures += src->tick_stop_failures;
+		for (dep = 0; dep < nr_tick_deps; dep++) {
+			const struct dep_count_t *const src_dep = &src->deps[dep];
+			size_t idx;
+
+			for (idx = 0; idx < src_dep->nr_tasks; idx++)
+				dep_add(&dst->deps[dep], src_dep->tasks[idx].name,
+					strlen(src_dep->tasks[idx].name),
+					src_dep->tasks[idx].count,
+					src_dep->first_ns, src_dep->last_ns);
+		}
+
+		if (src->ticks == 0)
+			continue;
+		if ((dst->last_ns != NO_TIMESTAMP) &&
+		    (src->first_ns >= dst->last_ns))
+			histogram_add(&dst->gaps, src->first_ns - dst->last_ns);
+		histogram_merge(&dst->gaps, &src->gaps);
+		dst->ticks += src->ticks;
+		if (dst->first_ns == NO_TIMESTAMP)
+			dst->first_ns = src->first_ns;
+		dst->last_ns = src->last_ns;
+	}
+}
+
+/* Analyze one log file using up to option_jobs threads, and add the
+ * result to total. */
+static void analyze_file(const char *file, struct chunk_t *total)
+{
+	struct chunk_t *chunks;
+	unsigned long nr_chunks;
+	unsigned long idx;
+	struct stat st;
+	const char *map;
+	size_t size;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd == -1)
+		fail("%s: Error opening file for reading: %s", file,
+		     strerror(errno));
+	if (fstat(fd, &st) == -1)
+		fail("%s: Could not get file size: %s", file, strerror(errno));
+
+	/* Ticks in different files are not consecutive */
+	for (idx = 0; idx < total->nr_cpus; idx++)
+		total->cpus[idx].last_ns = NO_TIMESTAMP;
+
+	size = (size_t) st.st_size;
+	if (size == 0) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		fail("%s: Could not map file: %s", file, strerror(errno));
+	close(fd);
+	madvise((void *) (uintptr_t) map, size, MADV_SEQUENTIAL);
+
+	nr_chunks = size / MIN_CHUNK_SIZE + 1;
+	if (nr_chunks > option_jobs)
+		nr_chunks = option_jobs;
+	info("%s: %zu bytes, %lu job%s", file, size, nr_chunks,
+	     (nr_chunks == 1) ? "" : "s");
+
+	chunks = checked_malloc(nr_chunks * sizeof(*chunks));
+	for (idx = 0; idx < nr_chunks; idx++) {
+		const char *const start = (idx == 0) ? map : chunks[idx - 1].end;
+		const char *end = map + size / nr_chunks * (idx + 1);
+
+		/* Let the last chunk take the rest, and the others end after
+		 * a line break */
+		if ((idx == nr_chunks - 1) || (end <= start)) {
+			end = (idx == nr_chunks - 1) ? map + size : start;
+		} else {
+			end = memchr(end, '\n', (size_t) (map + size - end));
+			end = (end == NULL) ? map + size : end + 1;
+		}
+
+		chunks[idx].start = start;
+		chunks[idx].end = end;
+		chunks[idx].cpus = NULL;
+		chunks[idx].nr_cpus = 0;
+	}
+
+	for (idx = 0; idx < nr_chunks; idx++) {
+		const int status = pthread_create(&chunks[idx].thread, NULL,
+						  analyze_chunk, &chunks[idx]);
+
+		if (status != 0)
+			fail("Could not create thread: %s", strerror(status));
+	}
+
+	for (idx = 0; idx < nr_chunks; idx++) {
+		const int status = pthread_join(chunks[idx].thread, NULL);
+
+		if (status != 0)
+			fail("Could not join thread: %s", strerror(status));
+		merge_chunk(total, &chunks[idx]);
+		chunk_destroy(&chunks[idx]);
+	}
+
+	free(chunks);
+	munmap((void *) (uintptr_t) map, size);
+}
+
+/* Returns true if cpu should be listed in the result */
+static int show_cpu(const struct chunk_t *total, size_t cpu)
+{
+	if (cpu_filter != NULL)
+		return bitmap_isset(cpu, cpu_filter);
+
+	return (cpu < total->nr_cpus) &&
+		((total->cpus[cpu].ticks > 0) ||
+		 (total->cpus[cpu].tick_stop_failures > 0));
+}
+
+static void report_tick_stops(FILE *report, int cpu,
+			      const struct cpu_ticks_t *cpu_ticks)
+{
+	char metric[64];
+	enum tick_dep_t dep;
+
+	report_value(report, option_phase, cpu, "tick_stop.success",
+		     cpu_ticks->tick_stops);
+	report_value(report, option_phase, cpu, "tick_stop.failed",
+		     cpu_ticks->tick_stop_failures);
+	for (dep = 0; dep < nr_tick_deps; dep++) {
+		if (cpu_ticks->deps[dep].count == 0)
+			continue;
+		snprintf(metric, sizeof(metric), "tick_stop.failed.%s",
+			 tick_deps[dep].metric);
+		report_value(report, option_phase, cpu, metric,
+			     cpu_ticks->deps[dep].count);
+	}
+}
+
+/* Print the tick dependencies of cpu, most frequent first */
+static void print_tick_stops(size_t cpu, struct cpu_ticks_t *cpu_ticks)
+{
+	enum tick_dep_t order[nr_tick_deps];
+	enum tick_dep_t dep;
+	size_t idx;
+	size_t rank;
+
+	printf("CPU %zu: %llu ticks, tick not stopped %llu times, stopped %llu times\n",
+	       cpu, (unsigned long long) cpu_ticks->ticks,
+	       (unsigned long long) cpu_ticks->tick_stop_failures,
+	       (unsigned long long) cpu_ticks->tick_stops);
+
+	/* Insertion sort, there are only a handful of dependencies */
+	for (dep = 0; dep < nr_tick_deps; dep++) {
+		for (idx = (size_t) dep; idx > 0; idx--) {
+			if (cpu_ticks->deps[order[idx - 1]].count >=
+			    cpu_ticks->deps[dep].count)
+				break;
+			order[idx] = order[idx - 1];
+		}
+		order[idx] = dep;
+	}
+
+	for (rank = 0; rank < nr_tick_deps; rank++) {
+		struct dep_count_t *const dep_count = &cpu_ticks->deps[order[rank]];
+
+		if (dep_count->count == 0)
+			break;
+
+		printf("  %llu %s: %s\n"
+		       "    seen %llu.%06llu - %llu.%06llu, tasks:",
+		       (unsigned long long) dep_count->count,
+		       tick_deps[order[rank]].metric,
+		       tick_deps[order[rank]].cause,
+		       (unsigned long long) (dep_count->first_ns / NSEC_PER_SEC),
+		       (unsigned long long) (dep_count->first_ns % NSEC_PER_SEC / 1000),
+		       (unsigned long long) (dep_count->last_ns / NSEC_PER_SEC),
+		       (unsigned long long) (dep_count->last_ns % NSEC_PER_SEC / 1000));
+
+		qsort(dep_count->tasks, dep_count->nr_tasks,
+		      sizeof(*dep_count->tasks), task_count_cmp);
+		for (idx = 0; (idx < dep_count->nr_tasks) && (idx < TOP_TASKS); idx++)
+			printf("%s %s (%llu)", (idx == 0) ? "" : ",",
+			       dep_count->tasks[idx].name,
+			       (unsigned long long) dep_count->tasks[idx].count);
+		if (dep_count->nr_tasks > TOP_TASKS)
+			printf(", %zu more", dep_count->nr_tasks - TOP_TASKS);
+		printf("\n    fix: %s\n", tick_deps[order[rank]].fix);
+	}
+}
+
+static void write_report(struct chunk_t *total)
+{
+	FILE *const report = report_open(option_report, "count_ticks");
+	size_t nr_cpus = total->nr_cpus;
+	uint64_t ticks = 0;
+	size_t cpu;
+
+	if ((cpu_filter != NULL) && (bitmap_nr_bits(cpu_filter) > nr_cpus))
+		nr_cpus = bitmap_nr_bits(cpu_filter);
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		const struct cpu_ticks_t *cpu_ticks;
+
+		if (!show_cpu(total, cpu))
+			continue;
+		cpu_ticks = chunk_cpu(total, cpu);
+		report_value(report, option_phase, (int) cpu, "ticks",
+			     cpu_ticks->ticks);
+		report_histogram(report, option_phase, (int) cpu, "tick_gap",
+				 &cpu_ticks->gaps);
+		if (option_why)
+			report_tick_stops(report, (int) cpu, cpu_ticks);
+		ticks += cpu_ticks->ticks;
+	}
+	report_value(report, option_phase, REPORT_ALL_CPUS, "ticks", ticks);
+
+	report_close(report);
+}
+
+static void usage(void)
+{
+	puts("count_ticks-analyze - Count kernel ticks in saved count_ticks logs\n"
+	     "Usage:\n"
+	     "count_ticks-analyze [options] <log file>...\n"
+	     "\n"
+	     "Counts the ticks in trace logs saved with 'count_ticks --file', and\n"
+	     "prints the total the same way a live run does. Each log is split into\n"
+	     "chunks that are analyzed in parallel. Gaps between ticks on the same\n"
+	     "CPU are collected in a histogram, which is included in the report.\n"
+	     "\n"
+	     "With --why, the timer:tick_stop events in the logs are used to tell why\n"
+	     "the tick was not stopped. The failures are counted per CPU and cause,\n"
+	     "together with the tasks that ran at the time, and each cause is listed\n"
+	     "with a partrt option or boot parameter that removes it.\n"
+	     "\n"
+	     "Options:\n"
+	     "-c, --cpu=<list>        Only count ticks on the CPUs in <list>, e.g.\n"
+	     "                        '1,3-5'. CPUs without ticks are reported too.\n"
+	     "-j, --jobs=<n>          Analyze using <n> threads. Default: number of\n"
+	     "                        online CPUs.\n"
+	     "-b, --batch             Do just print number of ticks, no descriptive\n"
+	     "                        text.\n"
+	     "-r, --report=<file>     Write ticks and tick gaps per CPU in rtreport\n"
+	     "                        format to <file>, '-' means stdout.\n"
+	     "-l, --label=<name>      Phase name in report. Default: 'run'\n"
+	     "-w, --why               Explain why the tick was not stopped, most\n"
+	     "                        frequent cause first.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Example:\n"
+	     "   count_ticks analyze -j 8 -r ticks.rtreport trace-*.log\n");
+}
+
+static void version(void)
+{
+	printf("count_ticks-analyze %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       count_ticks_VERSION_MAJOR, count_ticks_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"cpu", required_argument, NULL, 'c'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"batch", no_argument, NULL, 'b'},
+		{"report", required_argument, NULL, 'r'},
+		{"label", required_argument, NULL, 'l'},
+		{"why", no_argument, NULL, 'w'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVc:j:br:l:w";
+	struct chunk_t total = { 0, NULL, NULL, NULL, 0 };
+	uint64_t ticks = 0;
+	size_t cpu;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'c':
+			parse_scope = "CPU list";
+			if (cpu_filter != NULL)
+				bitmap_free(cpu_filter);
+			cpu_filter = bitmap_alloc_from_list(optarg);
+			if (bitmap_nr_bits(cpu_filter) > MAX_CPU + 1)
+				fail("'%s': CPU above %d", optarg, MAX_CPU);
+			parse_scope = NULL;
+			break;
+		case 'j':
+			option_jobs = str_to_ulong(optarg, "number of jobs");
+			if (option_jobs == 0)
+				fail("'%s': Not a valid number of jobs", optarg);
+			break;
+		case 'b':
+			option_batch = 1;
+			break;
+		case 'r':
+			option_report = optarg;
+			break;
+		case 'l':
+			option_phase = optarg;
+			break;
+		case 'w':
+			option_why = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind >= argc)
+		fail("Missing log file");
+	if (option_jobs == 0)
+		option_jobs = (unsigned long) get_nprocs();
+
+	for (; optind < argc; optind++)
+		analyze_file(argv[optind], &total);
+
+	for (cpu = 0; cpu < total.nr_cpus; cpu++)
+		if (show_cpu(&total, cpu))
+			ticks += total.cpus[cpu].ticks;
+
+	if (option_batch)
+		printf("%llu\n", (unsigned long long) ticks);
+	else
+		printf("%llu ticks occurred\n", (unsigned long long) ticks);
+
+	if (option_why)
+		for (cpu = 0; cpu < total.nr_cpus; cpu++)
+			if (show_cpu(&total, cpu))
+				print_tick_stops(cpu, &total.cpus[cpu]);
+
+	if (option_report != NULL)
+		write_report(&total);
+
+	chunk_destroy(&total);
+	if (cpu_filter != NULL)
+		bitmap_free(cpu_filter);
+
+	return 0;
+}
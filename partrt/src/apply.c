@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-apply: Applies a batch of writes to sysfs, procfs and cgroupfs
+ * files in one process.
+ *
+ * Each line of input is one operation: <flags> <file> <value>. The
+ * operations are done in order, each with one open() and a pwrite() at
+ * offset 0, which is what the shell redirections of the partrt script do.
+ * Previous values are read with pread() on the same file descriptor before
+ * writing, collected, and appended to the settings file in one write() when
+ * the batch is done, so a settings file never holds half a line. A table
+ * with the result and the time taken by each operation is printed on
+ * stdout.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define VALUE_SIZE 4096
+#define DEFAULT_TIMEOUT_S 5
+
+/* Delay before the first retry of a busy file, doubled up to the maximum */
+#define BUSY_DELAY_MIN_NS 1000000L
+#define BUSY_DELAY_MAX_NS 200000000L
+
+#define NSEC_PER_SEC 1000000000LL
+
+/* Operation flags */
+#define OP_SAVE 0x1		/* s: Log the previous value */
+#define OP_BUSY 0x2		/* b: Retry while the file is busy */
+#define OP_OPTIONAL 0x4		/* o: A failed write is not an error */
+
+enum op_result_t {
+	OP_OK,
+	OP_MISSING,
+	OP_FAILED,
+	OP_TIMEOUT
+};
+
+static const char *const op_result_names[] = {
+	[OP_OK] = "ok",
+	[OP_MISSING] = "missing",
+	[OP_FAILED] = "failed",
+	[OP_TIMEOUT] = "timeout"
+};
+
+static const char *option_settings = NULL;
+static long option_timeout = DEFAULT_TIMEOUT_S;
+
+/* Previous values not yet appended to the settings file */
+static char *settings_buf = NULL;
+static size_t settings_len = 0;
+static size_t settings_size = 0;
+
+/* 64 bit, a long overflows after about 2 s on 32 bit targets */
+static int64_t elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t) (now.tv_sec - start->tv_sec) * NSEC_PER_SEC +
+		(int64_t) (now.tv_nsec - start->tv_nsec);
+}
+
+/* Keep one settings line per file, whatever the file holds */
+static void save_old_value(const char *file, char *old_value)
+{
+	const size_t len = strlen(file) + strlen(old_value) + 3;
+	char *c;
+
+	for (c = old_value; *c != '\0'; c++)
+		if (*c == '\n')
+			*c = ' ';
+
+	if (settings_len + len > settings_size) {
+		settings_size = 2 * (settings_len + len);
+		settings_buf = checked_realloc(settings_buf, settings_size);
+	}
+	settings_len += (size_t) snprintf(&settings_buf[settings_len],
+					  settings_size - settings_len,
+					  "%s %s\n", file, old_value);
+}
+
+static void flush_settings(void)
+{
+	int fd;
+	ssize_t status;
+
+	if ((option_settings == NULL) || (settings_len == 0))
+		return;
+
+	fd = open(option_settings, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+		  0644);
+	if (fd == -1)
+		fail("%s: Could not open settings file: %s", option_settings,
+		     strerror(errno));
+	status = write(fd, settings_buf, settings_len);
+	if ((status == -1) || ((size_t) status != settings_len))
+		fail("%s: Could not log previous values: %s", option_settings,
+		     status == -1 ? strerror(errno) : "Short write");
+	close(fd);
+	settings_len = 0;
+}
+
+/* Read the previous value of fd into old_value, strip trailing white space
+ * like sysfs_read() */
+static int read_old_value(int fd, char *old_value, size_t size)
+{
+	ssize_t len = pread(fd, old_value, size - 1, 0);
+
+	if (len == -1)
+		return -1;
+	while ((len > 0) && ((old_value[len - 1] == '\n') ||
+			     (old_value[len - 1] == ' ')))
+		len--;
+	old_value[len] = '\0';
+
+	return 0;
+}
+
+static int write_value(int fd, const char *value)
+{
+	const size_t len = strlen(value);
+	const ssize_t status = pwrite(fd, value, len, 0);
+	struct stat st;
+
+	if (status == -1)
+		return -1;
+	if ((size_t) status != len) {
+		errno = EIO;
+		return -1;
+	}
+
+	/* Virtual files ignore the file size, plain files used to fake them
+	 * must not keep the tail of a longer previous value */
+	if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) &&
+	    (ftruncate(fd, (off_t) len) == -1))
+		return -1;
+
+	return 0;
+}
+
+/* Do one operation, and return its result. The number of attempts is
+ * stored in tries, errno is set when the result is OP_FAILED. */
+static enum op_result_t apply(int flags, const char *file, const char *value,
+			      char *old_value, size_t size, unsigned *tries)
+{
+	const int mode = (flags & OP_SAVE) ? O_RDWR : O_WRONLY;
+	const int64_t timeout_ns = (int64_t) option_timeout * NSEC_PER_SEC;
+	struct timespec start;
+	struct timespec delay = { 0, BUSY_DELAY_MIN_NS };
+	int fd;
+
+	*tries = 0;
+	old_value[0] = '\0';
+
+	fd = open(file, mode | O_CLOEXEC);
+	if (fd == -1)
+		return errno == ENOENT ? OP_MISSING : OP_FAILED;
+
+	if ((flags & OP_SAVE) && (read_old_value(fd, old_value, size) == -1)) {
+		const int saved_errno = errno;
+
+		close(fd);
+		errno = saved_errno;
+		return OP_FAILED;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		int saved_errno;
+
+		(*tries)++;
+		if (write_value(fd, value) == 0)
+			break;
+
+		saved_errno = errno;
+		if ((saved_errno != EBUSY) || !(flags & OP_BUSY)) {
+			close(fd);
+			errno = saved_errno;
+			return OP_FAILED;
+		}
+		if (elapsed_ns(&start) > timeout_ns) {
+			close(fd);
+			return OP_TIMEOUT;
+		}
+
+		nanosleep(&delay, NULL);
+		delay.tv_nsec *= 2;
+		if (delay.tv_nsec > BUSY_DELAY_MAX_NS)
+			delay.tv_nsec = BUSY_DELAY_MAX_NS;
+	}
+	close(fd);
+
+	if (flags & OP_SAVE)
+		save_old_value(file, old_value);
+
+	return OP_OK;
+}
+
+static int parse_flags(const char *text)
+{
+	int flags = 0;
+
+	if (strcmp(text, "-") == 0)
+		return 0;
+
+	for (; *text != '\0'; text++) {
+		switch (*text) {
+		case 's':
+			flags |= OP_SAVE;
+			break;
+		case 'b':
+			flags |= OP_BUSY;
+			break;
+		case 'o':
+			flags |= OP_OPTIONAL;
+			break;
+		default:
+			fail("'%c': Unknown flag, expected s, b, o or -",
+			     *text);
+		}
+	}
+
+	return flags;
+}
+
+/* Apply all operations of input, and return the number that failed */
+static size_t apply_batch(FILE *input)
+{
+	char old_value[VALUE_SIZE];
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t nr_failed = 0;
+	ssize_t len;
+
+	printf("%-8s %5s %9s  %s\n", "Result", "Tries", "Time us",
+	       "File = Value (previous value)");
+
+	while ((len = getline(&line, &line_size, input)) != -1) {
+		struct timespec start;
+		enum op_result_t result;
+		char *file;
+		char *value;
+		char *flags_text;
+		unsigned tries;
+		int saved_errno;
+		int flags;
+		int64_t time_ns;
+
+		while ((len > 0) && (line[len - 1] == '\n'))
+			line[--len] = '\0';
+
+		flags_text = line + strspn(line, " \t");
+		if ((*flags_text == '\0') || (*flags_text == '#'))
+			continue;
+
+		parse_scope = line;
+		file = flags_text + strcspn(flags_text, " \t");
+		if (*file == '\0')
+			fail("Expected <flags> <file> <value>");
+		*file = '\0';
+		file++;
+		file += strspn(file, " \t");
+		value = file + strcspn(file, " \t");
+		if ((*file == '\0') || (*value == '\0'))
+			fail("Expected <flags> <file> <value>");
+		*value = '\0';
+		value++;
+		value += strspn(value, " \t");
+		flags = parse_flags(flags_text);
+		parse_scope = NULL;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		result = apply(flags, file, value, old_value,
+			       sizeof(old_value), &tries);
+		saved_errno = errno;
+		time_ns = elapsed_ns(&start);
+
+		printf("%-8s %5u %9lld  %s = %s", op_result_names[result],
+		       tries, (long long) (time_ns / 1000), file, value);
+		if ((flags & OP_SAVE) && (result == OP_OK))
+			printf(" (%s)", old_value);
+		putchar('\n');
+
+		switch (result) {
+		case OP_OK:
+			debug("echo %s > %s", value, file);
+			break;
+		case OP_MISSING:
+			info("%s: Does not exist", file);
+			break;
+		case OP_FAILED:
+		case OP_TIMEOUT:
+			if (flags & OP_OPTIONAL) {
+				info("Failed to write %s into %s: %s", value,
+				     file, result == OP_TIMEOUT ?
+				     "Timed-out" : strerror(saved_errno));
+				break;
+			}
+
+			/* Stop like the shell would, and keep what is
+			 * needed to undo the operations already done */
+			fflush(stdout);
+			flush_settings();
+			fail("Failed to write %s into %s: %s", value, file,
+			     result == OP_TIMEOUT ?
+			     "Timed-out" : strerror(saved_errno));
+		}
+		if (result != OP_OK)
+			nr_failed++;
+	}
+	free(line);
+
+	return nr_failed;
+}
+
+static void usage(void)
+{
+	puts("partrt-apply - Apply a batch of writes to sysfs and procfs files\n"
+	     "Usage:\n"
+	     "partrt-apply [options] [<file>]\n"
+	     "\n"
+	     "Reads operations from <file>, or stdin, one per line:\n"
+	     "  <flags> <file> <value>\n"
+	     "and writes <value> to each <file> in order. <flags> is '-' or any of:\n"
+	     "  s   Log the previous value in the settings file.\n"
+	     "  b   Retry while the file is busy (EBUSY), until the timeout.\n"
+	     "  o   Optional, a failed write is reported but is not an error.\n"
+	     "Files that do not exist are skipped. Any other failure stops the batch.\n"
+	     "A table with the result and time of each operation is printed on\n"
+	     "stdout. Normally started by 'partrt create' and 'partrt undo'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-s, --settings=<file>   Append '<file> <previous value>' lines to the\n"
+	     "                        partrt settings <file> when the batch is done.\n"
+	     "-t, --timeout=<s>       Give up on a busy file after <s> seconds.\n"
+	     "                        Default: " STRSTR(DEFAULT_TIMEOUT_S) "\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-apply %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"settings", required_argument, NULL, 's'},
+		{"timeout", required_argument, NULL, 't'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVs:t:";
+	FILE *input = stdin;
+	size_t nr_failed;
+	char *check;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 's':
+			option_settings = optarg;
+			break;
+		case 't':
+			option_timeout = strtol(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_timeout < 0))
+				fail("'%s': Not a valid timeout", optarg);
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind > 1)
+		fail("Expected at most one <file>");
+	if (argc - optind == 1) {
+		input = fopen(argv[optind], "r");
+		if (input == NULL)
+			fail("%s: Could not open: %s", argv[optind],
+			     strerror(errno));
+	}
+
+	nr_failed = apply_batch(input);
+	if (input != stdin)
+		fclose(input);
+	flush_settings();
+	free(settings_buf);
+
+	if (nr_failed > 0)
+		info("%zu operation(s) not applied", nr_failed);
+
+	return 0;
+}
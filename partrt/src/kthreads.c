@@ -0,0 +1,653 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-kthreads: Classifies kernel threads and moves the movable ones off
+ * the CPUs of the RT partition.
+ *
+ * Kernel threads are found through the PF_KTHREAD flag in /proc/<pid>/stat
+ * and classified by name. RCU callback offload threads, kthreadd and the
+ * kernel threads it creates without a CPU binding are pinned to the NRT
+ * CPUs. Threads the kernel binds to a CPU, marked PF_NO_SETAFFINITY, or
+ * whose affinity is managed elsewhere, are left alone. What remains on each
+ * RT CPU is reported together with the reason it could not be moved.
+ *
+ * The previous affinity and policy of each thread that was changed are
+ * saved to a state file, and restored from it by undo. Threads that were
+ * not changed keep whatever affinity the kernel gave them.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STAT_SIZE 1024
+#define COMM_SIZE 64
+#define LIST_SIZE 4096
+#define LINE_SIZE (LIST_SIZE + COMM_SIZE + 64)
+#define PF_KTHREAD 0x00200000
+#define PF_NO_SETAFFINITY 0x04000000
+
+struct class_t {
+	/* Start of the thread name */
+	const char *prefix;
+	/* Non-zero if partrt should set the affinity of the thread */
+	int movable;
+	/* Class when moved, or reason when left on the CPU */
+	const char *reason;
+};
+
+/* First match wins, the empty prefix matches all remaining threads */
+static const struct class_t classes[] = {
+	{"rcuo", 1, "RCU callback offload"},
+	{"kthreadd", 1, "kernel thread creator"},
+	{"ksoftirqd/", 0, "softirqs raised on this CPU, e.g. by local timers"},
+	{"migration/", 0, "CPU stopper, used for migration and CPU hotplug"},
+	{"cpuhp/", 0, "CPU hotplug state machine"},
+	{"idle_inject/", 0, "idle injection"},
+	{"watchdog/", 0, "soft lockup watchdog, disable with nowatchdog"},
+	{"rcuc/", 0, "RCU core processing, offload with rcu_nocbs="},
+	{"kworker/u", 0, "unbound workqueue worker, follows the workqueue cpumask"},
+	{"kworker/R-", 0, "workqueue rescuer, follows the workqueue cpumask"},
+	{"kworker/", 0, "per-CPU workqueue worker, runs work queued on this CPU"},
+	{"irq/", 0, "threaded IRQ handler, follows the IRQ affinity"},
+	{"", 1, "unbound kernel thread"}
+};
+
+struct kthread_t {
+	pid_t pid;
+	char comm[COMM_SIZE];
+	const struct class_t *class;
+	unsigned long flags;
+	/* Policy, priority and affinity before any change */
+	int policy;
+	int rt_priority;
+	cpu_set_t *affinity;
+	/* Why the thread stays, or the result of moving it */
+	const char *result;
+	int moved;
+	int policy_changed;
+};
+
+static int option_dry_run = 0;
+static const char *option_save = NULL;
+static const char *option_restore = NULL;
+static int option_ksoftirqd_prio = 0;
+
+static struct kthread_t *kthreads = NULL;
+static size_t nr_kthreads = 0;
+
+static size_t nr_cpus;
+static size_t affinity_size;
+
+static const struct class_t *classify(const char *comm)
+{
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(classes) / sizeof(classes[0]); idx++)
+		if (strncmp(comm, classes[idx].prefix,
+			    strlen(classes[idx].prefix)) == 0)
+			return &classes[idx];
+
+	return NULL;
+}
+
+/* Skip n space separated fields */
+static const char *skip_fields(const char *str, int n)
+{
+	while (n-- > 0) {
+		str = strchr(str, ' ');
+		if (str == NULL)
+			return NULL;
+		str++;
+	}
+
+	return str;
+}
+
+/* Returns 1 and fills in kthread if pid is a kernel thread, otherwise 0 */
+static int read_kthread(int proc_fd, pid_t pid, struct kthread_t *kthread)
+{
+	char path[32];
+	char stat[STAT_SIZE];
+	const char *comm_start;
+	const char *comm_end;
+	const char *field;
+	size_t comm_len;
+
+	snprintf(path, sizeof(path), "%d/stat", (int) pid);
+	if (sysfs_read_at(proc_fd, path, stat, sizeof(stat)) == -1)
+		return 0;
+
+	comm_start = strchr(stat, '(');
+	comm_end = strrchr(stat, ')');
+	if ((comm_start == NULL) || (comm_end == NULL) || (comm_end[1] == '\0'))
+		return 0;
+
+	/* Field 9, flags */
+	field = skip_fields(comm_end + 2, 6);
+	if (field == NULL)
+		return 0;
+	kthread->flags = strtoul(field, NULL, 10);
+	if ((kthread->flags & PF_KTHREAD) == 0)
+		return 0;
+
+	/* Field 40, rt_priority, and 41, policy */
+	field = skip_fields(field, 31);
+	if (field == NULL)
+		return 0;
+	kthread->rt_priority = atoi(field);
+	field = skip_fields(field, 1);
+	if (field == NULL)
+		return 0;
+	kthread->policy = atoi(field);
+
+	comm_len = (size_t) (comm_end - comm_start - 1);
+	if (comm_len >= sizeof(kthread->comm))
+		comm_len = sizeof(kthread->comm) - 1;
+	memcpy(kthread->comm, comm_start + 1, comm_len);
+	kthread->comm[comm_len] = '\0';
+
+	kthread->pid = pid;
+	kthread->class = classify(kthread->comm);
+	kthread->result = kthread->class->reason;
+	kthread->moved = 0;
+	kthread->policy_changed = 0;
+	kthread->affinity = CPU_ALLOC(nr_cpus);
+	if (sysfs_getaffinity(pid, affinity_size, kthread->affinity) == -1) {
+		CPU_FREE(kthread->affinity);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int open_proc(char *proc, size_t size)
+{
+	int proc_fd;
+
+	sysfs_path(proc, size, "/proc");
+	proc_fd = open(proc, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd == -1)
+		fail("%s: Could not open: %s", proc, strerror(errno));
+
+	return proc_fd;
+}
+
+static void read_kthreads(void)
+{
+	char proc[PATH_MAX];
+	const int proc_fd = open_proc(proc, sizeof(proc));
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir(proc);
+	if (dir == NULL)
+		fail("%s: Could not open: %s", proc, strerror(errno));
+
+	/* Kernel threads are single threaded, /proc/<pid> is enough */
+	while ((entry = readdir(dir)) != NULL) {
+		if (!isdigit((unsigned char) entry->d_name[0]))
+			continue;
+
+		if ((nr_kthreads & 255) == 0)
+			kthreads = checked_realloc(kthreads, (nr_kthreads + 256) *
+						   sizeof(*kthreads));
+		if (read_kthread(proc_fd, (pid_t) atoi(entry->d_name),
+				 &kthreads[nr_kthreads]))
+			nr_kthreads++;
+	}
+
+	closedir(dir);
+	close(proc_fd);
+	debug("Found %zu kernel threads", nr_kthreads);
+}
+
+static int is_movable(const struct kthread_t *kthread)
+{
+	return kthread->class->movable &&
+		((kthread->flags & PF_NO_SETAFFINITY) == 0);
+}
+
+static int on_cpus(const struct kthread_t *kthread, const struct bitmap_t *set)
+{
+	size_t cpu;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		if (CPU_ISSET_S(cpu, affinity_size, kthread->affinity) &&
+		    bitmap_isset(cpu, set))
+			return 1;
+
+	return 0;
+}
+
+/* Format a cpu_set_t as a CPU list, e.g. "0-3,6" */
+static void cpu_set_list(const cpu_set_t *set, char *buf, size_t size)
+{
+	size_t len = 0;
+	size_t cpu = 0;
+
+	buf[0] = '\0';
+	while (cpu < nr_cpus) {
+		size_t last;
+
+		if (!CPU_ISSET_S(cpu, affinity_size, set)) {
+			cpu++;
+			continue;
+		}
+
+		for (last = cpu; (last + 1 < nr_cpus) &&
+			     CPU_ISSET_S(last + 1, affinity_size, set); last++)
+			;
+
+		if (last == cpu)
+			len += (size_t) snprintf(&buf[len], size - len, "%s%zu",
+						 (len > 0) ? "," : "", cpu);
+		else
+			len += (size_t) snprintf(&buf[len], size - len,
+						 "%s%zu-%zu",
+						 (len > 0) ? "," : "", cpu, last);
+		if (len >= size) {
+			buf[size - 1] = '\0';
+			return;
+		}
+		cpu = last + 1;
+	}
+}
+
+static void set_cpus(struct kthread_t *kthread, const struct bitmap_t *set)
+{
+	cpu_set_t *const cpu_set = CPU_ALLOC(nr_cpus);
+	size_t cpu;
+
+	CPU_ZERO_S(affinity_size, cpu_set);
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		if (bitmap_isset(cpu, set))
+			CPU_SET_S(cpu, affinity_size, cpu_set);
+
+	kthread->moved = 1;
+	if (option_dry_run)
+		kthread->result = "dry run";
+	else if (sysfs_setaffinity(kthread->pid, affinity_size, cpu_set) == 0)
+		kthread->result = "ok";
+	else if (errno == EINVAL)
+		/* The kernel refuses, e.g. the thread got bound meanwhile */
+		kthread->result = "affinity fixed by the kernel";
+	else
+		kthread->result = (errno == ESRCH) ? "gone" : strerror(errno);
+
+	if (!option_dry_run && (strcmp(kthread->result, "ok") != 0))
+		kthread->moved = 0;
+
+	CPU_FREE(cpu_set);
+}
+
+static void set_policy(struct kthread_t *kthread, int policy, int prio)
+{
+	const struct sched_param param = { .sched_priority = prio };
+
+	if (option_dry_run || (kthread->policy == policy))
+		return;
+
+	if (sched_setscheduler(kthread->pid, policy, &param) == -1) {
+		info("%s (%d): Could not set scheduling policy: %s",
+		     kthread->comm, (int) kthread->pid, strerror(errno));
+		return;
+	}
+
+	info("%s (%d): Now %s, priority %d", kthread->comm,
+	     (int) kthread->pid,
+	     (policy == SCHED_FIFO) ? "SCHED_FIFO" : "SCHED_OTHER", prio);
+	kthread->policy_changed = 1;
+}
+
+static void isolate(const struct bitmap_t *rt, const struct bitmap_t *nrt)
+{
+	char *const nrt_list = bitmap_list(nrt);
+	size_t nr_moved = 0;
+	size_t cpu;
+	size_t idx;
+
+	for (idx = 0; idx < nr_kthreads; idx++) {
+		struct kthread_t *const kthread = &kthreads[idx];
+
+		if (!on_cpus(kthread, rt))
+			continue;
+
+		if (is_movable(kthread))
+			set_cpus(kthread, nrt);
+		else if (kthread->class->movable)
+			kthread->result = "bound to the CPU by the kernel";
+
+		if ((option_ksoftirqd_prio > 0) &&
+		    (strncmp(kthread->comm, "ksoftirqd/", 10) == 0))
+			set_policy(kthread, SCHED_FIFO, option_ksoftirqd_prio);
+	}
+
+	printf("Kernel threads moved to CPUs %s:\n", nrt_list);
+	printf("%8s  %-24s %-24s %s\n", "PID", "Command", "Class", "Result");
+	for (idx = 0; idx < nr_kthreads; idx++) {
+		const struct kthread_t *const kthread = &kthreads[idx];
+
+		if (!kthread->moved)
+			continue;
+		printf("%8d  %-24s %-24s %s\n", (int) kthread->pid,
+		       kthread->comm, kthread->class->reason, kthread->result);
+		nr_moved++;
+	}
+	if (nr_moved == 0)
+		printf("%8s  none\n", "");
+
+	printf("\nKernel threads remaining on RT CPUs:\n");
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		size_t nr_left = 0;
+
+		if (!bitmap_isset(cpu, rt))
+			continue;
+
+		printf("CPU %zu:\n", cpu);
+		for (idx = 0; idx < nr_kthreads; idx++) {
+			const struct kthread_t *const kthread = &kthreads[idx];
+
+			if (kthread->moved ||
+			    !CPU_ISSET_S(cpu, affinity_size, kthread->affinity))
+				continue;
+			printf("%8d  %-24s %s\n", (int) kthread->pid,
+			       kthread->comm, kthread->result);
+			nr_left++;
+		}
+		if (nr_left == 0)
+			printf("%8s  none\n", "");
+	}
+
+	free(nrt_list);
+}
+
+/* Save the previous state of the threads that isolate() changed, one line
+ * per thread: "<pid> <cpulist> <policy> <priority> <comm>", where cpulist
+ * and policy are "-" if not changed */
+static void save(const char *file)
+{
+	char list[LIST_SIZE];
+	FILE *stream;
+	size_t idx;
+
+	stream = fopen(file, "w");
+	if (stream == NULL)
+		fail("%s: Could not open for writing: %s", file,
+		     strerror(errno));
+
+	for (idx = 0; idx < nr_kthreads; idx++) {
+		const struct kthread_t *const kthread = &kthreads[idx];
+
+		if (!kthread->moved && !kthread->policy_changed)
+			continue;
+
+		if (kthread->moved)
+			cpu_set_list(kthread->affinity, list, sizeof(list));
+		else
+			strcpy(list, "-");
+		if (kthread->policy_changed)
+			fprintf(stream, "%d %s %d %d %s\n", (int) kthread->pid,
+				list, kthread->policy, kthread->rt_priority,
+				kthread->comm);
+		else
+			fprintf(stream, "%d %s - 0 %s\n", (int) kthread->pid,
+				list, kthread->comm);
+	}
+
+	if (fclose(stream) == EOF)
+		fail("%s: Could not write: %s", file, strerror(errno));
+}
+
+/* Give the threads saved in file their previous affinity and policy back.
+ * Threads that are gone, or whose pid now belongs to another thread, are
+ * skipped. */
+static void restore(const char *file)
+{
+	char proc[PATH_MAX];
+	char line[LINE_SIZE];
+	size_t nr_restored = 0;
+	FILE *stream;
+	int proc_fd;
+
+	stream = fopen(file, "r");
+	if (stream == NULL) {
+		if (errno != ENOENT)
+			fail("%s: Could not open: %s", file, strerror(errno));
+		printf("No kernel threads to restore\n");
+		return;
+	}
+
+	proc_fd = open_proc(proc, sizeof(proc));
+	while (fgets(line, sizeof(line), stream) != NULL) {
+		struct kthread_t kthread;
+		char list[LIST_SIZE];
+		char policy[16];
+		const char *comm;
+		int comm_pos = 0;
+		int prio;
+		int pid;
+
+		line[strcspn(line, "\n")] = '\0';
+		if ((sscanf(line, "%d %4095s %15s %d %n", &pid, list, policy,
+			    &prio, &comm_pos) != 4) || (comm_pos == 0))
+			fail("%s: Malformed line: '%s'", file, line);
+		comm = &line[comm_pos];
+
+		if (!read_kthread(proc_fd, (pid_t) pid, &kthread)) {
+			info("%s (%d): Gone, not restored", comm, pid);
+			continue;
+		}
+		if (strcmp(kthread.comm, comm) != 0) {
+			info("%s (%d): Gone, not restored", comm, pid);
+			CPU_FREE(kthread.affinity);
+			continue;
+		}
+
+		if (strcmp(list, "-") != 0) {
+			struct bitmap_t *set;
+
+			parse_scope = file;
+			set = bitmap_alloc_from_list(list);
+			parse_scope = NULL;
+			set_cpus(&kthread, set);
+			bitmap_free(set);
+			if (kthread.moved)
+				nr_restored++;
+			else
+				info("%s (%d): Could not restore affinity %s: %s",
+				     comm, pid, list, kthread.result);
+		}
+		if (strcmp(policy, "-") != 0)
+			set_policy(&kthread, atoi(policy), prio);
+
+		CPU_FREE(kthread.affinity);
+	}
+
+	fclose(stream);
+	close(proc_fd);
+	printf("Restored affinity of %zu kernel threads\n", nr_restored);
+}
+
+static void usage(void)
+{
+	puts("partrt-kthreads - Move kernel threads off the CPUs of a partition\n"
+	     "Usage:\n"
+	     "partrt-kthreads [options] <rt cpulist> <nrt cpulist>\n"
+	     "partrt-kthreads --restore=<file>\n"
+	     "\n"
+	     "Classifies all kernel threads by their flags and name. Movable threads\n"
+	     "on the <rt cpulist> CPUs, e.g. RCU callback offload threads, are pinned to\n"
+	     "the <nrt cpulist> CPUs. Then reports, per RT CPU, the kernel threads that\n"
+	     "remain and why. Normally started by 'partrt create' and 'partrt undo'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-n, --dry-run           Only classify and report, change nothing.\n"
+	     "-s, --ksoftirqd-prio=<prio>\n"
+	     "                        Run ksoftirqd of the RT CPUs with SCHED_FIFO\n"
+	     "                        priority <prio>.\n"
+	     "-S, --save=<file>       Save the previous affinity and policy of the\n"
+	     "                        threads that were changed to <file>.\n"
+	     "-r, --restore=<file>    Give the threads saved in <file> their previous\n"
+	     "                        affinity and policy back. Nothing is done if\n"
+	     "                        <file> does not exist.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Per-CPU threads such as ksoftirqd, migration and per-CPU kworkers cannot be\n"
+	     "moved. Reduce their work with boot parameters such as nohz_full=,\n"
+	     "rcu_nocbs= and isolcpus=managed_irq, see kernel-per-CPU-kthreads.txt.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-kthreads %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"dry-run", no_argument, NULL, 'n'},
+		{"ksoftirqd-prio", required_argument, NULL, 's'},
+		{"save", required_argument, NULL, 'S'},
+		{"restore", required_argument, NULL, 'r'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVns:S:r:";
+	struct bitmap_t *rt = NULL;
+	struct bitmap_t *nrt = NULL;
+	struct bitmap_t *overlap;
+	char *check;
+	size_t idx;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'n':
+			option_dry_run = 1;
+			break;
+		case 's':
+			option_ksoftirqd_prio = (int) strtol(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_ksoftirqd_prio < sched_get_priority_min(SCHED_FIFO)) ||
+			    (option_ksoftirqd_prio > sched_get_priority_max(SCHED_FIFO)))
+				fail("'%s': Not a valid SCHED_FIFO priority", optarg);
+			break;
+		case 'S':
+			option_save = optarg;
+			break;
+		case 'r':
+			option_restore = optarg;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (option_restore != NULL) {
+		if (argc != optind)
+			fail("Expected no arguments with --restore");
+	} else {
+		if (argc - optind != 2)
+			fail("Expected <rt cpulist> <nrt cpulist>");
+
+		parse_scope = argv[optind];
+		rt = bitmap_alloc_from_list(argv[optind]);
+		parse_scope = argv[optind + 1];
+		nrt = bitmap_alloc_from_list(argv[optind + 1]);
+		parse_scope = NULL;
+
+		if ((bitmap_bit_count(rt) == 0) || (bitmap_bit_count(nrt) == 0))
+			fail("Both partitions need at least one CPU");
+		overlap = bitmap_and(rt, nrt);
+		if (bitmap_bit_count(overlap) != 0)
+			fail("'%s', '%s': RT and NRT CPUs overlap",
+			     argv[optind], argv[optind + 1]);
+		bitmap_free(overlap);
+	}
+
+	nr_cpus = sysfs_nr_cpus();
+	affinity_size = CPU_ALLOC_SIZE(nr_cpus);
+
+	if (option_restore != NULL) {
+		restore(option_restore);
+	} else {
+		read_kthreads();
+		isolate(rt, nrt);
+		if ((option_save != NULL) && !option_dry_run)
+			save(option_save);
+	}
+
+	for (idx = 0; idx < nr_kthreads; idx++)
+		CPU_FREE(kthreads[idx].affinity);
+	free(kthreads);
+	if (rt != NULL) {
+		bitmap_free(rt);
+		bitmap_free(nrt);
+	}
+
+	return 0;
+}
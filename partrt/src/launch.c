@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * partrt-run: Starts a command in a partition with its final placement.
+ *
+ * The cpuset, CPU affinity, memory policy and scheduling policy are all
+ * applied before exec(), so the first instruction of the command already
+ * runs where it should. On a cgroup v2 hierarchy the command is created
+ * directly in the target cgroup with clone3(CLONE_INTO_CGROUP). On cgroup
+ * v1, which has no such flag, partrt-run moves itself and then exec()s.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "memory.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <linux/magic.h>
+#include <linux/mempolicy.h>
+#include <linux/sched.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+#define VALUE_SIZE 4096
+
+/* Same layout as the kernel's struct sched_attr, which glibc does not
+ * provide */
+struct launch_sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+static const char *option_prefix = "";
+static const char *option_cpumask = NULL;
+static int option_policy = -1;
+static unsigned int option_priority = 0;
+static uint64_t option_runtime = 0;
+static uint64_t option_deadline = 0;
+static uint64_t option_period = 0;
+static int option_mem_policy = -1;
+static int option_lock = 0;
+static size_t option_stack_size = 0;
+static size_t option_heap_size = 0;
+static int option_huge_pages = 0;
+
+static unsigned int parse_priority(const char *str)
+{
+	char *end;
+	const unsigned long prio = strtoul(str, &end, 0);
+
+	if ((*str == '\0') || (*end != '\0') || (prio > 99))
+		fail("'%s': Not a valid RT priority", str);
+
+	return (unsigned int) prio;
+}
+
+/* Parse "<runtime>,<deadline>,<period>" in nanoseconds */
+static void parse_deadline(const char *str)
+{
+	char *end;
+
+	option_runtime = strtoull(str, &end, 0);
+	if (*end == ',')
+		option_deadline = strtoull(end + 1, &end, 0);
+	if (*end == ',')
+		option_period = strtoull(end + 1, &end, 0);
+
+	if ((*end != '\0') || (option_runtime == 0) ||
+	    (option_deadline < option_runtime) ||
+	    ((option_period != 0) && (option_period < option_deadline)))
+		fail("'%s': Expected <runtime>,<deadline>[,<period>] in ns, with runtime <= deadline <= period",
+		     str);
+}
+
+static int is_cgroup2(const char *dir)
+{
+	struct statfs fs;
+
+	return (statfs(dir, &fs) == 0) && (fs.f_type == CGROUP2_SUPER_MAGIC);
+}
+
+/* Restrict the CPU mask to the CPUs of the partition, or fail */
+static void set_affinity(const char *partition)
+{
+	struct bitmap_t *wanted;
+	struct bitmap_t *allowed;
+	struct bitmap_t *outside;
+	char path[PATH_MAX];
+	char cpus[VALUE_SIZE];
+	cpu_set_t *set;
+	size_t set_size;
+	size_t nr_cpus;
+	size_t cpu;
+
+	snprintf(path, sizeof(path), "%s/%scpus", partition, option_prefix);
+	if (sysfs_read(path, cpus, sizeof(cpus)) == -1)
+		fail("%s: Could not read: %s", path, strerror(errno));
+
+	parse_scope = "CPU mask";
+	wanted = bitmap_alloc_from_u32_list(option_cpumask);
+	parse_scope = NULL;
+	allowed = bitmap_alloc_from_list(cpus);
+
+	/* CPUs in wanted but not in allowed */
+	outside = bitmap_and(wanted, allowed);
+	if (bitmap_bit_count(outside) != bitmap_bit_count(wanted))
+		fail("Invalid cpumask: %s contains one or more CPUs that are not part of %s",
+		     option_cpumask, partition);
+	if (bitmap_bit_count(wanted) == 0)
+		fail("Invalid cpumask: %s contains no CPUs", option_cpumask);
+
+	nr_cpus = sysfs_nr_cpus();
+	set = CPU_ALLOC(nr_cpus);
+	set_size = CPU_ALLOC_SIZE(nr_cpus);
+	CPU_ZERO_S(set_size, set);
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		if (bitmap_isset(cpu, wanted))
+			CPU_SET_S(cpu, set_size, set);
+
+	if (sysfs_setaffinity(0, set_size, set) == -1)
+		fail("sched_setaffinity(%s): %s", option_cpumask,
+		     strerror(errno));
+
+	CPU_FREE(set);
+	bitmap_free(outside);
+	bitmap_free(allowed);
+	bitmap_free(wanted);
+}
+
+static void set_memory(const char *partition)
+{
+	char path[PATH_MAX];
+	char mems[VALUE_SIZE];
+
+	if (option_mem_policy != -1) {
+		snprintf(path, sizeof(path), "%s/%smems", partition,
+			 option_prefix);
+		if (sysfs_read(path, mems, sizeof(mems)) == -1)
+			fail("%s: Could not read: %s", path, strerror(errno));
+		memory_set_policy(option_mem_policy, mems);
+	}
+
+	memory_setup_preload(option_lock, option_stack_size,
+			     option_heap_size, option_huge_pages);
+}
+
+static void set_scheduling(void)
+{
+	struct launch_sched_attr attr;
+
+	if (option_policy == -1)
+		return;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = (uint32_t) option_policy;
+	attr.sched_priority = option_priority;
+	attr.sched_runtime = option_runtime;
+	attr.sched_deadline = option_deadline;
+	attr.sched_period = option_period;
+
+	if (syscall(SYS_sched_setattr, 0, &attr, 0) == -1)
+		fail("sched_setattr(): %s", strerror(errno));
+}
+
+/* Everything but the cgroup, which is set by the caller */
+static void prepare_and_exec(const char *partition, char *argv[])
+{
+	if (option_cpumask != NULL)
+		set_affinity(partition);
+	set_memory(partition);
+	set_scheduling();
+
+	execvp(argv[0], argv);
+	fail("%s: Could not execute: %s", argv[0], strerror(errno));
+}
+
+static pid_t child_pid;
+
+static void forward_signal(int signo)
+{
+	kill(child_pid, signo);
+}
+
+/* Wait for the child, and exit the way it did */
+static void wait_for_child(void)
+{
+	static const int forwarded[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM };
+	struct sigaction action;
+	size_t idx;
+	int status;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = forward_signal;
+	for (idx = 0; idx < sizeof(forwarded) / sizeof(forwarded[0]); idx++)
+		sigaction(forwarded[idx], &action, NULL);
+
+	while (waitpid(child_pid, &status, 0) == -1)
+		if (errno != EINTR)
+			fail("waitpid(): %s", strerror(errno));
+
+	if (WIFSIGNALED(status)) {
+		signal(WTERMSIG(status), SIG_DFL);
+		raise(WTERMSIG(status));
+		exit(128 + WTERMSIG(status));
+	}
+
+	exit(WEXITSTATUS(status));
+}
+
+/* Create the child directly in the cgroup. Returns 0 in the child, and
+ * -1 if clone3() or CLONE_INTO_CGROUP is not supported. */
+static int clone_into_cgroup(const char *partition)
+{
+	struct clone_args args;
+	const int cgroup_fd = open(partition, O_RDONLY | O_DIRECTORY |
+				   O_CLOEXEC);
+	long pid;
+
+	if (cgroup_fd == -1)
+		fail("%s: Could not open: %s", partition, strerror(errno));
+
+	memset(&args, 0, sizeof(args));
+	args.flags = CLONE_INTO_CGROUP;
+	args.exit_signal = (uint64_t) SIGCHLD;
+	args.cgroup = (uint64_t) (unsigned int) cgroup_fd;
+
+	pid = syscall(SYS_clone3, &args, sizeof(args));
+	if (pid == -1) {
+		if ((errno == ENOSYS) || (errno == E2BIG) || (errno == EINVAL)) {
+			info("clone3(CLONE_INTO_CGROUP): %s, moving instead",
+			     strerror(errno));
+			close(cgroup_fd);
+			return -1;
+		}
+		fail("%s: clone3(): %s", partition, strerror(errno));
+	}
+
+	if (pid == 0) {
+		close(cgroup_fd);
+		return 0;
+	}
+
+	close(cgroup_fd);
+	child_pid = (pid_t) pid;
+	wait_for_child();
+
+	return 0;
+}
+
+/* Move the calling process, used where clone3() cannot be */
+static void move_self(const char *partition, int cgroup2)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", partition,
+		 cgroup2 ? "cgroup.procs" : "tasks");
+	if (sysfs_write(path, "0") == -1)
+		fail("%s: Could not move to partition: %s", path,
+		     strerror(errno));
+}
+
+static void usage(void)
+{
+	puts("partrt-run - Run a command in a partition with its final placement\n"
+	     "Usage:\n"
+	     "partrt-run [options] <partition dir> <command> [<argument>...]\n"
+	     "\n"
+	     "Places <command> in the cpuset <partition dir>, and sets its CPU affinity,\n"
+	     "memory policy and scheduling policy before it is executed. Normally\n"
+	     "started by 'partrt run'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-p, --prefix=<prefix>   Prefix of cpuset files, e.g. 'cpuset.'.\n"
+	     "-c, --cpus=<cpumask>    Run on hexadecimal <cpumask>, a subset of the\n"
+	     "                        CPUs of the partition.\n"
+	     "-f, --fifo=<prio>       Use SCHED_FIFO with RT priority <prio>.\n"
+	     "-r, --rr=<prio>         Use SCHED_RR with RT priority <prio>.\n"
+	     "-o, --other             Use SCHED_OTHER.\n"
+	     "-d, --deadline=<runtime>,<deadline>[,<period>]\n"
+	     "                        Use SCHED_DEADLINE, times in nanoseconds.\n"
+	     "-m, --policy=<policy>   Memory policy over the nodes of the partition:\n"
+	     "                        default, bind, preferred, interleave or local.\n"
+	     "-l, --lock              Lock all current and future memory.\n"
+	     "-s, --stack=<size>      Pre-fault <size> bytes of stack.\n"
+	     "-a, --heap=<size>       Pre-fault <size> bytes of heap, kept by malloc().\n"
+	     "-t, --thp               Let malloc() use transparent huge pages.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-run %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"prefix", required_argument, NULL, 'p'},
+		{"cpus", required_argument, NULL, 'c'},
+		{"fifo", required_argument, NULL, 'f'},
+		{"rr", required_argument, NULL, 'r'},
+		{"other", no_argument, NULL, 'o'},
+		{"deadline", required_argument, NULL, 'd'},
+		{"policy", required_argument, NULL, 'm'},
+		{"lock", no_argument, NULL, 'l'},
+		{"stack", required_argument, NULL, 's'},
+		{"heap", required_argument, NULL, 'a'},
+		{"thp", no_argument, NULL, 't'},
+		{NULL, 0, NULL, '\0'}
+	};
+	/* Stop at the command, its options are not ours */
+	static const char short_options[] = "+hvVp:c:f:r:od:m:ls:a:t";
+	const char *partition;
+	int cgroup2;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'p':
+			option_prefix = optarg;
+			break;
+		case 'c':
+			option_cpumask = optarg;
+			break;
+		case 'f':
+			option_policy = SCHED_FIFO;
+			option_priority = parse_priority(optarg);
+			break;
+		case 'r':
+			option_policy = SCHED_RR;
+			option_priority = parse_priority(optarg);
+			break;
+		case 'o':
+			option_policy = SCHED_OTHER;
+			option_priority = 0;
+			break;
+		case 'd':
+			option_policy = SCHED_DEADLINE;
+			option_priority = 0;
+			parse_deadline(optarg);
+			break;
+		case 'm':
+			option_mem_policy = memory_policy_parse(optarg);
+			break;
+		case 'l':
+			option_lock = 1;
+			break;
+		case 's':
+			option_stack_size = memory_parse_size(optarg);
+			break;
+		case 'a':
+			option_heap_size = memory_parse_size(optarg);
+			break;
+		case 't':
+			option_huge_pages = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind >= argc)
+		fail("Missing mandatory partition directory");
+	partition = argv[optind++];
+	if (optind >= argc)
+		fail("No command to execute");
+
+	/* An RT priority is only valid with FIFO and RR */
+	if ((option_policy == SCHED_FIFO || option_policy == SCHED_RR) &&
+	    (option_priority == 0))
+		fail("RT priority must be 1-99");
+
+	cgroup2 = is_cgroup2(partition);
+	if (!cgroup2 || (clone_into_cgroup(partition) == -1))
+		move_self(partition, cgroup2);
+
+	prepare_and_exec(partition, &argv[optind]);
+
+	return 1;
+}
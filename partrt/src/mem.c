@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * partrt-mem: Places memory of RT tasks on the NUMA nodes of their
+ * partition. Either migrates the pages of a running process, or sets the
+ * memory policy and memory preparation for a command and exec()s it.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "memory.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+static void usage(void)
+{
+	puts("partrt-mem - Place memory of RT tasks on NUMA nodes\n"
+	     "Usage:\n"
+	     "partrt-mem [options] <nodes> <command> [<argument>...]\n"
+	     "partrt-mem --migrate=<pid> <nodes>\n"
+	     "\n"
+	     "In the first form, <command> is executed with the given memory policy\n"
+	     "over <nodes>, and with its memory prepared for real-time use before\n"
+	     "main() is called. In the second form, the pages of process <pid> are\n"
+	     "moved to <nodes>. <nodes> is a list such as '0-1,3'. Normally started\n"
+	     "by 'partrt run' and 'partrt move'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-M, --migrate=<pid>     Move pages of process <pid> to <nodes>.\n"
+	     "-m, --policy=<policy>   Memory policy: default, bind, preferred,\n"
+	     "                        interleave or local. Default: bind\n"
+	     "-l, --lock              Lock all current and future memory.\n"
+	     "-s, --stack=<size>      Pre-fault <size> bytes of stack.\n"
+	     "-a, --heap=<size>       Pre-fault <size> bytes of heap, kept by malloc().\n"
+	     "-t, --thp               Let malloc() use transparent huge pages.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Sizes can be given with a k, M or G suffix. The preparation is done by\n"
+	     "a library loaded with LD_PRELOAD, in <command> only. Unlike the memory\n"
+	     "policy it is not inherited by the programs <command> starts.");
+}
+
+static void version(void)
+{
+	printf("partrt-mem %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"migrate", required_argument, NULL, 'M'},
+		{"policy", required_argument, NULL, 'm'},
+		{"lock", no_argument, NULL, 'l'},
+		{"stack", required_argument, NULL, 's'},
+		{"heap", required_argument, NULL, 'a'},
+		{"thp", no_argument, NULL, 't'},
+		{NULL, 0, NULL, '\0'}
+	};
+	/* Stop at the command, its options are not ours */
+	static const char short_options[] = "+hvVM:m:ls:a:t";
+	int policy = MPOL_BIND;
+	pid_t migrate_pid = 0;
+	int lock = 0;
+	size_t stack_size = 0;
+	size_t heap_size = 0;
+	int huge_pages = 0;
+	const char *nodes;
+	char *check;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'M':
+			migrate_pid = (pid_t) strtol(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (migrate_pid <= 0))
+				fail("'%s': Not a valid PID", optarg);
+			break;
+		case 'm':
+			policy = memory_policy_parse(optarg);
+			break;
+		case 'l':
+			lock = 1;
+			break;
+		case 's':
+			stack_size = memory_parse_size(optarg);
+			break;
+		case 'a':
+			heap_size = memory_parse_size(optarg);
+			break;
+		case 't':
+			huge_pages = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind >= argc)
+		fail("Missing mandatory NUMA node list");
+	nodes = argv[optind++];
+
+	if (migrate_pid != 0) {
+		long not_moved;
+
+		if (optind < argc)
+			fail("No command expected with --migrate");
+		not_moved = memory_migrate(migrate_pid, nodes);
+		info("PID %d: Migrated to nodes %s, %ld pages could not be moved",
+		     (int) migrate_pid, nodes, not_moved);
+		return 0;
+	}
+
+	if (optind >= argc)
+		fail("No command to execute");
+
+	memory_set_policy(policy, nodes);
+	memory_setup_preload(lock, stack_size, heap_size, huge_pages);
+
+	execvp(argv[optind], &argv[optind]);
+	fail("%s: Could not execute: %s", argv[optind], strerror(errno));
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements NUMA memory placement helpers. The system calls are
+ * used directly, so that libnuma is not needed.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "memory.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#define BITS_PER_LONG (sizeof(unsigned long) * CHAR_BIT)
+
+#ifndef PARTRT_PRELOAD_PATH
+#define PARTRT_PRELOAD_PATH "/usr/local/lib/partrt/libpartrt-preload.so"
+#endif
+
+static const struct {
+	const char *name;
+	int mode;
+} policies[] = {
+	{"default", MPOL_DEFAULT},
+	{"bind", MPOL_BIND},
+	{"preferred", MPOL_PREFERRED},
+	{"interleave", MPOL_INTERLEAVE},
+	{"local", MPOL_LOCAL},
+	{NULL, 0}
+};
+
+int memory_policy_parse(const char *name)
+{
+	int idx;
+
+	for (idx = 0; policies[idx].name != NULL; idx++)
+		if (strcmp(name, policies[idx].name) == 0)
+			return policies[idx].mode;
+
+	fail("'%s': Unknown memory policy, expected default, bind, preferred, interleave or local",
+	     name);
+}
+
+size_t memory_parse_size(const char *str)
+{
+	char *end;
+	unsigned long long size = strtoull(str, &end, 0);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		size <<= 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		size <<= 20;
+		end++;
+		break;
+	case 'g':
+	case 'G':
+		size <<= 30;
+		end++;
+		break;
+	default:
+		break;
+	}
+
+	if ((end == str) || (*end != '\0') || (*str == '-'))
+		fail("'%s': Not a valid size", str);
+
+	return (size_t) size;
+}
+
+/* Number of bits the kernel wants in a node mask */
+static unsigned long nr_possible_nodes(void)
+{
+	char path[PATH_MAX];
+	char possible[256];
+	struct bitmap_t *nodes;
+	size_t nr_nodes;
+
+	sysfs_path(path, sizeof(path), "/sys/devices/system/node/possible");
+	if (sysfs_read(path, possible, sizeof(possible)) == -1)
+		return BITS_PER_LONG;
+
+	/* One more than the highest possible node, which need not be the
+	 * last number of the list, e.g. "0-3,5" */
+	nodes = bitmap_alloc_from_list(possible);
+	for (nr_nodes = bitmap_nr_bits(nodes);
+	     (nr_nodes > 0) && !bitmap_isset(nr_nodes - 1, nodes); nr_nodes--)
+		;
+	bitmap_free(nodes);
+
+	return (nr_nodes == 0) ? 1 : nr_nodes;
+}
+
+/* Allocate a kernel node mask from a node list. maxnode is set to the
+ * number of bits for the system calls. */
+static unsigned long *nodemask_alloc(const char *nodes,
+				     unsigned long *maxnode)
+{
+	struct bitmap_t *const set = bitmap_alloc_from_list(nodes);
+	const unsigned long nr_nodes = nr_possible_nodes();
+	const size_t nr_longs = nr_nodes / BITS_PER_LONG + 1;
+	unsigned long *const mask = checked_malloc(nr_longs *
+						   sizeof(unsigned long));
+	size_t node;
+
+	memset(mask, 0, nr_longs * sizeof(unsigned long));
+	for (node = 0; node < nr_longs * BITS_PER_LONG; node++) {
+		if (!bitmap_isset(node, set))
+			continue;
+		if (node >= nr_nodes)
+			fail("'%s': Node %zu does not exist", nodes, node);
+		mask[node / BITS_PER_LONG] |= 1UL << (node % BITS_PER_LONG);
+	}
+	bitmap_free(set);
+
+	/* The kernel ignores the last bit of maxnode */
+	*maxnode = nr_longs * BITS_PER_LONG;
+
+	return mask;
+}
+
+void memory_set_policy(int mode, const char *nodes)
+{
+	unsigned long maxnode = 0;
+	unsigned long *mask = NULL;
+
+	/* The local and default policies take no nodes */
+	if ((mode != MPOL_LOCAL) && (mode != MPOL_DEFAULT))
+		mask = nodemask_alloc(nodes, &maxnode);
+
+	if (syscall(SYS_set_mempolicy, mode, mask, maxnode) == -1)
+		fail("set_mempolicy(%s): %s", nodes, strerror(errno));
+
+	free(mask);
+}
+
+long memory_migrate(pid_t pid, const char *nodes)
+{
+	unsigned long maxnode;
+	unsigned long *const new_nodes = nodemask_alloc(nodes, &maxnode);
+	unsigned long *const old_nodes = checked_malloc(maxnode / CHAR_BIT);
+	long status;
+
+	/* Move from every node that is not a target */
+	memset(old_nodes, 0xff, maxnode / CHAR_BIT);
+
+	status = syscall(SYS_migrate_pages, pid, maxnode, old_nodes,
+			 new_nodes);
+	if (status == -1)
+		fail("migrate_pages(%d, %s): %s", (int) pid, nodes,
+		     strerror(errno));
+
+	free(old_nodes);
+	free(new_nodes);
+
+	return status;
+}
+
+static void setenv_size(const char *name, size_t size)
+{
+	char value[32];
+
+	snprintf(value, sizeof(value), "%zu", size);
+	if (setenv(name, value, 1) == -1)
+		fail("setenv(%s): %s", name, strerror(errno));
+}
+
+void memory_setup_preload(int lock, size_t stack_size, size_t heap_size,
+			  int huge_pages)
+{
+	const char *library = getenv(MEMORY_ENV_PRELOAD_LIB);
+	const char *old_preload = getenv("LD_PRELOAD");
+	const char *old_tunables = getenv("GLIBC_TUNABLES");
+	char *value;
+
+	if (huge_pages) {
+		/* glibc 2.35 and later madvise() the heap for THP */
+		if (asprintf(&value, "%s%sglibc.malloc.hugetlb=1",
+			     (old_tunables != NULL) ? old_tunables : "",
+			     (old_tunables != NULL) ? ":" : "") == -1)
+			fail("Out of memory, aborting");
+		setenv("GLIBC_TUNABLES", value, 1);
+		free(value);
+	}
+
+	if (!lock && (stack_size == 0) && (heap_size == 0))
+		return;
+
+	if (library == NULL)
+		library = PARTRT_PRELOAD_PATH;
+	if (access(library, R_OK) == -1)
+		fail("%s: Preload library not found: %s", library,
+		     strerror(errno));
+
+	if (lock)
+		setenv(MEMORY_ENV_MLOCK, "1", 1);
+	if (stack_size > 0)
+		setenv_size(MEMORY_ENV_PREFAULT_STACK, stack_size);
+	if (heap_size > 0)
+		setenv_size(MEMORY_ENV_PREFAULT_HEAP, heap_size);
+
+	/* Also set when there was none, it tells the library that the
+	 * LD_PRELOAD of the RT task is to be put back */
+	setenv(MEMORY_ENV_OLD_PRELOAD,
+	       (old_preload != NULL) ? old_preload : "", 1);
+
+	if (asprintf(&value, "%s%s%s", library,
+		     (old_preload != NULL) ? ":" : "",
+		     (old_preload != NULL) ? old_preload : "") == -1)
+		fail("Out of memory, aborting");
+	setenv("LD_PRELOAD", value, 1);
+	free(value);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Helpers for NUMA memory placement and for preparing memory of RT tasks.
+ */
+
+/* Environment variables read by the preload library. Memory locking and
+ * pre-faulting do not survive exec(), so they are done by a constructor in
+ * a library injected with LD_PRELOAD. The constructor removes the variables
+ * and puts back the LD_PRELOAD saved in MEMORY_ENV_OLD_PRELOAD, so that
+ * programs started by the RT task are not prepared again. */
+#define MEMORY_ENV_MLOCK "PARTRT_MLOCK"
+#define MEMORY_ENV_PREFAULT_STACK "PARTRT_PREFAULT_STACK"
+#define MEMORY_ENV_PREFAULT_HEAP "PARTRT_PREFAULT_HEAP"
+#define MEMORY_ENV_OLD_PRELOAD "PARTRT_OLD_PRELOAD"
+#define MEMORY_ENV_PRELOAD_LIB "PARTRT_PRELOAD_LIB"
+
+/* Memory policy names as used on the command line, e.g. "interleave".
+ * Returns the MPOL_* mode, or fails. */
+extern int memory_policy_parse(const char *name);
+
+/* Parse a size with an optional k, M or G suffix, or fail */
+extern size_t memory_parse_size(const char *str);
+
+/* Set memory policy mode over the nodes in list, e.g. "0-1", for the
+ * calling thread. The policy is inherited over fork() and exec(). */
+extern void memory_set_policy(int mode, const char *nodes);
+
+/* Move all pages of process pid to the nodes in list. Returns number of
+ * pages that could not be moved, or fails. */
+extern long memory_migrate(pid_t pid, const char *nodes);
+
+/* Prepare the environment so that the preload library locks memory,
+ * pre-faults stack_size bytes of stack and heap_size bytes of heap before
+ * main() of the next exec()'d program. With huge_pages, glibc malloc is
+ * told to use transparent huge pages. */
+extern void memory_setup_preload(int lock, size_t stack_size,
+				 size_t heap_size, int huge_pages);
+
+#endif
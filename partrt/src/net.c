@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-net: Steers network receive and transmit processing away from the
+ * CPUs of the RT partition.
+ *
+ * The RPS mask of every receive queue and the XPS mask of every transmit
+ * queue are rewritten, so that softirq work queued by the network stack
+ * lands on the given CPUs. Optionally the RFS flow tables are sized. Each
+ * file changed is printed on stdout together with its previous value, in
+ * the format of the partrt settings file, so that 'partrt undo' can
+ * restore it.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VALUE_SIZE 1024
+#define SYSFS_NET_DIR "/sys/class/net"
+#define RPS_SOCK_FLOW_ENTRIES "/proc/sys/net/core/rps_sock_flow_entries"
+
+static const char *option_sysfs = SYSFS_NET_DIR;
+static const char *option_flow_file = RPS_SOCK_FLOW_ENTRIES;
+static long option_flow_entries = -1;
+static int option_no_xps = 0;
+static int option_reset = 0;
+
+static size_t nr_failed = 0;
+
+/* Write value to file, and log the previous value on stdout if it changed */
+static void apply(const char *file, const char *value)
+{
+	char old_value[VALUE_SIZE];
+
+	switch (sysfs_replace(file, value, old_value, sizeof(old_value))) {
+	case -1:
+		info("%s: Could not write '%s': %s", file, value,
+		     strerror(errno));
+		nr_failed++;
+		break;
+	case 1:
+		if (!option_reset)
+			printf("%s %s\n", file, old_value);
+		debug("echo %s > %s", value, file);
+		break;
+	}
+}
+
+static int is_queue(const char *name, const char *prefix)
+{
+	const size_t len = strlen(prefix);
+
+	return (strncmp(name, prefix, len) == 0) && (name[len] != '\0');
+}
+
+static void steer_device(const char *device, const char *mask)
+{
+	char dir[PATH_MAX];
+	char path[PATH_MAX + NAME_MAX + 16];
+	char flow_cnt[32];
+	struct dirent *entry;
+	size_t nr_rx = 0;
+	DIR *queues;
+
+	snprintf(dir, sizeof(dir), "%s/%s/queues", option_sysfs, device);
+	queues = opendir(dir);
+	if (queues == NULL) {
+		debug("%s: No queues: %s", dir, strerror(errno));
+		return;
+	}
+
+	/* The flow entries are shared by the receive queues of the device,
+	 * which may have none, e.g. a transmit only device */
+	while ((entry = readdir(queues)) != NULL)
+		if (is_queue(entry->d_name, "rx-"))
+			nr_rx++;
+	if ((option_flow_entries > 0) && (nr_rx > 0))
+		snprintf(flow_cnt, sizeof(flow_cnt), "%zu",
+			 ((size_t) option_flow_entries + nr_rx - 1) / nr_rx);
+	else
+		strcpy(flow_cnt, "0");
+
+	rewinddir(queues);
+	while ((entry = readdir(queues)) != NULL) {
+		if (is_queue(entry->d_name, "rx-")) {
+			snprintf(path, sizeof(path), "%s/%s/rps_cpus", dir,
+				 entry->d_name);
+			apply(path, mask);
+			if (option_reset || (option_flow_entries >= 0)) {
+				snprintf(path, sizeof(path), "%s/%s/rps_flow_cnt",
+					 dir, entry->d_name);
+				apply(path, flow_cnt);
+			}
+		} else if (is_queue(entry->d_name, "tx-") && !option_no_xps) {
+			snprintf(path, sizeof(path), "%s/%s/xps_cpus", dir,
+				 entry->d_name);
+			/* Not there for single queue devices */
+			if (access(path, F_OK) == 0)
+				apply(path, mask);
+		}
+	}
+
+	closedir(queues);
+	info("%s: %zu receive queues steered to mask %s", device, nr_rx, mask);
+}
+
+static void usage(void)
+{
+	puts("partrt-net - Steer network processing to the CPUs of a partition\n"
+	     "Usage:\n"
+	     "partrt-net [options] <cpumask>\n"
+	     "partrt-net --reset\n"
+	     "\n"
+	     "Sets the RPS mask of all receive queues and the XPS mask of all transmit\n"
+	     "queues of all network devices to hexadecimal <cpumask>. Each file changed\n"
+	     "is printed with its previous value, in the format of the partrt settings\n"
+	     "file. Normally started by 'partrt create'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-f, --flow-entries=<n>  Size the RFS socket flow table to <n> entries, and\n"
+	     "                        split them between the receive queues of each\n"
+	     "                        device. 0 disables RFS.\n"
+	     "-x, --no-xps            Leave the XPS masks alone.\n"
+	     "-r, --reset             Clear all RPS and XPS masks and disable RFS, the\n"
+	     "                        kernel default. Nothing is printed.\n"
+	     "-s, --sysfs=<dir>       Network device directory of sysfs.\n"
+	     "                        Default: " SYSFS_NET_DIR "\n"
+	     "-F, --flow-file=<file>  RFS socket flow table size file.\n"
+	     "                        Default: " RPS_SOCK_FLOW_ENTRIES "\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-net %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"flow-entries", required_argument, NULL, 'f'},
+		{"no-xps", no_argument, NULL, 'x'},
+		{"reset", no_argument, NULL, 'r'},
+		{"sysfs", required_argument, NULL, 's'},
+		{"flow-file", required_argument, NULL, 'F'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVf:xrs:F:";
+	static char sysfs_dir[PATH_MAX];
+	static char flow_file[PATH_MAX];
+	struct dirent *entry;
+	char *mask;
+	char value[32];
+	char *check;
+	DIR *dir;
+	int c;
+
+	sysfs_path(sysfs_dir, sizeof(sysfs_dir), SYSFS_NET_DIR);
+	option_sysfs = sysfs_dir;
+	sysfs_path(flow_file, sizeof(flow_file), RPS_SOCK_FLOW_ENTRIES);
+	option_flow_file = flow_file;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'f':
+			option_flow_entries = strtol(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_flow_entries < 0))
+				fail("'%s': Not a valid number of flow entries",
+				     optarg);
+			break;
+		case 'x':
+			option_no_xps = 1;
+			break;
+		case 'r':
+			option_reset = 1;
+			break;
+		case 's':
+			option_sysfs = optarg;
+			break;
+		case 'F':
+			option_flow_file = optarg;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (option_reset) {
+		if ((argc != optind) || (option_flow_entries >= 0))
+			fail("--reset cannot be combined with other settings");
+		mask = strdup("0");
+		if (mask == NULL)
+			fail("Out of memory, aborting");
+	} else {
+		struct bitmap_t *set;
+
+		if (argc - optind != 1)
+			fail("Expected <cpumask>");
+		parse_scope = argv[optind];
+		set = bitmap_alloc_from_u32_list(argv[optind]);
+		parse_scope = NULL;
+		if (bitmap_bit_count(set) == 0)
+			fail("'%s': No CPUs given", argv[optind]);
+		mask = bitmap_u32list(set);
+		bitmap_free(set);
+	}
+
+	if (option_reset || (option_flow_entries >= 0)) {
+		snprintf(value, sizeof(value), "%ld",
+			 option_reset ? 0 : option_flow_entries);
+		apply(option_flow_file, value);
+	}
+
+	dir = opendir(option_sysfs);
+	if (dir == NULL)
+		fail("%s: Could not open: %s", option_sysfs, strerror(errno));
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		steer_device(entry->d_name, mask);
+	}
+	closedir(dir);
+
+	if (nr_failed > 0)
+		fprintf(stderr, "WARNING: %zu network queue settings could not be changed, use -v for details\n",
+			nr_failed);
+
+	free(mask);
+
+	return 0;
+}
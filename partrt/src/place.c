@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * partrt-place: Moves a whole thread group into a partition and places each
+ * thread on CPUs of the partition.
+ *
+ * Threads are matched by TID or by a regular expression on their name, and
+ * mapped onto CPUs by rules. Threads not matched by any rule are placed by a
+ * policy: on all CPUs, spread with one thread per core, or packed onto as
+ * few cores as possible. All placements are computed and checked first, and
+ * then applied in one pass, followed by a report.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <regex.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VALUE_SIZE 4096
+#define COMM_SIZE 64
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+enum policy_t {
+	POLICY_ALL,
+	POLICY_SPREAD,
+	POLICY_PACK
+};
+
+struct rule_t {
+	const char *text;
+	pid_t tid;
+	regex_t regex;
+	struct bitmap_t *cpus;
+};
+
+struct thread_t {
+	pid_t tid;
+	char comm[COMM_SIZE];
+	/* Rule that matched, or NULL if placed by the policy */
+	const struct rule_t *rule;
+	/* The CPU chosen by spread or pack, otherwise -1 */
+	long cpu;
+	const char *result;
+};
+
+static const char *option_prefix = "";
+static const char *option_cpumask = NULL;
+static enum policy_t option_policy = POLICY_ALL;
+static int option_single = 0;
+static int option_dry_run = 0;
+
+static struct rule_t *rules = NULL;
+static size_t nr_rules = 0;
+
+static struct thread_t *threads = NULL;
+static size_t nr_threads = 0;
+
+static size_t nr_cpus;
+
+static void add_rule(const char *text)
+{
+	const char *const equal = strrchr(text, '=');
+	struct rule_t *rule;
+	char *match;
+	char *check;
+	int status;
+
+	if ((equal == NULL) || (equal == text) || (equal[1] == '\0'))
+		fail("'%s': Expected <TID or regex>=<CPU list>", text);
+
+	rules = checked_realloc(rules, (nr_rules + 1) * sizeof(*rules));
+	rule = &rules[nr_rules++];
+	rule->text = text;
+
+	match = strndup(text, (size_t) (equal - text));
+	if (match == NULL)
+		fail("Out of memory, aborting");
+
+	rule->tid = (pid_t) strtol(match, &check, 10);
+	if (*check != '\0') {
+		rule->tid = 0;
+		status = regcomp(&rule->regex, match, REG_EXTENDED | REG_NOSUB);
+		if (status != 0) {
+			char error[256];
+
+			regerror(status, &rule->regex, error, sizeof(error));
+			fail("'%s': Bad regular expression: %s", match, error);
+		}
+	}
+	free(match);
+
+	parse_scope = text;
+	rule->cpus = bitmap_alloc_from_list(equal + 1);
+	parse_scope = NULL;
+}
+
+static const struct rule_t *match_rule(const struct thread_t *thread)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_rules; idx++) {
+		if (rules[idx].tid != 0) {
+			if (rules[idx].tid == thread->tid)
+				return &rules[idx];
+		} else if (regexec(&rules[idx].regex, thread->comm, 0, NULL,
+				   0) == 0) {
+			return &rules[idx];
+		}
+	}
+
+	return NULL;
+}
+
+static void add_thread(pid_t pid, pid_t tid)
+{
+	char path[PATH_MAX];
+	struct thread_t *thread;
+
+	threads = checked_realloc(threads, (nr_threads + 1) * sizeof(*threads));
+	thread = &threads[nr_threads++];
+	thread->tid = tid;
+	thread->cpu = -1;
+	thread->result = "";
+
+	sysfs_path(path, sizeof(path), "/proc/%d/task/%d/comm", (int) pid,
+		   (int) tid);
+	if (sysfs_read(path, thread->comm, sizeof(thread->comm)) == -1)
+		snprintf(thread->comm, sizeof(thread->comm), "?");
+}
+
+static int thread_compare(const void *first, const void *second)
+{
+	const struct thread_t *const a = first;
+	const struct thread_t *const b = second;
+
+	return (a->tid > b->tid) - (a->tid < b->tid);
+}
+
+static void read_threads(pid_t pid)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+
+	if (option_single) {
+		add_thread(pid, pid);
+		return;
+	}
+
+	sysfs_path(path, sizeof(path), "/proc/%d/task", (int) pid);
+	dir = opendir(path);
+	if (dir == NULL)
+		fail("Task ID %d does not exist", (int) pid);
+
+	while ((entry = readdir(dir)) != NULL)
+		if (isdigit((unsigned char) entry->d_name[0]))
+			add_thread(pid, (pid_t) atoi(entry->d_name));
+	closedir(dir);
+
+	qsort(threads, nr_threads, sizeof(*threads), thread_compare);
+}
+
+/* Identify the core of a CPU as package << 32 | core */
+static unsigned long long cpu_core(size_t cpu)
+{
+	char path[PATH_MAX];
+	char value[32];
+	unsigned long long package = 0;
+	unsigned long long core = cpu;
+
+	sysfs_path(path, sizeof(path), "%s/cpu%zu/topology/physical_package_id",
+		   SYSFS_CPU_DIR, cpu);
+	if (sysfs_read(path, value, sizeof(value)) == 0)
+		package = strtoull(value, NULL, 10);
+	sysfs_path(path, sizeof(path), "%s/cpu%zu/topology/core_id",
+		   SYSFS_CPU_DIR, cpu);
+	if (sysfs_read(path, value, sizeof(value)) == 0)
+		core = strtoull(value, NULL, 10);
+
+	return (package << 32) | core;
+}
+
+struct cpu_slot_t {
+	size_t cpu;
+	unsigned long long core;
+	/* Which sibling of the core this is, 0 for the first */
+	size_t sibling;
+};
+
+static int slot_compare_spread(const void *first, const void *second)
+{
+	const struct cpu_slot_t *const a = first;
+	const struct cpu_slot_t *const b = second;
+
+	if (a->sibling != b->sibling)
+		return (a->sibling > b->sibling) - (a->sibling < b->sibling);
+
+	return (a->cpu > b->cpu) - (a->cpu < b->cpu);
+}
+
+static int slot_compare_pack(const void *first, const void *second)
+{
+	const struct cpu_slot_t *const a = first;
+	const struct cpu_slot_t *const b = second;
+
+	if (a->core != b->core)
+		return (a->core > b->core) - (a->core < b->core);
+
+	return (a->cpu > b->cpu) - (a->cpu < b->cpu);
+}
+
+/* Order the CPUs in set in which threads are given them. Spread takes the
+ * first sibling of every core before any second sibling, pack fills all
+ * siblings of a core before the next core. */
+static size_t order_cpus(const struct bitmap_t *set, size_t **order)
+{
+	struct cpu_slot_t *const slots =
+		checked_malloc(nr_cpus * sizeof(*slots));
+	size_t nr_slots = 0;
+	size_t cpu;
+	size_t idx;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (!bitmap_isset(cpu, set))
+			continue;
+		slots[nr_slots].cpu = cpu;
+		slots[nr_slots].core = cpu_core(cpu);
+		slots[nr_slots].sibling = 0;
+		for (idx = 0; idx < nr_slots; idx++)
+			if (slots[idx].core == slots[nr_slots].core)
+				slots[nr_slots].sibling++;
+		nr_slots++;
+	}
+
+	qsort(slots, nr_slots, sizeof(*slots),
+	      (option_policy == POLICY_SPREAD) ? slot_compare_spread :
+	      slot_compare_pack);
+
+	*order = checked_malloc((nr_slots + 1) * sizeof(size_t));
+	for (idx = 0; idx < nr_slots; idx++)
+		(*order)[idx] = slots[idx].cpu;
+	free(slots);
+
+	return nr_slots;
+}
+
+static void format_set(const struct bitmap_t *set, char *buf, size_t size)
+{
+	char *const list = bitmap_list(set);
+
+	snprintf(buf, size, "%s", list);
+	free(list);
+}
+
+static void set_affinity(pid_t tid, const struct bitmap_t *set,
+			 long single_cpu, struct thread_t *thread)
+{
+	cpu_set_t *const cpu_set = CPU_ALLOC(nr_cpus);
+	const size_t set_size = CPU_ALLOC_SIZE(nr_cpus);
+	size_t cpu;
+
+	CPU_ZERO_S(set_size, cpu_set);
+	if (single_cpu >= 0) {
+		CPU_SET_S((size_t) single_cpu, set_size, cpu_set);
+	} else {
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			if (bitmap_isset(cpu, set))
+				CPU_SET_S(cpu, set_size, cpu_set);
+	}
+
+	if (sysfs_setaffinity(tid, set_size, cpu_set) == 0)
+		thread->result = "ok";
+	else
+		thread->result = (errno == ESRCH) ? "gone" : strerror(errno);
+
+	CPU_FREE(cpu_set);
+}
+
+static void move_to_partition(const char *partition, pid_t pid)
+{
+	char path[PATH_MAX];
+	char value[16];
+
+	/* cgroup.procs moves all threads of the process at once */
+	snprintf(path, sizeof(path), "%s/%s", partition,
+		 option_single ? "tasks" : "cgroup.procs");
+	snprintf(value, sizeof(value), "%d", (int) pid);
+	if (sysfs_write(path, value) == -1)
+		fail("%s: Could not move %d: %s", path, (int) pid,
+		     strerror(errno));
+}
+
+static void usage(void)
+{
+	puts("partrt-place - Move a thread group into a partition and place its threads\n"
+	     "Usage:\n"
+	     "partrt-place [options] <pid> <partition dir>\n"
+	     "\n"
+	     "Moves all threads of process <pid> into the cpuset <partition dir>, and\n"
+	     "sets the CPU affinity of each thread. Normally started by 'partrt move'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-p, --prefix=<prefix>   Prefix of cpuset files, e.g. 'cpuset.'.\n"
+	     "-c, --cpus=<cpumask>    Only use CPUs in hexadecimal <cpumask>, a subset\n"
+	     "                        of the CPUs of the partition.\n"
+	     "-r, --rule=<match>=<list>\n"
+	     "                        Place threads matching <match> on the CPUs in\n"
+	     "                        <list>, e.g. '3-4'. <match> is a TID or an\n"
+	     "                        extended regular expression on the thread name.\n"
+	     "                        Can be given multiple times, first match wins.\n"
+	     "-P, --policy=<policy>   Placement of threads not matched by a rule:\n"
+	     "                        all:    On all CPUs. Default.\n"
+	     "                        spread: One thread per CPU, one per core first.\n"
+	     "                        pack:   One thread per CPU, filling a core's\n"
+	     "                                siblings before the next core.\n"
+	     "-s, --single            Only move thread <pid>, not its thread group.\n"
+	     "-n, --dry-run           Only print the placement.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "With spread or pack, CPUs are reused from the start when there are more\n"
+	     "threads than CPUs.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-place %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"prefix", required_argument, NULL, 'p'},
+		{"cpus", required_argument, NULL, 'c'},
+		{"rule", required_argument, NULL, 'r'},
+		{"policy", required_argument, NULL, 'P'},
+		{"single", no_argument, NULL, 's'},
+		{"dry-run", no_argument, NULL, 'n'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVp:c:r:P:sn";
+	struct bitmap_t *allowed;
+	char path[PATH_MAX];
+	char value[VALUE_SIZE];
+	const char *partition;
+	size_t *order = NULL;
+	size_t nr_order = 0;
+	size_t next_slot = 0;
+	pid_t pid;
+	char *check;
+	size_t idx;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'p':
+			option_prefix = optarg;
+			break;
+		case 'c':
+			option_cpumask = optarg;
+			break;
+		case 'r':
+			add_rule(optarg);
+			break;
+		case 'P':
+			if (strcmp(optarg, "all") == 0)
+				option_policy = POLICY_ALL;
+			else if (strcmp(optarg, "spread") == 0)
+				option_policy = POLICY_SPREAD;
+			else if (strcmp(optarg, "pack") == 0)
+				option_policy = POLICY_PACK;
+			else
+				fail("'%s': Unknown policy, expected all, spread or pack",
+				     optarg);
+			break;
+		case 's':
+			option_single = 1;
+			break;
+		case 'n':
+			option_dry_run = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind != 2)
+		fail("Expected <pid> <partition dir>");
+
+	pid = (pid_t) strtol(argv[optind], &check, 10);
+	if ((*argv[optind] == '\0') || (*check != '\0') || (pid <= 0))
+		fail("'%s': Not a valid PID", argv[optind]);
+	partition = argv[optind + 1];
+
+	nr_cpus = sysfs_nr_cpus();
+
+	snprintf(path, sizeof(path), "%s/%scpus", partition, option_prefix);
+	if (sysfs_read(path, value, sizeof(value)) == -1)
+		fail("%s: Could not read: %s", path, strerror(errno));
+	allowed = bitmap_alloc_from_list(value);
+
+	if (option_cpumask != NULL) {
+		struct bitmap_t *wanted;
+		struct bitmap_t *inside;
+
+		parse_scope = "CPU mask";
+		wanted = bitmap_alloc_from_u32_list(option_cpumask);
+		parse_scope = NULL;
+		inside = bitmap_and(wanted, allowed);
+		if (bitmap_bit_count(inside) != bitmap_bit_count(wanted))
+			fail("Invalid cpumask: %s contains one or more CPUs that are not part of %s",
+			     option_cpumask, partition);
+		bitmap_free(allowed);
+		bitmap_free(wanted);
+		allowed = inside;
+	}
+	if (bitmap_bit_count(allowed) == 0)
+		fail("%s: No CPUs to place threads on", partition);
+
+	for (idx = 0; idx < nr_rules; idx++) {
+		struct bitmap_t *const inside = bitmap_and(rules[idx].cpus,
+							   allowed);
+
+		if ((bitmap_bit_count(inside) != bitmap_bit_count(rules[idx].cpus)) ||
+		    (bitmap_bit_count(inside) == 0))
+			fail("'%s': CPUs must be a non-empty subset of the partition",
+			     rules[idx].text);
+		bitmap_free(inside);
+	}
+
+	read_threads(pid);
+
+	/* Compute all placements before changing anything */
+	if (option_policy != POLICY_ALL)
+		nr_order = order_cpus(allowed, &order);
+	for (idx = 0; idx < nr_threads; idx++) {
+		threads[idx].rule = match_rule(&threads[idx]);
+		if ((threads[idx].rule == NULL) && (nr_order > 0)) {
+			threads[idx].cpu = (long) order[next_slot];
+			next_slot = (next_slot + 1) % nr_order;
+		}
+	}
+
+	if (!option_dry_run) {
+		move_to_partition(partition, pid);
+		for (idx = 0; idx < nr_threads; idx++)
+			set_affinity(threads[idx].tid,
+				     (threads[idx].rule != NULL) ?
+				     threads[idx].rule->cpus : allowed,
+				     threads[idx].cpu, &threads[idx]);
+	}
+
+	printf("%7s %-16s %-12s %-8s%s\n", "TID", "Command", "CPUs", "Rule",
+	       option_dry_run ? "" : " Result");
+	for (idx = 0; idx < nr_threads; idx++) {
+		const struct thread_t *const thread = &threads[idx];
+		char rule[16];
+
+		if (thread->cpu >= 0)
+			snprintf(value, sizeof(value), "%ld", thread->cpu);
+		else
+			format_set((thread->rule != NULL) ? thread->rule->cpus :
+				   allowed, value, sizeof(value));
+
+		if (thread->rule != NULL)
+			snprintf(rule, sizeof(rule), "%zu",
+				 (size_t) (thread->rule - rules) + 1);
+		else
+			snprintf(rule, sizeof(rule), "%s",
+				 (option_policy == POLICY_SPREAD) ? "spread" :
+				 (option_policy == POLICY_PACK) ? "pack" : "all");
+
+		printf("%7d %-16s %-12s %-8s%s%s\n", (int) thread->tid,
+		       thread->comm, value, rule, option_dry_run ? "" : " ",
+		       thread->result);
+	}
+
+	free(order);
+	free(threads);
+	for (idx = 0; idx < nr_rules; idx++) {
+		if (rules[idx].tid == 0)
+			regfree(&rules[idx].regex);
+		bitmap_free(rules[idx].cpus);
+	}
+	free(rules);
+	bitmap_free(allowed);
+
+	return 0;
+}
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-power: Keeps the CPUs of the RT partition out of deep idle states
+ * and away from frequency scaling.
+ *
+ * Everything is done through the cpufreq, cpuidle and PM QoS files of each
+ * CPU in sysfs. Each file changed is printed on stdout together with its
+ * previous value, in the format of the partrt settings file, so that
+ * 'partrt undo' can restore it.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define VALUE_SIZE 256
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+static const char *option_sysfs = SYSFS_CPU_DIR;
+static const char *option_governor = NULL;
+static unsigned long option_frequency = 0;
+static long option_latency = -1;
+static int option_reset = 0;
+
+/* Write value to file, and log the previous value on stdout if it changed */
+static int apply(const char *file, const char *value)
+{
+	char old_value[VALUE_SIZE];
+
+	switch (sysfs_replace(file, value, old_value, sizeof(old_value))) {
+	case -1:
+		info("%s: Could not write '%s': %s", file, value,
+		     strerror(errno));
+		return -1;
+	case 1:
+		if (!option_reset)
+			printf("%s %s\n", file, old_value);
+		debug("echo %s > %s", value, file);
+		break;
+	}
+
+	return 0;
+}
+
+static unsigned long read_ulong(const char *file)
+{
+	char value[VALUE_SIZE];
+	char *check;
+	unsigned long result;
+
+	if (sysfs_read(file, value, sizeof(value)) == -1)
+		fail("%s: Could not read: %s", file, strerror(errno));
+	result = strtoul(value, &check, 10);
+	if ((value[0] == '\0') || (*check != '\0'))
+		fail("%s: '%s': Not a number", file, value);
+
+	return result;
+}
+
+static void set_governor(size_t cpu)
+{
+	char path[PATH_MAX];
+	char governors[VALUE_SIZE];
+	const char *match;
+	const size_t len = strlen(option_governor);
+
+	snprintf(path, sizeof(path), "%s/cpu%zu/cpufreq/scaling_available_governors",
+		 option_sysfs, cpu);
+	if (sysfs_read(path, governors, sizeof(governors)) == 0) {
+		for (match = strstr(governors, option_governor);
+		     match != NULL; match = strstr(match + 1, option_governor))
+			if (((match == governors) || (match[-1] == ' ')) &&
+			    ((match[len] == '\0') || (match[len] == ' ')))
+				break;
+		if (match == NULL)
+			fail("CPU %zu: '%s': Governor not available, expected one of: %s",
+			     cpu, option_governor, governors);
+	}
+
+	snprintf(path, sizeof(path), "%s/cpu%zu/cpufreq/scaling_governor",
+		 option_sysfs, cpu);
+	if (apply(path, option_governor) == -1)
+		fail("CPU %zu: Could not set governor '%s'", cpu,
+		     option_governor);
+	info("CPU %zu: Governor %s", cpu, option_governor);
+}
+
+static void set_frequency(size_t cpu)
+{
+	char min_path[PATH_MAX];
+	char max_path[PATH_MAX];
+	char path[PATH_MAX];
+	char value[32];
+	unsigned long cur_max;
+	int status;
+
+	snprintf(path, sizeof(path), "%s/cpu%zu/cpufreq/cpuinfo_min_freq",
+		 option_sysfs, cpu);
+	if (option_frequency < read_ulong(path))
+		fail("CPU %zu: %lu kHz is below the lowest frequency %lu kHz",
+		     cpu, option_frequency, read_ulong(path));
+	snprintf(path, sizeof(path), "%s/cpu%zu/cpufreq/cpuinfo_max_freq",
+		 option_sysfs, cpu);
+	if (option_frequency > read_ulong(path))
+		fail("CPU %zu: %lu kHz is above the highest frequency %lu kHz",
+		     cpu, option_frequency, read_ulong(path));
+
+	snprintf(min_path, sizeof(min_path), "%s/cpu%zu/cpufreq/scaling_min_freq",
+		 option_sysfs, cpu);
+	snprintf(max_path, sizeof(max_path), "%s/cpu%zu/cpufreq/scaling_max_freq",
+		 option_sysfs, cpu);
+	snprintf(value, sizeof(value), "%lu", option_frequency);
+
+	/* The kernel rejects a minimum above the maximum, so raise the
+	 * maximum first when going up */
+	cur_max = read_ulong(max_path);
+	if (option_frequency > cur_max)
+		status = (apply(max_path, value) == 0) &&
+			(apply(min_path, value) == 0);
+	else
+		status = (apply(min_path, value) == 0) &&
+			(apply(max_path, value) == 0);
+	if (!status)
+		fail("CPU %zu: Could not fix frequency at %lu kHz", cpu,
+		     option_frequency);
+	info("CPU %zu: Frequency %lu kHz", cpu, option_frequency);
+}
+
+/* Disable idle states with a longer exit latency than the budget, and set
+ * the resume latency constraint of the CPU. With --reset, enable all idle
+ * states and remove the constraint. */
+static void set_latency(size_t cpu)
+{
+	char path[PATH_MAX];
+	char name[VALUE_SIZE];
+	char value[32];
+	unsigned long latency;
+	size_t state;
+
+	for (state = 0; ; state++) {
+		struct stat st;
+		int disable;
+
+		snprintf(path, sizeof(path), "%s/cpu%zu/cpuidle/state%zu",
+			 option_sysfs, cpu, state);
+		if (stat(path, &st) == -1)
+			break;
+
+		snprintf(path, sizeof(path), "%s/cpu%zu/cpuidle/state%zu/name",
+			 option_sysfs, cpu, state);
+		if (sysfs_read(path, name, sizeof(name)) == -1)
+			strcpy(name, "?");
+		snprintf(path, sizeof(path), "%s/cpu%zu/cpuidle/state%zu/latency",
+			 option_sysfs, cpu, state);
+		latency = read_ulong(path);
+		disable = !option_reset && (latency > (unsigned long) option_latency);
+
+		snprintf(path, sizeof(path), "%s/cpu%zu/cpuidle/state%zu/disable",
+			 option_sysfs, cpu, state);
+		if (apply(path, disable ? "1" : "0") == -1)
+			info("CPU %zu: Idle state %s could not be %s", cpu, name,
+			     disable ? "disabled" : "enabled");
+		else if (disable)
+			info("CPU %zu: Idle state %s disabled, exit latency %lu us",
+			     cpu, name, latency);
+	}
+
+	/* 0 means no constraint, "n/a" that no latency is tolerated */
+	if (option_reset)
+		strcpy(value, "0");
+	else if (option_latency == 0)
+		strcpy(value, "n/a");
+	else
+		snprintf(value, sizeof(value), "%ld", option_latency);
+
+	snprintf(path, sizeof(path), "%s/cpu%zu/power/pm_qos_resume_latency_us",
+		 option_sysfs, cpu);
+	if (apply(path, value) == -1)
+		info("CPU %zu: Resume latency constraint could not be set", cpu);
+}
+
+static void usage(void)
+{
+	puts("partrt-power - Control power states of the CPUs of a partition\n"
+	     "Usage:\n"
+	     "partrt-power [options] <cpulist>\n"
+	     "\n"
+	     "Changes cpufreq, cpuidle and PM QoS settings of the CPUs in <cpulist>.\n"
+	     "Each file changed is printed with its previous value, in the format of\n"
+	     "the partrt settings file. Normally started by 'partrt create'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-g, --governor=<governor>\n"
+	     "                        Use cpufreq <governor>, e.g. performance.\n"
+	     "-f, --frequency=<kHz>   Fix the frequency at <kHz>.\n"
+	     "-l, --latency=<us>      Disable idle states with an exit latency above\n"
+	     "                        <us> microseconds, and request a resume latency\n"
+	     "                        of at most <us> through PM QoS.\n"
+	     "-r, --reset             Enable all idle states and remove the PM QoS\n"
+	     "                        request. Nothing is printed.\n"
+	     "-s, --sysfs=<dir>       CPU directory of sysfs.\n"
+	     "                        Default: " SYSFS_CPU_DIR "\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-power %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"governor", required_argument, NULL, 'g'},
+		{"frequency", required_argument, NULL, 'f'},
+		{"latency", required_argument, NULL, 'l'},
+		{"reset", no_argument, NULL, 'r'},
+		{"sysfs", required_argument, NULL, 's'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVg:f:l:rs:";
+	static char sysfs_dir[PATH_MAX];
+	struct bitmap_t *cpus;
+	size_t nr_cpus;
+	size_t found = 0;
+	size_t cpu;
+	char *check;
+	int c;
+
+	sysfs_path(sysfs_dir, sizeof(sysfs_dir), SYSFS_CPU_DIR);
+	option_sysfs = sysfs_dir;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'g':
+			option_governor = optarg;
+			break;
+		case 'f':
+			option_frequency = strtoul(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_frequency == 0))
+				fail("'%s': Not a valid frequency", optarg);
+			break;
+		case 'l':
+			option_latency = strtol(optarg, &check, 10);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_latency < 0))
+				fail("'%s': Not a valid latency", optarg);
+			break;
+		case 'r':
+			option_reset = 1;
+			break;
+		case 's':
+			option_sysfs = optarg;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind != 1)
+		fail("Expected <cpulist>");
+	if (option_reset &&
+	    ((option_governor != NULL) || (option_frequency != 0) ||
+	     (option_latency >= 0)))
+		fail("--reset cannot be combined with other settings");
+
+	parse_scope = argv[optind];
+	cpus = bitmap_alloc_from_list(argv[optind]);
+	parse_scope = NULL;
+	nr_cpus = bitmap_bit_count(cpus);
+	if (nr_cpus == 0)
+		fail("'%s': No CPUs given", argv[optind]);
+
+	for (cpu = 0; found < nr_cpus; cpu++) {
+		if (!bitmap_isset(cpu, cpus))
+			continue;
+		found++;
+
+		if (option_governor != NULL)
+			set_governor(cpu);
+		if (option_frequency != 0)
+			set_frequency(cpu);
+		if (option_reset || (option_latency >= 0))
+			set_latency(cpu);
+	}
+
+	bitmap_free(cpus);
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * libpartrt-preload: Prepares memory of an RT task before its main() runs.
+ * Loaded with LD_PRELOAD by partrt-mem, which passes the parameters in
+ * environment variables. Only depends on libc, since it runs inside any
+ * program.
+ */
+
+#define _GNU_SOURCE
+
+#include "memory.h"
+
+#include <alloca.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void report(const char *msg)
+{
+	static const char prefix[] = "libpartrt-preload: ";
+
+	if ((write(STDERR_FILENO, prefix, sizeof(prefix) - 1) < 0) ||
+	    (write(STDERR_FILENO, msg, strlen(msg)) < 0))
+		return;
+}
+
+static size_t env_size(const char *name)
+{
+	const char *const value = getenv(name);
+
+	return (value == NULL) ? 0 : (size_t) strtoull(value, NULL, 10);
+}
+
+/* Touch every page of size bytes below the current stack pointer. With
+ * memory locked the pages stay resident after returning. */
+static void __attribute__((noinline)) prefault_stack(size_t size)
+{
+	volatile char *const stack = alloca(size);
+	const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	size_t idx;
+
+	for (idx = 0; idx < size; idx += page_size)
+		stack[idx] = 0;
+}
+
+/* Fault in size bytes of heap, and keep them in the heap after free() */
+static void prefault_heap(size_t size)
+{
+	const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	volatile char *heap;
+	size_t idx;
+
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	heap = malloc(size);
+	if (heap == NULL) {
+		report("Could not pre-fault heap\n");
+		return;
+	}
+	for (idx = 0; idx < size; idx += page_size)
+		heap[idx] = 0;
+	free((void *) (uintptr_t) heap);
+}
+
+/* Leave the environment as it was before partrt-mem or partrt-run, so
+ * that programs the RT task starts neither lock nor pre-fault memory */
+static void restore_env(void)
+{
+	const char *const old_preload = getenv(MEMORY_ENV_OLD_PRELOAD);
+
+	unsetenv(MEMORY_ENV_MLOCK);
+	unsetenv(MEMORY_ENV_PREFAULT_STACK);
+	unsetenv(MEMORY_ENV_PREFAULT_HEAP);
+
+	if (old_preload == NULL)
+		return;
+	if (*old_preload == '\0')
+		unsetenv("LD_PRELOAD");
+	else
+		setenv("LD_PRELOAD", old_preload, 1);
+	unsetenv(MEMORY_ENV_OLD_PRELOAD);
+}
+
+static void __attribute__((constructor)) partrt_preload(void)
+{
+	const size_t stack_size = env_size(MEMORY_ENV_PREFAULT_STACK);
+	const size_t heap_size = env_size(MEMORY_ENV_PREFAULT_HEAP);
+	const int lock = getenv(MEMORY_ENV_MLOCK) != NULL;
+
+	restore_env();
+
+	if (lock) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+			report("mlockall() failed\n");
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+	}
+
+	if (stack_size > 0)
+		prefault_stack(stack_size);
+	if (heap_size > 0)
+		prefault_heap(heap_size);
+}
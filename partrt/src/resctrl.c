@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-resctrl: Partitions the last level cache and memory bandwidth
+ * between the RT and NRT partitions through the resctrl file system.
+ *
+ * One resctrl group is made per partition and bound to its CPUs. The RT
+ * group gets the upper L3 ways in exclusive mode, the NRT group and the
+ * default group share the lower ways, and memory bandwidth of the NRT group
+ * can be throttled with MBA. Tasks stay in the default group, so the CPU
+ * they run on decides their allocation.
+ *
+ * The previous L3 line of the default group is printed in the format of
+ * the partrt settings file, so that undo can restore it. On removal the
+ * default group is only reset if a group was actually removed, leaving
+ * resctrl setups not made by partrt alone.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define VALUE_SIZE 1024
+#define SCHEMATA_SIZE 4096
+#define RESCTRL_ROOT "/sys/fs/resctrl"
+#define MAX_DOMAINS 64
+
+struct group_t {
+	const char *name;
+	const char *cpus;
+	unsigned long ways;
+	unsigned long bandwidth;
+	unsigned long cbm;
+};
+
+static const char *option_root = RESCTRL_ROOT;
+static unsigned long option_rt_ways = 0;
+static unsigned long option_nrt_ways = 0;
+static unsigned long option_rt_bandwidth = 100;
+static unsigned long option_nrt_bandwidth = 100;
+static int option_remove = 0;
+
+/* Cache domain IDs of the L3 and MB resources */
+static unsigned long l3_domains[MAX_DOMAINS];
+static size_t nr_l3_domains = 0;
+static unsigned long mb_domains[MAX_DOMAINS];
+static size_t nr_mb_domains = 0;
+
+/* Schemata of the default group before any change */
+static char default_schemata[SCHEMATA_SIZE];
+
+static unsigned long cbm_mask;
+static unsigned long nr_ways;
+static unsigned long min_bandwidth = 0;
+
+static int has_file(const char *file)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", option_root, file);
+
+	return access(path, F_OK) == 0;
+}
+
+static unsigned long read_number(const char *file, int base)
+{
+	char path[PATH_MAX];
+	char value[VALUE_SIZE];
+	unsigned long result;
+	char *check;
+
+	snprintf(path, sizeof(path), "%s/%s", option_root, file);
+	if (sysfs_read(path, value, sizeof(value)) == -1)
+		fail("%s: Could not read: %s", path, strerror(errno));
+	result = strtoul(value, &check, base);
+	if ((value[0] == '\0') || (*check != '\0'))
+		fail("%s: '%s': Not a number", path, value);
+
+	return result;
+}
+
+/* Read the domain IDs of resource from a line "<resource>:<id>=<value>;..."
+ * of the default group's schemata */
+static size_t read_domains(const char *schemata, const char *resource,
+			   unsigned long *domains)
+{
+	const size_t len = strlen(resource);
+	const char *line = schemata;
+	size_t nr = 0;
+
+	while (line != NULL) {
+		const char *field;
+
+		line += strspn(line, " \t\n");
+		if ((strncmp(line, resource, len) == 0) && (line[len] == ':')) {
+			for (field = &line[len + 1]; (*field != '\0') &&
+				     (*field != '\n') && (nr < MAX_DOMAINS); ) {
+				char *end;
+
+				domains[nr++] = strtoul(field, &end, 10);
+				if (*end != '=')
+					fail("%s/schemata: Unexpected %s line",
+					     option_root, resource);
+				field = end + strcspn(end, ";\n");
+				if (*field == ';')
+					field++;
+			}
+			return nr;
+		}
+		line = strchr(line, '\n');
+	}
+
+	return 0;
+}
+
+static size_t popcount(unsigned long value)
+{
+	size_t count = 0;
+
+	for (; value != 0; value &= value - 1)
+		count++;
+
+	return count;
+}
+
+/* Copy the line of resource in schemata, without leading blanks, to buf.
+ * buf is empty if there is no such line. */
+static void find_line(const char *schemata, const char *resource, char *buf,
+		      size_t size)
+{
+	const size_t len = strlen(resource);
+	const char *line = schemata;
+
+	buf[0] = '\0';
+	while (line != NULL) {
+		line += strspn(line, " \t\n");
+		if ((strncmp(line, resource, len) == 0) && (line[len] == ':')) {
+			snprintf(buf, size, "%.*s", (int) strcspn(line, "\n"),
+				 line);
+			return;
+		}
+		line = strchr(line, '\n');
+	}
+}
+
+/* Format the schemata line of resource with the same value in all domains */
+static size_t format_line(char *buf, size_t size, const char *resource,
+			  const unsigned long *domains, size_t nr_domains,
+			  const char *format, unsigned long value)
+{
+	size_t len = (size_t) snprintf(buf, size, "%s:", resource);
+	size_t idx;
+
+	for (idx = 0; (idx < nr_domains) && (len < size); idx++) {
+		len += (size_t) snprintf(&buf[len], size - len, "%s%lu=",
+					 (idx > 0) ? ";" : "", domains[idx]);
+		if (len < size)
+			len += (size_t) snprintf(&buf[len], size - len, format,
+						 value);
+	}
+	if (len < size)
+		len += (size_t) snprintf(&buf[len], size - len, "\n");
+	if (len >= size)
+		fail("Too many cache domains");
+
+	return len;
+}
+
+static void write_file(const char *group, const char *file, const char *value)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s%s%s", option_root, group,
+		 (group[0] != '\0') ? "/" : "", file);
+	if (sysfs_write(path, value) == -1)
+		fail("%s: Could not write '%s': %s", path, value,
+		     strerror(errno));
+	debug("echo '%s' > %s", value, path);
+}
+
+static void read_info(void)
+{
+	char *const schemata = default_schemata;
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/schemata", option_root);
+	if (sysfs_read(path, schemata, sizeof(default_schemata)) == -1)
+		fail("%s: resctrl is not mounted: %s", option_root,
+		     strerror(errno));
+
+	if (has_file("info/L3/cbm_mask")) {
+		nr_l3_domains = read_domains(schemata, "L3", l3_domains);
+		if (nr_l3_domains == 0)
+			info("No L3 line in %s, code and data prioritization enabled? L3 not partitioned",
+			     path);
+		cbm_mask = read_number("info/L3/cbm_mask", 16);
+		nr_ways = popcount(cbm_mask);
+	}
+	if (has_file("info/MB/min_bandwidth")) {
+		nr_mb_domains = read_domains(schemata, "MB", mb_domains);
+		min_bandwidth = read_number("info/MB/min_bandwidth", 10);
+	}
+
+	if ((nr_l3_domains == 0) && (nr_mb_domains == 0))
+		fail("%s: Neither L3 cache allocation nor memory bandwidth allocation supported",
+		     option_root);
+}
+
+static void setup_group(const struct group_t *group)
+{
+	char path[PATH_MAX];
+	char schemata[SCHEMATA_SIZE];
+	size_t len = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", option_root, group->name);
+	if ((mkdir(path, 0755) == -1) && (errno != EEXIST))
+		fail("%s: Could not create resctrl group: %s", path,
+		     strerror(errno));
+
+	if (nr_l3_domains > 0)
+		len += format_line(&schemata[len], sizeof(schemata) - len, "L3",
+				   l3_domains, nr_l3_domains, "%lx", group->cbm);
+	if (nr_mb_domains > 0)
+		len += format_line(&schemata[len], sizeof(schemata) - len, "MB",
+				   mb_domains, nr_mb_domains, "%lu",
+				   group->bandwidth);
+	write_file(group->name, "schemata", schemata);
+	write_file(group->name, "cpus_list", group->cpus);
+
+	info("%s: CPUs %s, L3 ways %lx, memory bandwidth %lu%%", group->name,
+	     group->cpus, group->cbm, group->bandwidth);
+}
+
+static void setup(struct group_t *rt, struct group_t *nrt)
+{
+	char schemata[SCHEMATA_SIZE];
+
+	if (nr_l3_domains > 0) {
+		const unsigned long min_ways = has_file("info/L3/min_cbm_bits") ?
+			read_number("info/L3/min_cbm_bits", 10) : 1;
+		const unsigned long low = cbm_mask & ~(cbm_mask << 1);
+
+		if (rt->ways == 0)
+			rt->ways = nr_ways / 2;
+		if (nrt->ways == 0)
+			nrt->ways = nr_ways - rt->ways;
+		if ((rt->ways < min_ways) || (nrt->ways < min_ways) ||
+		    (rt->ways + nrt->ways > nr_ways))
+			fail("L3 ways %lu and %lu: Each needs at least %lu, and both at most %lu",
+			     rt->ways, nrt->ways, min_ways, nr_ways);
+
+		/* RT at the top of the mask, NRT at the bottom */
+		rt->cbm = cbm_mask & ~((low << (nr_ways - rt->ways)) - 1);
+		nrt->cbm = (low << nrt->ways) - low;
+	}
+
+	if (nr_mb_domains > 0)
+		if ((rt->bandwidth < min_bandwidth) ||
+		    (nrt->bandwidth < min_bandwidth))
+			fail("Memory bandwidth %lu%% and %lu%%: Needs at least %lu%%",
+			     rt->bandwidth, nrt->bandwidth, min_bandwidth);
+
+	/* The default group serves everything not bound to a group, keep it
+	 * off the ways of the RT group. Its previous L3 line is logged for
+	 * undo. */
+	if (nr_l3_domains > 0) {
+		char old_line[SCHEMATA_SIZE];
+
+		find_line(default_schemata, "L3", old_line, sizeof(old_line));
+		format_line(schemata, sizeof(schemata), "L3", l3_domains,
+			    nr_l3_domains, "%lx", nrt->cbm);
+		write_file("", "schemata", schemata);
+		if ((strlen(old_line) != strcspn(schemata, "\n")) ||
+		    (strncmp(schemata, old_line, strlen(old_line)) != 0))
+			printf("%s/schemata %s\n", option_root, old_line);
+	}
+
+	setup_group(nrt);
+	setup_group(rt);
+
+	/* Kernels before mode support share all ways */
+	snprintf(schemata, sizeof(schemata), "%s/mode", rt->name);
+	if ((nr_l3_domains > 0) && has_file(schemata)) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/%s/mode", option_root,
+			 rt->name);
+		if (sysfs_write(path, "exclusive") == -1)
+			fprintf(stderr, "WARNING: %s: L3 ways %lx could not be made exclusive: %s\n",
+				rt->name, rt->cbm, strerror(errno));
+	}
+}
+
+static void remove_groups(char *names[], int nr_names)
+{
+	char path[PATH_MAX];
+	char schemata[SCHEMATA_SIZE];
+	size_t len = 0;
+	int nr_removed = 0;
+	int idx;
+
+	/* Tasks and CPUs of a removed group return to the default group */
+	for (idx = 0; idx < nr_names; idx++) {
+		snprintf(path, sizeof(path), "%s/%s", option_root, names[idx]);
+		if (rmdir(path) == 0)
+			nr_removed++;
+		else if (errno != ENOENT)
+			fail("%s: Could not remove resctrl group: %s", path,
+			     strerror(errno));
+	}
+
+	/* Not set up by partrt, leave the default group as it is */
+	if (nr_removed == 0) {
+		info("No resctrl group removed, default group left alone");
+		return;
+	}
+
+	if (nr_l3_domains > 0)
+		len += format_line(&schemata[len], sizeof(schemata) - len, "L3",
+				   l3_domains, nr_l3_domains, "%lx", cbm_mask);
+	if (nr_mb_domains > 0)
+		len += format_line(&schemata[len], sizeof(schemata) - len, "MB",
+				   mb_domains, nr_mb_domains, "%lu", 100);
+	write_file("", "schemata", schemata);
+}
+
+static unsigned long parse_number(const char *arg, const char *what)
+{
+	unsigned long result;
+	char *check;
+
+	result = strtoul(arg, &check, 10);
+	if ((*arg == '\0') || (*check != '\0') || (result == 0))
+		fail("'%s': Not a valid %s", arg, what);
+
+	return result;
+}
+
+static void usage(void)
+{
+	puts("partrt-resctrl - Partition cache and memory bandwidth with resctrl\n"
+	     "Usage:\n"
+	     "partrt-resctrl [options] <rt group> <rt cpulist> <nrt group> <nrt cpulist>\n"
+	     "partrt-resctrl [options] --remove <group>...\n"
+	     "\n"
+	     "Creates one resctrl group per partition, bound to the CPUs of the\n"
+	     "partition. The RT group gets exclusive L3 ways, the NRT group and the\n"
+	     "default group share the rest. The previous L3 line of the default group\n"
+	     "is printed in the format of the partrt settings file. With --remove, the\n"
+	     "groups are removed and, if any existed, the default group gets all of\n"
+	     "the cache and bandwidth again. Normally started by 'partrt create' and\n"
+	     "'partrt undo'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-l, --rt-ways=<n>       L3 ways of the RT group. Default: half.\n"
+	     "-L, --nrt-ways=<n>      L3 ways of the NRT group. Default: the rest.\n"
+	     "-b, --rt-bandwidth=<percent>\n"
+	     "                        Memory bandwidth of the RT group. Default: 100.\n"
+	     "-B, --nrt-bandwidth=<percent>\n"
+	     "                        Memory bandwidth of the NRT group. Default: 100.\n"
+	     "-r, --remove            Remove the groups.\n"
+	     "-R, --root=<dir>        Mount point of resctrl.\n"
+	     "                        Default: " RESCTRL_ROOT "\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-resctrl %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"rt-ways", required_argument, NULL, 'l'},
+		{"nrt-ways", required_argument, NULL, 'L'},
+		{"rt-bandwidth", required_argument, NULL, 'b'},
+		{"nrt-bandwidth", required_argument, NULL, 'B'},
+		{"remove", no_argument, NULL, 'r'},
+		{"root", required_argument, NULL, 'R'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVl:L:b:B:rR:";
+	static char root[PATH_MAX];
+	struct group_t rt;
+	struct group_t nrt;
+	int c;
+
+	sysfs_path(root, sizeof(root), RESCTRL_ROOT);
+	option_root = root;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'l':
+			option_rt_ways = parse_number(optarg, "number of ways");
+			break;
+		case 'L':
+			option_nrt_ways = parse_number(optarg, "number of ways");
+			break;
+		case 'b':
+			option_rt_bandwidth = parse_number(optarg, "percentage");
+			break;
+		case 'B':
+			option_nrt_bandwidth = parse_number(optarg, "percentage");
+			break;
+		case 'r':
+			option_remove = 1;
+			break;
+		case 'R':
+			option_root = optarg;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if ((option_rt_bandwidth > 100) || (option_nrt_bandwidth > 100))
+		fail("Memory bandwidth is at most 100%%");
+
+	if (option_remove) {
+		if (argc == optind)
+			fail("Expected <group>...");
+		read_info();
+		remove_groups(&argv[optind], argc - optind);
+		return 0;
+	}
+
+	if (argc - optind != 4)
+		fail("Expected <rt group> <rt cpulist> <nrt group> <nrt cpulist>");
+
+	rt.name = argv[optind];
+	rt.cpus = argv[optind + 1];
+	rt.ways = option_rt_ways;
+	rt.bandwidth = option_rt_bandwidth;
+	nrt.name = argv[optind + 2];
+	nrt.cpus = argv[optind + 3];
+	nrt.ways = option_nrt_ways;
+	nrt.bandwidth = option_nrt_bandwidth;
+
+	read_info();
+	setup(&rt, &nrt);
+
+	return 0;
+}
@@ -0,0 +1,909 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * partrt-status: Collects the state of all cpuset partitions in one pass
+ * over /proc and /sys. Every task is read with one openat() and one
+ * sched_getaffinity() call, without forking any helper, so that the
+ * snapshot is fast even with tens of thousands of threads.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VALUE_SIZE 4096
+#define STAT_SIZE 1024
+#define COMM_SIZE 64
+#define PF_KTHREAD 0x00200000
+
+/* Knobs that "partrt create" changes, or that tell how the kernel was
+ * booted */
+static const char *const knob_files[] = {
+	"/sys/devices/system/cpu/isolated",
+	"/sys/devices/system/cpu/nohz_full",
+	"/proc/irq/default_smp_affinity",
+	"/proc/sys/kernel/sched_rt_runtime_us",
+	"/sys/kernel/debug/sched_tick_max_deferment",
+	"/proc/sys/vm/stat_interval",
+	"/proc/sys/kernel/watchdog",
+	"/sys/bus/workqueue/devices/writeback/numa",
+	"/sys/bus/workqueue/devices/writeback/cpumask",
+	"/sys/devices/virtual/workqueue/cpumask",
+	"/sys/devices/system/machinecheck/machinecheck0/check_interval",
+	NULL
+};
+
+struct task_t {
+	pid_t tid;
+	pid_t tgid;
+	char comm[COMM_SIZE];
+	char state;
+	int kthread;
+	int cpu;
+	unsigned long rt_priority;
+	unsigned long policy;
+	/* Points into task_affinity_pool */
+	cpu_set_t *affinity;
+};
+
+struct partition_t {
+	char *name;
+	char cpus[VALUE_SIZE];
+	char mems[VALUE_SIZE];
+	int cpu_exclusive;
+	int load_balance;
+	struct bitmap_t *cpu_set;
+	struct task_t *tasks;
+	size_t nr_tasks;
+};
+
+struct irq_t {
+	int irq;
+	char name[COMM_SIZE];
+	char affinity[VALUE_SIZE];
+	struct bitmap_t *cpu_set;
+};
+
+static const char *option_cpuset_root = NULL;
+static const char *option_cpuset_prefix = "";
+static int option_json = 0;
+static int option_list_tasks = 0;
+
+static size_t nr_cpus;
+static size_t affinity_size;
+static char *task_affinity_pool = NULL;
+
+static struct partition_t *partitions = NULL;
+static size_t nr_partitions = 0;
+
+static struct irq_t *irqs = NULL;
+static size_t nr_irqs = 0;
+
+/* Number of possible CPUs, which is what the kernel cpumasks cover */
+static size_t get_nr_cpus(void)
+{
+	char path[PATH_MAX];
+	char possible[VALUE_SIZE];
+	const char *last;
+
+	sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/possible");
+	if (sysfs_read(path, possible, sizeof(possible)) == -1)
+		return (size_t) sysconf(_SC_NPROCESSORS_CONF);
+
+	last = strrchr(possible, '-');
+	if (last == NULL)
+		last = strrchr(possible, ',');
+	last = (last == NULL) ? possible : last + 1;
+
+	return strtoul(last, NULL, 10) + 1;
+}
+
+static const char *policy_name(unsigned long policy)
+{
+	switch (policy) {
+	case SCHED_OTHER:
+		return "other";
+	case SCHED_FIFO:
+		return "fifo";
+	case SCHED_RR:
+		return "rr";
+	case SCHED_BATCH:
+		return "batch";
+	case SCHED_IDLE:
+		return "idle";
+	case 6:
+		return "deadline";
+	default:
+		return "unknown";
+	}
+}
+
+static int is_rt_policy(unsigned long policy)
+{
+	return (policy == SCHED_FIFO) || (policy == SCHED_RR) || (policy == 6);
+}
+
+/* Format a cpu_set_t as a CPU list, e.g. "0-3,6" */
+static void cpu_set_list(const cpu_set_t *set, char *buf, size_t size)
+{
+	size_t len = 0;
+	size_t cpu = 0;
+
+	buf[0] = '\0';
+	while (cpu < nr_cpus) {
+		size_t last;
+
+		if (!CPU_ISSET_S(cpu, affinity_size, set)) {
+			cpu++;
+			continue;
+		}
+
+		for (last = cpu; (last + 1 < nr_cpus) &&
+			     CPU_ISSET_S(last + 1, affinity_size, set); last++)
+			;
+
+		if (last == cpu)
+			len += (size_t) snprintf(&buf[len], size - len, "%s%zu",
+						 (len > 0) ? "," : "", cpu);
+		else
+			len += (size_t) snprintf(&buf[len], size - len,
+						 "%s%zu-%zu",
+						 (len > 0) ? "," : "", cpu, last);
+		if (len >= size) {
+			buf[size - 1] = '\0';
+			return;
+		}
+		cpu = last + 1;
+	}
+}
+
+/* Skip n space separated fields */
+static const char *skip_fields(const char *str, int n)
+{
+	while ((n-- > 0) && (str != NULL)) {
+		str = strchr(str, ' ');
+		if (str != NULL)
+			str++;
+	}
+
+	return str;
+}
+
+/* Read <tid>/stat relative to /proc/<pid>/task. Returns -1 if the task is
+ * gone. */
+static int read_task(int task_fd, struct task_t *task)
+{
+	char path[32];
+	char stat[STAT_SIZE];
+	const char *comm_start;
+	const char *comm_end;
+	const char *field;
+	size_t comm_len;
+
+	snprintf(path, sizeof(path), "%d/stat", (int) task->tid);
+	if (sysfs_read_at(task_fd, path, stat, sizeof(stat)) == -1)
+		return -1;
+
+	/* comm can contain both spaces and parentheses */
+	comm_start = strchr(stat, '(');
+	comm_end = strrchr(stat, ')');
+	if ((comm_start == NULL) || (comm_end == NULL) || (comm_end[1] == '\0'))
+		return -1;
+
+	comm_len = (size_t) (comm_end - comm_start - 1);
+	if (comm_len >= sizeof(task->comm))
+		comm_len = sizeof(task->comm) - 1;
+	memcpy(task->comm, comm_start + 1, comm_len);
+	task->comm[comm_len] = '\0';
+
+	/* Field 3, state, follows ") " */
+	field = comm_end + 2;
+	task->state = *field;
+
+	/* Field 9, flags */
+	field = skip_fields(field, 6);
+	if (field == NULL)
+		return -1;
+	task->kthread = (strtoul(field, NULL, 10) & PF_KTHREAD) != 0;
+
+	/* Field 39, processor, 40, rt_priority, and 41, policy */
+	field = skip_fields(field, 30);
+	if (field == NULL)
+		return -1;
+	task->cpu = atoi(field);
+	field = skip_fields(field, 1);
+	if (field == NULL)
+		return -1;
+	task->rt_priority = strtoul(field, NULL, 10);
+	field = skip_fields(field, 1);
+	if (field == NULL)
+		return -1;
+	task->policy = strtoul(field, NULL, 10);
+
+	if (sysfs_getaffinity(task->tid, affinity_size, task->affinity) == -1)
+		return -1;
+
+	return 0;
+}
+
+static void read_partition_file(const char *dir, const char *name, char *buf)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s%s", dir, option_cpuset_prefix,
+		 name);
+	if (sysfs_read(path, buf, VALUE_SIZE) == -1)
+		buf[0] = '\0';
+}
+
+static void add_partition(const char *dir, const char *name)
+{
+	struct partition_t *partition;
+	char value[VALUE_SIZE];
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%scpus", dir, option_cpuset_prefix);
+	if (access(path, F_OK) == -1)
+		return;
+
+	partitions = checked_realloc(partitions,
+				     (nr_partitions + 1) * sizeof(*partitions));
+	partition = &partitions[nr_partitions++];
+	memset(partition, 0, sizeof(*partition));
+
+	partition->name = strdup(name);
+	if (partition->name == NULL)
+		fail("Out of memory, aborting");
+
+	read_partition_file(dir, "cpus", partition->cpus);
+	read_partition_file(dir, "mems", partition->mems);
+	read_partition_file(dir, "cpu_exclusive", value);
+	partition->cpu_exclusive = atoi(value);
+	read_partition_file(dir, "sched_load_balance", value);
+	partition->load_balance = atoi(value);
+	partition->cpu_set = bitmap_alloc_from_list(partition->cpus);
+}
+
+static void read_partitions(void)
+{
+	struct dirent *entry;
+	char path[PATH_MAX];
+	DIR *dir;
+
+	add_partition(option_cpuset_root, "/");
+	if (nr_partitions == 0)
+		fail("%s: Not a cpuset root", option_cpuset_root);
+
+	dir = opendir(option_cpuset_root);
+	if (dir == NULL)
+		fail("%s: Could not open: %s", option_cpuset_root,
+		     strerror(errno));
+
+	while ((entry = readdir(dir)) != NULL) {
+		if ((entry->d_name[0] == '.') ||
+		    ((entry->d_type != DT_DIR) && (entry->d_type != DT_UNKNOWN)))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", option_cpuset_root,
+			 entry->d_name);
+		add_partition(path, entry->d_name);
+	}
+
+	closedir(dir);
+}
+
+/* Which partition a task belongs to, from the cpuset tasks files */
+struct member_t {
+	pid_t tid;
+	size_t partition;
+};
+
+static int member_compare(const void *first, const void *second)
+{
+	const struct member_t *const a = first;
+	const struct member_t *const b = second;
+
+	return (a->tid > b->tid) - (a->tid < b->tid);
+}
+
+/* Read members of all partitions into a table sorted on TID */
+static struct member_t *read_members(size_t *nr_members)
+{
+	struct member_t *members = NULL;
+	size_t size = 0;
+	char path[PATH_MAX];
+	size_t idx;
+
+	*nr_members = 0;
+	for (idx = 0; idx < nr_partitions; idx++) {
+		char *buf;
+		char *line;
+		char *end;
+
+		if (idx == 0)
+			snprintf(path, sizeof(path), "%s/tasks",
+				 option_cpuset_root);
+		else
+			snprintf(path, sizeof(path), "%s/%s/tasks",
+				 option_cpuset_root, partitions[idx].name);
+		buf = sysfs_read_all(path);
+		if (buf == NULL)
+			fail("%s: Could not read: %s", path, strerror(errno));
+
+		for (line = buf; *line != '\0'; line = end) {
+			const pid_t tid = (pid_t) strtol(line, &end, 10);
+
+			if (end == line)
+				break;
+			while (*end == '\n')
+				end++;
+
+			if (*nr_members == size) {
+				size = (size == 0) ? 1024 : size * 2;
+				members = checked_realloc(members,
+							  size * sizeof(*members));
+			}
+			members[*nr_members].tid = tid;
+			members[*nr_members].partition = idx;
+			(*nr_members)++;
+			partitions[idx].nr_tasks++;
+		}
+		free(buf);
+	}
+
+	qsort(members, *nr_members, sizeof(*members), member_compare);
+
+	return members;
+}
+
+static int task_compare(const void *first, const void *second)
+{
+	const struct task_t *const a = first;
+	const struct task_t *const b = second;
+
+	if (a->cpu != b->cpu)
+		return (a->cpu > b->cpu) - (a->cpu < b->cpu);
+
+	return (a->tid > b->tid) - (a->tid < b->tid);
+}
+
+/* Walk /proc/<pid>/task/<tid> for all tasks. /proc/<tid>/stat would work
+ * for threads too, but it sums statistics over the whole thread group,
+ * which makes a snapshot quadratic in the number of threads. */
+static void read_tasks(void)
+{
+	size_t nr_members;
+	struct member_t *const members = read_members(&nr_members);
+	char proc[PATH_MAX];
+	struct dirent *proc_entry;
+	size_t pool_idx = 0;
+	DIR *proc_dir;
+	size_t idx;
+	int proc_fd;
+
+	sysfs_path(proc, sizeof(proc), "/proc");
+	proc_fd = open(proc, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd == -1)
+		fail("%s: Could not open: %s", proc, strerror(errno));
+
+	for (idx = 0; idx < nr_partitions; idx++) {
+		partitions[idx].tasks = checked_malloc(
+			(partitions[idx].nr_tasks + 1) * sizeof(struct task_t));
+		partitions[idx].nr_tasks = 0;
+	}
+	task_affinity_pool = checked_malloc(nr_members * affinity_size + 1);
+
+	proc_dir = opendir(proc);
+	if (proc_dir == NULL)
+		fail("%s: Could not open: %s", proc, strerror(errno));
+
+	while ((proc_entry = readdir(proc_dir)) != NULL) {
+		char path[PATH_MAX];
+		struct dirent *task_entry;
+		DIR *task_dir;
+		int task_fd;
+
+		if (!isdigit((unsigned char) proc_entry->d_name[0]))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/task", proc_entry->d_name);
+		task_fd = openat(proc_fd, path,
+				 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (task_fd == -1)
+			continue;
+		task_dir = fdopendir(task_fd);
+		if (task_dir == NULL) {
+			close(task_fd);
+			continue;
+		}
+
+		while ((task_entry = readdir(task_dir)) != NULL) {
+			struct member_t key;
+			const struct member_t *member;
+			struct partition_t *partition;
+			struct task_t *task;
+
+			if (!isdigit((unsigned char) task_entry->d_name[0]))
+				continue;
+
+			/* Tasks created after the tasks files were read are
+			 * not part of the snapshot */
+			key.tid = (pid_t) atoi(task_entry->d_name);
+			member = bsearch(&key, members, nr_members,
+					 sizeof(*members), member_compare);
+			if ((member == NULL) || (pool_idx >= nr_members))
+				continue;
+
+			partition = &partitions[member->partition];
+			task = &partition->tasks[partition->nr_tasks];
+			task->tid = key.tid;
+			task->tgid = (pid_t) atoi(proc_entry->d_name);
+			task->affinity = (cpu_set_t *) (void *)
+				&task_affinity_pool[pool_idx * affinity_size];
+			pool_idx++;
+
+			if (read_task(task_fd, task) == 0)
+				partition->nr_tasks++;
+		}
+
+		closedir(task_dir);
+	}
+
+	closedir(proc_dir);
+	close(proc_fd);
+	free(members);
+
+	/* Sorted on CPU, the per-CPU views are found by a binary search */
+	for (idx = 0; idx < nr_partitions; idx++)
+		qsort(partitions[idx].tasks, partitions[idx].nr_tasks,
+		      sizeof(struct task_t), task_compare);
+}
+
+/* Index of the first task that last ran on cpu */
+static size_t first_task_on_cpu(const struct partition_t *partition,
+				size_t cpu)
+{
+	size_t low = 0;
+	size_t high = partition->nr_tasks;
+
+	while (low < high) {
+		const size_t mid = low + (high - low) / 2;
+
+		if ((size_t) partition->tasks[mid].cpu < cpu)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static void read_irqs(void)
+{
+	struct dirent *entry;
+	char path[PATH_MAX];
+	DIR *dir;
+
+	sysfs_path(path, sizeof(path), "/proc/irq");
+	dir = opendir(path);
+	if (dir == NULL)
+		fail("%s: Could not open: %s", path, strerror(errno));
+
+	while ((entry = readdir(dir)) != NULL) {
+		struct irq_t *irq;
+		struct dirent *action;
+		DIR *irq_dir;
+
+		if (!isdigit((unsigned char) entry->d_name[0]))
+			continue;
+
+		irqs = checked_realloc(irqs, (nr_irqs + 1) * sizeof(*irqs));
+		irq = &irqs[nr_irqs];
+		irq->irq = atoi(entry->d_name);
+		irq->name[0] = '\0';
+
+		/* Effective affinity is what the IRQ actually uses, but is
+		 * not present on older kernels */
+		sysfs_path(path, sizeof(path),
+			   "/proc/irq/%s/effective_affinity_list", entry->d_name);
+		if ((sysfs_read(path, irq->affinity, sizeof(irq->affinity)) == -1) ||
+		    (irq->affinity[0] == '\0')) {
+			sysfs_path(path, sizeof(path),
+				   "/proc/irq/%s/smp_affinity_list",
+				   entry->d_name);
+			if (sysfs_read(path, irq->affinity,
+				       sizeof(irq->affinity)) == -1)
+				continue;
+		}
+		irq->cpu_set = bitmap_alloc_from_list(irq->affinity);
+
+		/* Registered handlers show up as directories */
+		sysfs_path(path, sizeof(path), "/proc/irq/%s", entry->d_name);
+		irq_dir = opendir(path);
+		while ((irq_dir != NULL) && ((action = readdir(irq_dir)) != NULL)) {
+			if ((action->d_type == DT_DIR) && (action->d_name[0] != '.')) {
+				size_t len = strlen(action->d_name);
+
+				if (len >= sizeof(irq->name))
+					len = sizeof(irq->name) - 1;
+				memcpy(irq->name, action->d_name, len);
+				irq->name[len] = '\0';
+				break;
+			}
+		}
+		if (irq_dir != NULL)
+			closedir(irq_dir);
+
+		nr_irqs++;
+	}
+
+	closedir(dir);
+}
+
+/*
+ * Text output
+ */
+
+static void print_text(void)
+{
+	char path[PATH_MAX];
+	char value[VALUE_SIZE];
+	size_t part_idx;
+	size_t idx;
+
+	for (part_idx = 0; part_idx < nr_partitions; part_idx++) {
+		const struct partition_t *const partition =
+			&partitions[part_idx];
+		size_t nr_kthreads = 0;
+		size_t nr_rt = 0;
+		size_t cpu;
+
+		for (idx = 0; idx < partition->nr_tasks; idx++) {
+			nr_kthreads += (size_t) partition->tasks[idx].kthread;
+			nr_rt += (size_t) is_rt_policy(partition->tasks[idx].policy);
+		}
+
+		printf("Partition %s%s: CPUs %s, mems %s%s%s\n",
+		       partition->name, (part_idx == 0) ? " (cpuset root)" : "",
+		       partition->cpus, partition->mems,
+		       partition->cpu_exclusive ? ", exclusive" : "",
+		       partition->load_balance ? "" : ", no load balance");
+		printf("  %zu tasks, %zu kernel threads, %zu real-time\n",
+		       partition->nr_tasks, nr_kthreads, nr_rt);
+		printf("  %5s %7s %8s %6s\n", "CPU", "Tasks", "RT tasks", "IRQs");
+
+		for (cpu = 0; cpu < nr_cpus; cpu++) {
+			size_t nr_cpu_tasks = 0;
+			size_t nr_cpu_rt = 0;
+			size_t nr_cpu_irqs = 0;
+
+			if (!bitmap_isset(cpu, partition->cpu_set))
+				continue;
+
+			for (idx = first_task_on_cpu(partition, cpu);
+			     (idx < partition->nr_tasks) &&
+				     ((size_t) partition->tasks[idx].cpu == cpu);
+			     idx++) {
+				nr_cpu_tasks++;
+				nr_cpu_rt += (size_t) is_rt_policy(
+					partition->tasks[idx].policy);
+			}
+			for (idx = 0; idx < nr_irqs; idx++)
+				nr_cpu_irqs += (size_t) bitmap_isset(
+					cpu, irqs[idx].cpu_set);
+
+			printf("  %5zu %7zu %8zu %6zu\n", cpu, nr_cpu_tasks,
+			       nr_cpu_rt, nr_cpu_irqs);
+		}
+
+		if (option_list_tasks && (partition->nr_tasks > 0)) {
+			printf("  %7s %4s %-8s %4s %-16s %s\n", "TID", "CPU",
+			       "Policy", "Prio", "Affinity", "Command");
+			for (idx = 0; idx < partition->nr_tasks; idx++) {
+				const struct task_t *const task =
+					&partition->tasks[idx];
+
+				cpu_set_list(task->affinity, value,
+					     sizeof(value));
+				printf("  %7d %4d %-8s %4lu %-16s %s%s%s\n",
+				       (int) task->tid, task->cpu,
+				       policy_name(task->policy),
+				       task->rt_priority, value,
+				       task->kthread ? "[" : "", task->comm,
+				       task->kthread ? "]" : "");
+			}
+		}
+		putchar('\n');
+	}
+
+	printf("Knobs:\n");
+	for (idx = 0; knob_files[idx] != NULL; idx++) {
+		sysfs_path(path, sizeof(path), "%s", knob_files[idx]);
+		if (sysfs_read(path, value, sizeof(value)) == -1)
+			snprintf(value, sizeof(value), "-");
+		printf("  %-62s %s\n", knob_files[idx], value);
+	}
+}
+
+/*
+ * JSON output
+ */
+
+static void json_string(const char *str)
+{
+	putchar('"');
+	for (; *str != '\0'; str++) {
+		const unsigned char c = (unsigned char) *str;
+
+		if ((c == '"') || (c == '\\'))
+			printf("\\%c", c);
+		else if (c < 0x20)
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+static void print_json_partition(const struct partition_t *partition)
+{
+	char affinity[VALUE_SIZE];
+	size_t cpu;
+	size_t idx;
+	const char *separator = "";
+
+	printf("    {\n      \"name\": ");
+	json_string(partition->name);
+	printf(",\n      \"cpus\": ");
+	json_string(partition->cpus);
+	printf(",\n      \"mems\": ");
+	json_string(partition->mems);
+	printf(",\n      \"cpu_exclusive\": %s,\n      \"sched_load_balance\": %s,\n",
+	       partition->cpu_exclusive ? "true" : "false",
+	       partition->load_balance ? "true" : "false");
+
+	printf("      \"per_cpu\": [");
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		const char *list_separator = "";
+
+		if (!bitmap_isset(cpu, partition->cpu_set))
+			continue;
+
+		printf("%s\n        { \"cpu\": %zu, \"tasks\": [", separator,
+		       cpu);
+		for (idx = first_task_on_cpu(partition, cpu);
+		     (idx < partition->nr_tasks) &&
+			     ((size_t) partition->tasks[idx].cpu == cpu);
+		     idx++) {
+			printf("%s%d", list_separator,
+			       (int) partition->tasks[idx].tid);
+			list_separator = ", ";
+		}
+
+		printf("], \"irqs\": [");
+		list_separator = "";
+		for (idx = 0; idx < nr_irqs; idx++) {
+			if (!bitmap_isset(cpu, irqs[idx].cpu_set))
+				continue;
+			printf("%s%d", list_separator, irqs[idx].irq);
+			list_separator = ", ";
+		}
+		printf("] }");
+		separator = ",";
+	}
+	printf("\n      ],\n");
+
+	printf("      \"tasks\": [");
+	separator = "";
+	for (idx = 0; idx < partition->nr_tasks; idx++) {
+		const struct task_t *const task = &partition->tasks[idx];
+
+		cpu_set_list(task->affinity, affinity, sizeof(affinity));
+		printf("%s\n        { \"tid\": %d, \"pid\": %d, \"comm\": ",
+		       separator, (int) task->tid, (int) task->tgid);
+		json_string(task->comm);
+		printf(", \"state\": \"%c\", \"kthread\": %s, \"cpu\": %d, "
+		       "\"policy\": \"%s\", \"rt_priority\": %lu, "
+		       "\"affinity\": \"%s\" }",
+		       task->state, task->kthread ? "true" : "false",
+		       task->cpu, policy_name(task->policy),
+		       task->rt_priority, affinity);
+		separator = ",";
+	}
+	printf("\n      ]\n    }");
+}
+
+static void print_json(void)
+{
+	char path[PATH_MAX];
+	char value[VALUE_SIZE];
+	const char *separator = "";
+	size_t idx;
+
+	printf("{\n  \"cpuset_root\": ");
+	json_string(option_cpuset_root);
+	printf(",\n  \"partitions\": [\n");
+	for (idx = 0; idx < nr_partitions; idx++) {
+		printf("%s", separator);
+		print_json_partition(&partitions[idx]);
+		separator = ",\n";
+	}
+	printf("\n  ],\n");
+
+	printf("  \"irqs\": [");
+	separator = "";
+	for (idx = 0; idx < nr_irqs; idx++) {
+		printf("%s\n    { \"irq\": %d, \"name\": ", separator,
+		       irqs[idx].irq);
+		json_string(irqs[idx].name);
+		printf(", \"affinity\": \"%s\" }", irqs[idx].affinity);
+		separator = ",";
+	}
+	printf("\n  ],\n");
+
+	printf("  \"knobs\": {");
+	separator = "";
+	for (idx = 0; knob_files[idx] != NULL; idx++) {
+		printf("%s\n    ", separator);
+		json_string(knob_files[idx]);
+		printf(": ");
+		sysfs_path(path, sizeof(path), "%s", knob_files[idx]);
+		if (sysfs_read(path, value, sizeof(value)) == -1)
+			printf("null");
+		else
+			json_string(value);
+		separator = ",";
+	}
+	printf("\n  }\n}\n");
+}
+
+static void cleanup(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_partitions; idx++) {
+		free(partitions[idx].name);
+		free(partitions[idx].tasks);
+		bitmap_free(partitions[idx].cpu_set);
+	}
+	free(partitions);
+
+	for (idx = 0; idx < nr_irqs; idx++)
+		bitmap_free(irqs[idx].cpu_set);
+	free(irqs);
+
+	free(task_affinity_pool);
+}
+
+static void usage(void)
+{
+	puts("partrt-status - Show the state of CPU partitions\n"
+	     "Usage:\n"
+	     "partrt-status [options] <cpuset root>\n"
+	     "\n"
+	     "Shows, for each cpuset partition and each of its CPUs, the tasks, IRQs,\n"
+	     "scheduling policies and priorities, as well as the values of the knobs\n"
+	     "that 'partrt create' changes. Normally started by 'partrt status'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-j, --json              Print the state as JSON.\n"
+	     "-p, --prefix=<prefix>   Prefix of cpuset files, e.g. 'cpuset.'.\n"
+	     "-t, --tasks             List every task in text output.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-status %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"json", no_argument, NULL, 'j'},
+		{"prefix", required_argument, NULL, 'p'},
+		{"tasks", no_argument, NULL, 't'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVjp:t";
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'j':
+			option_json = 1;
+			break;
+		case 'p':
+			option_cpuset_prefix = optarg;
+			break;
+		case 't':
+			option_list_tasks = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind != 1)
+		fail("Expected <cpuset root>");
+	option_cpuset_root = argv[optind];
+
+	nr_cpus = get_nr_cpus();
+	affinity_size = CPU_ALLOC_SIZE(nr_cpus);
+	info("%zu possible CPUs", nr_cpus);
+
+	read_partitions();
+	read_tasks();
+	read_irqs();
+
+	if (option_json)
+		print_json();
+	else
+		print_text();
+
+	cleanup();
+
+	return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements helpers for reading and writing virtual files.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int sysfs_read(const char *file, char *buf, size_t size)
+{
+	const int fd = open(file, O_RDONLY | O_CLOEXEC);
+	ssize_t len;
+	int saved_errno;
+
+	if (fd == -1)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	saved_errno = errno;
+	close(fd);
+
+	if (len == -1) {
+		errno = saved_errno;
+		return -1;
+	}
+
+	while ((len > 0) && ((buf[len - 1] == '\n') || (buf[len - 1] == ' ')))
+		len--;
+	buf[len] = '\0';
+
+	return 0;
+}
+
+ssize_t sysfs_read_at(int dirfd, const char *file, char *buf, size_t size)
+{
+	const int fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+	ssize_t len;
+	int saved_errno;
+
+	if (fd == -1)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	saved_errno = errno;
+	close(fd);
+
+	if (len == -1) {
+		errno = saved_errno;
+		return -1;
+	}
+	buf[len] = '\0';
+
+	return len;
+}
+
+char *sysfs_read_all(const char *file)
+{
+	const int fd = open(file, O_RDONLY | O_CLOEXEC);
+	size_t size = 4096;
+	size_t len = 0;
+	char *buf;
+
+	if (fd == -1)
+		return NULL;
+
+	buf = checked_malloc(size);
+	for (;;) {
+		const ssize_t status = read(fd, &buf[len], size - len - 1);
+
+		if (status == -1) {
+			const int saved_errno = errno;
+
+			free(buf);
+			close(fd);
+			errno = saved_errno;
+			return NULL;
+		}
+		if (status == 0)
+			break;
+
+		len += (size_t) status;
+		if (len == size - 1) {
+			size *= 2;
+			buf = checked_realloc(buf, size);
+		}
+	}
+	close(fd);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+int sysfs_write(const char *file, const char *value)
+{
+	/* O_TRUNC like a shell redirection, ignored by virtual files but
+	 * needed when they are faked with plain files */
+	const int fd = open(file, O_WRONLY | O_TRUNC | O_CLOEXEC);
+	const size_t len = strlen(value);
+	ssize_t status;
+	int saved_errno;
+
+	if (fd == -1)
+		return -1;
+
+	status = write(fd, value, len);
+	saved_errno = errno;
+
+	if ((close(fd) == -1) && (status != -1)) {
+		saved_errno = errno;
+		status = -1;
+	}
+
+	if (status == -1) {
+		errno = saved_errno;
+		return -1;
+	}
+
+	if ((size_t) status != len) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+int sysfs_replace(const char *file, const char *value, char *old_value,
+		  size_t size)
+{
+	if (sysfs_read(file, old_value, size) == -1)
+		return -1;
+	if (strcmp(old_value, value) == 0)
+		return 0;
+	if (sysfs_write(file, value) == -1)
+		return -1;
+
+	return 1;
+}
+
+void sysfs_task_comm(pid_t tid, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+
+	sysfs_path(path, sizeof(path), "/proc/%d/comm", (int) tid);
+	if (sysfs_read(path, buf, size) == -1)
+		snprintf(buf, size, "?");
+}
+
+const char *sysfs_root(void)
+{
+	static const char *root = NULL;
+
+	if (root == NULL) {
+		root = getenv("PARTRT_SYSROOT");
+		if (root == NULL)
+			root = "";
+	}
+
+	return root;
+}
+
+void sysfs_path(char *buf, size_t size, const char *format, ...)
+{
+	const int len = snprintf(buf, size, "%s", sysfs_root());
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(&buf[len], size - (size_t) len, format, args);
+	va_end(args);
+}
+
+int sysfs_getaffinity(pid_t tid, size_t size, cpu_set_t *set)
+{
+	char path[PATH_MAX];
+	char *status;
+	char *list;
+	struct bitmap_t *cpus;
+	size_t cpu;
+
+	if (*sysfs_root() == '\0')
+		return sched_getaffinity(tid, size, set);
+
+	sysfs_path(path, sizeof(path), "/proc/%d/status", (int) tid);
+	status = sysfs_read_all(path);
+	if (status == NULL) {
+		errno = ESRCH;
+		return -1;
+	}
+	list = strstr(status, "Cpus_allowed_list:");
+	if (list == NULL) {
+		free(status);
+		errno = EINVAL;
+		return -1;
+	}
+	list += strcspn(list, "\t");
+	list += strspn(list, "\t");
+	list[strcspn(list, "\n")] = '\0';
+
+	cpus = bitmap_alloc_from_list(list);
+	CPU_ZERO_S(size, set);
+	for (cpu = 0; cpu < 8 * size; cpu++)
+		if (bitmap_isset(cpu, cpus))
+			CPU_SET_S(cpu, size, set);
+	bitmap_free(cpus);
+	free(status);
+
+	return 0;
+}
+
+static struct bitmap_t *cpu_set_bitmap(size_t size, const cpu_set_t *set)
+{
+	struct bitmap_t *cpus = bitmap_alloc_zero();
+	size_t cpu;
+
+	for (cpu = 0; cpu < 8 * size; cpu++) {
+		struct bitmap_t *bit;
+		struct bitmap_t *both;
+
+		if (!CPU_ISSET_S(cpu, size, set))
+			continue;
+
+		bit = bitmap_alloc_set(cpu);
+		both = bitmap_or(cpus, bit);
+		bitmap_free(bit);
+		bitmap_free(cpus);
+		cpus = both;
+	}
+
+	return cpus;
+}
+
+int sysfs_setaffinity(pid_t tid, size_t size, const cpu_set_t *set)
+{
+	char path[PATH_MAX];
+	struct bitmap_t *cpus;
+	char *status;
+	char *mask;
+	char *list;
+	char *new_status;
+	size_t new_size;
+	size_t len = 0;
+	const char *line;
+	const char *next;
+	int result;
+
+	if (*sysfs_root() == '\0')
+		return sched_setaffinity(tid, size, set);
+	if (tid == 0)
+		return 0;
+
+	sysfs_path(path, sizeof(path), "/proc/%d/status", (int) tid);
+	status = sysfs_read_all(path);
+	if (status == NULL) {
+		errno = ESRCH;
+		return -1;
+	}
+
+	cpus = cpu_set_bitmap(size, set);
+	mask = bitmap_u32list(cpus);
+	list = bitmap_list(cpus);
+	bitmap_free(cpus);
+
+	/* Rewrite the two lines sysfs_getaffinity() and partrt status read,
+	 * keep the rest of the file */
+	new_size = strlen(status) + strlen(mask) + strlen(list) + 64;
+	new_status = checked_malloc(new_size);
+	for (line = status; *line != '\0'; line = next) {
+		next = line + strcspn(line, "\n");
+		if (*next == '\n')
+			next++;
+
+		if (strncmp(line, "Cpus_allowed:", 13) == 0)
+			len += (size_t) snprintf(&new_status[len],
+						 new_size - len,
+						 "Cpus_allowed:\t%s\n", mask);
+		else if (strncmp(line, "Cpus_allowed_list:", 18) == 0)
+			len += (size_t) snprintf(&new_status[len],
+						 new_size - len,
+						 "Cpus_allowed_list:\t%s\n",
+						 list);
+		else
+			len += (size_t) snprintf(&new_status[len],
+						 new_size - len, "%.*s",
+						 (int) (next - line), line);
+	}
+
+	result = sysfs_write(path, new_status);
+
+	free(new_status);
+	free(list);
+	free(mask);
+	free(status);
+
+	return result;
+}
+
+size_t sysfs_nr_cpus(void)
+{
+	char path[PATH_MAX];
+	char present[256];
+	struct bitmap_t *cpus;
+	size_t nr_cpus;
+
+	if (*sysfs_root() == '\0')
+		return (size_t) sysconf(_SC_NPROCESSORS_CONF);
+
+	sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/present");
+	if (sysfs_read(path, present, sizeof(present)) == -1)
+		fail("%s: Could not read: %s", path, strerror(errno));
+
+	/* One more than the highest present CPU, e.g. 6 for "0-3,5" */
+	cpus = bitmap_alloc_from_list(present);
+	for (nr_cpus = bitmap_nr_bits(cpus);
+	     (nr_cpus > 0) && !bitmap_isset(nr_cpus - 1, cpus); nr_cpus--)
+		;
+	bitmap_free(cpus);
+
+	return nr_cpus;
+}
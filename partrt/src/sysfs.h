@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SYSFS_H
+#define SYSFS_H
+
+#include <sched.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Helpers for reading and writing sysfs, procfs and cgroupfs files.
+ */
+
+/* Read at most size - 1 bytes of file into buf, and strip trailing
+ * white space. Returns 0 on success, otherwise -1 with errno set. */
+extern int sysfs_read(const char *file, char *buf, size_t size);
+
+/* Read at most size - 1 bytes of file, relative to dirfd, into buf and
+ * zero terminate it. Nothing is stripped. Used for reading many small files
+ * under one directory, e.g. /proc, without a path lookup from the root.
+ * Returns number of bytes read, or -1 with errno set. */
+extern ssize_t sysfs_read_at(int dirfd, const char *file, char *buf,
+			     size_t size);
+
+/* Read all of file into an allocated, zero terminated buffer. Used for files
+ * with no size limit, e.g. the cpuset tasks file. Returns NULL with errno set
+ * on failure. */
+extern char *sysfs_read_all(const char *file);
+
+/* Write value to file in a single write() call, which is what these file
+ * systems expect. Returns 0 on success, otherwise -1 with errno set. */
+extern int sysfs_write(const char *file, const char *value);
+
+/* Write value to file unless it already holds value, and store the previous
+ * value in old_value. Used where the previous value is logged for undo.
+ * Returns 1 if file was changed, 0 if not, otherwise -1 with errno set. */
+extern int sysfs_replace(const char *file, const char *value,
+			 char *old_value, size_t size);
+
+/* Read the short name of a task into buf, "?" if the task is gone */
+extern void sysfs_task_comm(pid_t tid, char *buf, size_t size);
+
+/* Directory the sysfs, procfs and cgroupfs trees are found in, "" for the
+ * real ones. Taken from the PARTRT_SYSROOT environment variable, which
+ * points the helpers at a fake tree, e.g. one made by fake_sysfs.py. */
+extern const char *sysfs_root(void);
+
+/* Format a path below sysfs_root() into buf */
+extern void sysfs_path(char *buf, size_t size, const char *format, ...)
+	__attribute__((format(printf, 3, 4)));
+
+/* sched_getaffinity() and sched_setaffinity() of a task. Below a fake root
+ * the affinity is read from Cpus_allowed_list in <root>/proc/<tid>/status,
+ * and setting it rewrites Cpus_allowed and Cpus_allowed_list there, so that
+ * tests can check it. The calling thread, tid 0, is not part of a fake tree
+ * and is left alone. */
+extern int sysfs_getaffinity(pid_t tid, size_t size, cpu_set_t *set);
+extern int sysfs_setaffinity(pid_t tid, size_t size, const cpu_set_t *set);
+
+/* Number of configured CPUs, like sysconf(_SC_NPROCESSORS_CONF), taken from
+ * <root>/sys/devices/system/cpu/present below a fake root */
+extern size_t sysfs_nr_cpus(void);
+
+#endif
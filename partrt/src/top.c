@@ -0,0 +1,971 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * partrt-top: Monitors how the tasks in real time partitions are scheduled.
+ *
+ * Each thread listed in the partition tasks files is sampled every period
+ * from /proc/<tid>/schedstat (run time, run queue wait) and
+ * /proc/<tid>/sched (voluntary and involuntary switches, migrations,
+ * policy), and if available from taskstats over generic netlink (I/O,
+ * swap-in, reclaim and thrashing delays). The proc files are kept open
+ * between samples and re-read with pread(), so a sample costs two reads
+ * per thread and no path lookups. A real time thread is flagged when it
+ * was involuntarily switched out, i.e. preempted, or migrated to another
+ * CPU since the previous sample.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "sysfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/taskstats.h>
+
+#define DEFAULT_PERIOD_MS 1000
+#define COMM_SIZE 64
+#define SCHEDSTAT_SIZE 128
+#define SCHED_SIZE 8192
+#define NETLINK_BUF_SIZE 8192
+
+/* NLA_ALIGN() and NLA_HDRLEN mix signed and unsigned, like NLMSG_OK() */
+#define ATTR_ALIGN(len) (((size_t) (len) + 3) & ~(size_t) 3)
+#define ATTR_HDRLEN ATTR_ALIGN(sizeof(struct nlattr))
+
+/* Counters of a thread at one point in time. Fields not provided by the
+ * running kernel are left 0 and the matching has_ flag cleared. */
+struct sample_t {
+	unsigned long long run_ns;
+	unsigned long long wait_ns;
+	unsigned long long voluntary;
+	unsigned long long involuntary;
+	unsigned long long migrations;
+	unsigned long long delay_ns;
+	int has_schedstat;
+	int has_migrations;
+	int has_delay;
+};
+
+struct thread_t {
+	pid_t tid;
+	const char *partition;
+	/* /proc/<tid>/schedstat and /proc/<tid>/sched, or /proc/<tid>/status
+	 * when the kernel has no sched file. -1 if they could not be kept
+	 * open, the files are then opened for each sample. */
+	int schedstat_fd;
+	int sched_fd;
+	int sched_is_status;
+	int seen;
+	unsigned long nr_samples;
+	unsigned long policy;
+	unsigned long rt_priority;
+	char comm[COMM_SIZE];
+	struct sample_t first;
+	struct sample_t prev;
+	struct sample_t cur;
+	unsigned long preempted;
+	unsigned long migrated;
+};
+
+static unsigned long option_period_ms = DEFAULT_PERIOD_MS;
+static unsigned long option_count = 0;
+static int option_batch = 0;
+static int option_flagged = 0;
+static int option_taskstats = 1;
+
+static const char **partitions = NULL;
+static size_t nr_partitions = 0;
+
+/* Sorted on tid */
+static struct thread_t *threads = NULL;
+static size_t nr_threads = 0;
+
+static int netlink_fd = -1;
+static uint16_t taskstats_family = 0;
+static uint32_t netlink_seq = 0;
+
+static volatile sig_atomic_t stop = 0;
+
+static void handle_signal(int sig)
+{
+	(void) sig;
+	stop = 1;
+}
+
+static const char *policy_name(unsigned long policy)
+{
+	switch (policy) {
+	case SCHED_OTHER:
+		return "other";
+	case SCHED_FIFO:
+		return "fifo";
+	case SCHED_RR:
+		return "rr";
+	case SCHED_BATCH:
+		return "batch";
+	case SCHED_IDLE:
+		return "idle";
+	case 6:
+		return "deadline";
+	default:
+		return "unknown";
+	}
+}
+
+static int is_rt_policy(unsigned long policy)
+{
+	return (policy == SCHED_FIFO) || (policy == SCHED_RR) || (policy == 6);
+}
+
+/*
+ * Taskstats over generic netlink
+ */
+
+/* Find attribute of type among the attributes in data. Returns NULL if
+ * not found. */
+static const struct nlattr *find_attr(const char *data, size_t len,
+				      uint16_t type)
+{
+	while (len >= ATTR_HDRLEN) {
+		const struct nlattr *const attr =
+			(const struct nlattr *) data;
+		size_t attr_len;
+
+		if ((attr->nla_len < ATTR_HDRLEN) || (attr->nla_len > len))
+			return NULL;
+		if ((attr->nla_type & NLA_TYPE_MASK) == type)
+			return attr;
+
+		attr_len = ATTR_ALIGN(attr->nla_len);
+		if (attr_len >= len)
+			return NULL;
+		data += attr_len;
+		len -= attr_len;
+	}
+
+	return NULL;
+}
+
+/* Send a generic netlink request with one attribute, and receive the reply
+ * into buf. Returns the attributes of the reply and their length in len, or
+ * NULL with errno set. */
+static const char *netlink_request(uint16_t type, uint8_t cmd,
+				   uint16_t attr_type, const void *data,
+				   size_t data_len, char *buf, size_t size,
+				   size_t *len)
+{
+	const size_t payload = GENL_HDRLEN + ATTR_HDRLEN + data_len;
+	struct nlmsghdr *const header = (struct nlmsghdr *) buf;
+	struct genlmsghdr *const genl = NLMSG_DATA(header);
+	struct nlattr *const attr =
+		(struct nlattr *) ((char *) genl + GENL_HDRLEN);
+	struct sockaddr_nl addr;
+	ssize_t status;
+
+	memset(buf, 0, NLMSG_SPACE(payload));
+	header->nlmsg_len = (__u32) NLMSG_LENGTH(payload);
+	header->nlmsg_type = type;
+	header->nlmsg_flags = NLM_F_REQUEST;
+	header->nlmsg_seq = ++netlink_seq;
+	header->nlmsg_pid = (__u32) getpid();
+	genl->cmd = cmd;
+	genl->version = 1;
+	attr->nla_type = attr_type;
+	attr->nla_len = (__u16) (ATTR_HDRLEN + data_len);
+	memcpy((char *) attr + ATTR_HDRLEN, data, data_len);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (sendto(netlink_fd, buf, header->nlmsg_len, 0,
+		   (struct sockaddr *) &addr, sizeof(addr)) == -1)
+		return NULL;
+
+	/* Skip replies to earlier requests that timed out */
+	do {
+		status = recv(netlink_fd, buf, size, 0);
+		if (status == -1)
+			return NULL;
+		if (((size_t) status < sizeof(*header)) ||
+		    (header->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)) ||
+		    (header->nlmsg_len > (size_t) status)) {
+			if ((header->nlmsg_type == NLMSG_ERROR) &&
+			    ((size_t) status >= NLMSG_LENGTH(sizeof(struct nlmsgerr))))
+				break;
+			errno = EBADMSG;
+			return NULL;
+		}
+	} while (header->nlmsg_seq != netlink_seq);
+
+	if (header->nlmsg_type == NLMSG_ERROR) {
+		const struct nlmsgerr *const error = NLMSG_DATA(header);
+
+		errno = (error->error < 0) ? -error->error : EBADMSG;
+		return NULL;
+	}
+
+	*len = header->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+	return (const char *) NLMSG_DATA(header) + GENL_HDRLEN;
+}
+
+/* Open the netlink socket and look up the taskstats family. Taskstats is
+ * left out if the kernel does not support it. */
+static void taskstats_open(void)
+{
+	char buf[NETLINK_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	const struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+	const struct nlattr *attr;
+	const char *attrs;
+	size_t len;
+
+	netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+			    NETLINK_GENERIC);
+	if (netlink_fd == -1) {
+		info("Taskstats not available, netlink socket: %s",
+		     strerror(errno));
+		return;
+	}
+	setsockopt(netlink_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+		   sizeof(timeout));
+
+	attrs = netlink_request(GENL_ID_CTRL, CTRL_CMD_GETFAMILY,
+				CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME,
+				sizeof(TASKSTATS_GENL_NAME), buf, sizeof(buf),
+				&len);
+	attr = (attrs == NULL) ? NULL :
+		find_attr(attrs, len, CTRL_ATTR_FAMILY_ID);
+	if ((attr == NULL) || (attr->nla_len < ATTR_HDRLEN + sizeof(uint16_t))) {
+		info("Taskstats not available: %s",
+		     (attrs == NULL) ? strerror(errno) : "No family ID");
+		close(netlink_fd);
+		netlink_fd = -1;
+		return;
+	}
+
+	memcpy(&taskstats_family, (const char *) attr + ATTR_HDRLEN,
+	       sizeof(taskstats_family));
+	info("Taskstats family %u", (unsigned) taskstats_family);
+}
+
+/* Sum of the delays, other than waiting for a CPU, that taskstats
+ * accounts. Returns -1 if the task is gone or delay accounting is not
+ * available. */
+static int taskstats_delay(pid_t tid, unsigned long long *delay_ns)
+{
+	char buf[NETLINK_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	const __u32 pid = (__u32) tid;
+	const struct nlattr *aggr;
+	const struct nlattr *stats_attr;
+	struct taskstats stats;
+	const char *attrs;
+	size_t len;
+
+	attrs = netlink_request(taskstats_family, TASKSTATS_CMD_GET,
+				TASKSTATS_CMD_ATTR_PID, &pid, sizeof(pid),
+				buf, sizeof(buf), &len);
+	if (attrs == NULL)
+		return -1;
+
+	aggr = find_attr(attrs, len, TASKSTATS_TYPE_AGGR_PID);
+	if (aggr == NULL)
+		return -1;
+	stats_attr = find_attr((const char *) aggr + ATTR_HDRLEN,
+			       aggr->nla_len - ATTR_HDRLEN,
+			       TASKSTATS_TYPE_STATS);
+	if (stats_attr == NULL)
+		return -1;
+
+	/* Older kernels send a shorter struct */
+	len = stats_attr->nla_len - ATTR_HDRLEN;
+	if (len > sizeof(stats))
+		len = sizeof(stats);
+	memset(&stats, 0, sizeof(stats));
+	memcpy(&stats, (const char *) stats_attr + ATTR_HDRLEN, len);
+
+	*delay_ns = stats.blkio_delay_total + stats.swapin_delay_total +
+		stats.freepages_delay_total + stats.thrashing_delay_total;
+	return 0;
+}
+
+/*
+ * Procfs sampling
+ */
+
+/* Open /proc/<tid>/<name>. A failure to keep it open because of the file
+ * limit is not an error, the file is then opened for each sample. Returns
+ * -1 if the file does not exist. */
+static int open_task_file(pid_t tid, const char *name, int *fd)
+{
+	char path[PATH_MAX];
+
+	sysfs_path(path, sizeof(path), "/proc/%d/%s", (int) tid, name);
+	*fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (*fd != -1)
+		return 0;
+
+	return ((errno == EMFILE) || (errno == ENFILE)) ? 0 : -1;
+}
+
+/* Read /proc/<tid>/<name> from offset 0 through fd, or by path if fd is
+ * -1. Returns -1 if the task is gone. */
+static int read_task_file(pid_t tid, const char *name, int fd, char *buf,
+			  size_t size)
+{
+	char path[PATH_MAX];
+	ssize_t len;
+
+	if (fd == -1) {
+		sysfs_path(path, sizeof(path), "/proc/%d/%s", (int) tid,
+			   name);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return -1;
+		len = pread(fd, buf, size - 1, 0);
+		close(fd);
+	} else {
+		len = pread(fd, buf, size - 1, 0);
+	}
+
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	return 0;
+}
+
+/* Value of "<key>: <value>" lines as found in the sched and status files */
+static int parse_key(const char *line, const char *key,
+		     unsigned long long *value)
+{
+	const size_t key_len = strlen(key);
+	const char *colon;
+
+	if ((strncmp(line, key, key_len) != 0) ||
+	    ((line[key_len] != ' ') && (line[key_len] != ':') &&
+	     (line[key_len] != '\t')))
+		return 0;
+
+	colon = strchr(line, ':');
+	if (colon == NULL)
+		return 0;
+
+	*value = strtoull(colon + 1, NULL, 10);
+	return 1;
+}
+
+/* Parse /proc/<tid>/sched. The first line is "<comm> (<tid>, #threads:
+ * <n>)", followed by "<key> : <value>" lines. */
+static void parse_sched(struct thread_t *thread, char *sched)
+{
+	struct sample_t *const sample = &thread->cur;
+	unsigned long long value;
+	unsigned long long prio = 0;
+	char *line = sched;
+	char *next;
+	char *comm_end;
+
+	next = strchr(line, '\n');
+	if (next != NULL)
+		*next++ = '\0';
+	comm_end = strrchr(line, '(');
+	if ((comm_end != NULL) && (comm_end > line)) {
+		size_t comm_len = (size_t) (comm_end - line - 1);
+
+		if (comm_len >= sizeof(thread->comm))
+			comm_len = sizeof(thread->comm) - 1;
+		memcpy(thread->comm, line, comm_len);
+		thread->comm[comm_len] = '\0';
+	}
+
+	for (line = next; line != NULL; line = next) {
+		next = strchr(line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+
+		if (parse_key(line, "se.nr_migrations", &value)) {
+			sample->migrations = value;
+			sample->has_migrations = 1;
+		} else if (parse_key(line, "nr_voluntary_switches", &value)) {
+			sample->voluntary = value;
+		} else if (parse_key(line, "nr_involuntary_switches",
+				     &value)) {
+			sample->involuntary = value;
+		} else if (parse_key(line, "policy", &value)) {
+			thread->policy = (unsigned long) value;
+		} else if (parse_key(line, "prio", &value)) {
+			prio = value;
+		}
+	}
+
+	/* Kernel priority 0-99 is real time priority 99-0 */
+	thread->rt_priority = (is_rt_policy(thread->policy) && (prio < 100)) ?
+		(unsigned long) (99 - prio) : 0;
+}
+
+/* Parse /proc/<tid>/status, used when the kernel has no sched file. The
+ * policy is then taken from the scheduler and migrations are unknown. */
+static void parse_status(struct thread_t *thread, char *status)
+{
+	struct sample_t *const sample = &thread->cur;
+	struct sched_param param;
+	unsigned long long value;
+	char *line;
+	char *next;
+	int policy;
+
+	for (line = status; line != NULL; line = next) {
+		next = strchr(line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+
+		if (strncmp(line, "Name:\t", 6) == 0)
+			snprintf(thread->comm, sizeof(thread->comm), "%s",
+				 line + 6);
+		else if (parse_key(line, "voluntary_ctxt_switches", &value))
+			sample->voluntary = value;
+		else if (parse_key(line, "nonvoluntary_ctxt_switches",
+				   &value))
+			sample->involuntary = value;
+	}
+
+	policy = sched_getscheduler(thread->tid);
+	if (policy != -1)
+		thread->policy = (unsigned long) (policy & ~SCHED_RESET_ON_FORK);
+	if (sched_getparam(thread->tid, &param) == 0)
+		thread->rt_priority = (unsigned long) param.sched_priority;
+}
+
+/* Take a new sample of thread. Returns -1 if the thread is gone. */
+static int sample_thread(struct thread_t *thread)
+{
+	struct sample_t *const sample = &thread->cur;
+	char schedstat[SCHEDSTAT_SIZE];
+	char sched[SCHED_SIZE];
+
+	memset(sample, 0, sizeof(*sample));
+
+	if (read_task_file(thread->tid,
+			   thread->sched_is_status ? "status" : "sched",
+			   thread->sched_fd, sched, sizeof(sched)) == -1)
+		return -1;
+	if (thread->sched_is_status)
+		parse_status(thread, sched);
+	else
+		parse_sched(thread, sched);
+
+	/* "<run ns> <wait ns> <timeslices>" */
+	if (read_task_file(thread->tid, "schedstat", thread->schedstat_fd,
+			   schedstat, sizeof(schedstat)) == 0) {
+		char *end;
+
+		sample->run_ns = strtoull(schedstat, &end, 10);
+		sample->wait_ns = strtoull(end, NULL, 10);
+		sample->has_schedstat = 1;
+	}
+
+	if ((netlink_fd != -1) &&
+	    (taskstats_delay(thread->tid, &sample->delay_ns) == 0))
+		sample->has_delay = 1;
+
+	if (thread->nr_samples == 0)
+		thread->first = *sample;
+	thread->nr_samples++;
+
+	return 0;
+}
+
+static int open_thread(struct thread_t *thread, pid_t tid,
+		       const char *partition)
+{
+	memset(thread, 0, sizeof(*thread));
+	thread->tid = tid;
+	thread->partition = partition;
+	thread->schedstat_fd = -1;
+	snprintf(thread->comm, sizeof(thread->comm), "?");
+
+	if (open_task_file(tid, "sched", &thread->sched_fd) == -1) {
+		thread->sched_is_status = 1;
+		if (open_task_file(tid, "status", &thread->sched_fd) == -1)
+			return -1;
+	}
+	if (open_task_file(tid, "schedstat", &thread->schedstat_fd) == -1)
+		thread->schedstat_fd = -1;
+
+	return 0;
+}
+
+static void close_thread(struct thread_t *thread)
+{
+	if (thread->sched_fd != -1)
+		close(thread->sched_fd);
+	if (thread->schedstat_fd != -1)
+		close(thread->schedstat_fd);
+	thread->sched_fd = -1;
+	thread->schedstat_fd = -1;
+}
+
+static int thread_compare(const void *first, const void *second)
+{
+	const struct thread_t *const thread1 = first;
+	const struct thread_t *const thread2 = second;
+
+	return (thread1->tid > thread2->tid) - (thread1->tid < thread2->tid);
+}
+
+static struct thread_t *find_thread(pid_t tid)
+{
+	struct thread_t key;
+
+	key.tid = tid;
+	return bsearch(&key, threads, nr_threads, sizeof(*threads),
+		       thread_compare);
+}
+
+/* Bring the thread list up to date with the partition tasks files. New
+ * threads get their files opened, threads that left are closed. */
+static void update_threads(void)
+{
+	struct thread_t *new_threads = NULL;
+	size_t nr_new = 0;
+	size_t size = 0;
+	size_t part_idx;
+	size_t idx;
+
+	for (idx = 0; idx < nr_threads; idx++)
+		threads[idx].seen = 0;
+
+	for (part_idx = 0; part_idx < nr_partitions; part_idx++) {
+		char path[PATH_MAX];
+		char *tasks;
+		char *pos;
+		char *end;
+
+		snprintf(path, sizeof(path), "%s/tasks", partitions[part_idx]);
+		tasks = sysfs_read_all(path);
+		if (tasks == NULL)
+			fail("%s: Could not read tasks: %s", path,
+			     strerror(errno));
+
+		for (pos = tasks; ; pos = end) {
+			const pid_t tid = (pid_t) strtol(pos, &end, 10);
+			struct thread_t *thread;
+
+			if (end == pos)
+				break;
+
+			thread = find_thread(tid);
+			if (thread != NULL) {
+				thread->seen = 1;
+				thread->partition = partitions[part_idx];
+				continue;
+			}
+
+			if (nr_new == size) {
+				size = (size == 0) ? 64 : size * 2;
+				new_threads = checked_realloc(
+					new_threads,
+					size * sizeof(*new_threads));
+			}
+			if (open_thread(&new_threads[nr_new], tid,
+					partitions[part_idx]) == 0)
+				new_threads[nr_new++].seen = 1;
+			else
+				debug("Task %d gone before it was sampled",
+				      (int) tid);
+		}
+		free(tasks);
+	}
+
+	/* Drop threads that left, and merge in the new ones */
+	for (idx = 0, size = 0; idx < nr_threads; idx++) {
+		if (threads[idx].seen)
+			threads[size++] = threads[idx];
+		else
+			close_thread(&threads[idx]);
+	}
+	nr_threads = size;
+
+	if (nr_new > 0) {
+		threads = checked_realloc(threads, (nr_threads + nr_new) *
+					  sizeof(*threads));
+		memcpy(&threads[nr_threads], new_threads,
+		       nr_new * sizeof(*new_threads));
+		nr_threads += nr_new;
+		qsort(threads, nr_threads, sizeof(*threads), thread_compare);
+	}
+	free(new_threads);
+}
+
+/* Sample all threads. Threads that exited since the tasks files were read
+ * are closed and left out until they are dropped by the next update. */
+static void sample_threads(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_threads; idx++) {
+		struct thread_t *const thread = &threads[idx];
+
+		thread->prev = thread->cur;
+		if (sample_thread(thread) == -1) {
+			close_thread(thread);
+			thread->seen = 0;
+			thread->nr_samples = 0;
+		}
+	}
+}
+
+/*
+ * Output
+ */
+
+static double rate(unsigned long long cur, unsigned long long prev,
+		   double seconds)
+{
+	return (cur >= prev) ? (double) (cur - prev) / seconds : 0.0;
+}
+
+static void print_sample(double seconds)
+{
+	char timestr[32];
+	struct timespec now;
+	struct tm tm;
+	size_t nr_sampled = 0;
+	size_t nr_rt = 0;
+	size_t nr_flagged = 0;
+	size_t idx;
+
+	for (idx = 0; idx < nr_threads; idx++) {
+		struct thread_t *const thread = &threads[idx];
+		const struct sample_t *const cur = &thread->cur;
+		const struct sample_t *const prev = &thread->prev;
+
+		if (!thread->seen || (thread->nr_samples < 2))
+			continue;
+
+		nr_sampled++;
+		if (!is_rt_policy(thread->policy))
+			continue;
+		nr_rt++;
+		if (cur->involuntary > prev->involuntary)
+			thread->preempted++;
+		if (cur->migrations > prev->migrations)
+			thread->migrated++;
+		if ((cur->involuntary > prev->involuntary) ||
+		    (cur->migrations > prev->migrations))
+			nr_flagged++;
+	}
+
+	if (!option_batch && isatty(STDOUT_FILENO))
+		fputs("\033[H\033[2J", stdout);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	localtime_r(&now.tv_sec, &tm);
+	strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &tm);
+	printf("%s: %zu threads, %zu real-time, %zu flagged\n", timestr,
+	       nr_sampled, nr_rt, nr_flagged);
+	printf("%7s %-10s %-8s %4s %6s %10s %10s %8s %8s %8s %-18s %s\n",
+	       "TID", "Partition", "Policy", "Prio", "Run %", "Wait us/s",
+	       "Delay us/s", "Vol/s", "Invol/s", "Migr/s", "Flags",
+	       "Command");
+
+	for (idx = 0; idx < nr_threads; idx++) {
+		const struct thread_t *const thread = &threads[idx];
+		const struct sample_t *const cur = &thread->cur;
+		const struct sample_t *const prev = &thread->prev;
+		const char *partition;
+		char run[16] = "-";
+		char wait[16] = "-";
+		char delay[16] = "-";
+		char migrations[16] = "-";
+		char flags[32] = "";
+		int preempted;
+		int migrated;
+
+		if (!thread->seen || (thread->nr_samples < 2))
+			continue;
+
+		preempted = is_rt_policy(thread->policy) &&
+			(cur->involuntary > prev->involuntary);
+		migrated = is_rt_policy(thread->policy) &&
+			(cur->migrations > prev->migrations);
+		if (option_flagged && !preempted && !migrated)
+			continue;
+
+		if (cur->has_schedstat && prev->has_schedstat) {
+			snprintf(run, sizeof(run), "%.1f",
+				 rate(cur->run_ns, prev->run_ns, seconds) /
+				 1e7);
+			snprintf(wait, sizeof(wait), "%.1f",
+				 rate(cur->wait_ns, prev->wait_ns, seconds) /
+				 1e3);
+		}
+		if (cur->has_delay && prev->has_delay)
+			snprintf(delay, sizeof(delay), "%.1f",
+				 rate(cur->delay_ns, prev->delay_ns, seconds) /
+				 1e3);
+		if (cur->has_migrations && prev->has_migrations)
+			snprintf(migrations, sizeof(migrations), "%.1f",
+				 rate(cur->migrations, prev->migrations,
+				      seconds));
+		snprintf(flags, sizeof(flags), "%s%s%s",
+			 preempted ? "preempted" : "",
+			 (preempted && migrated) ? "," : "",
+			 migrated ? "migrated" : "");
+
+		partition = strrchr(thread->partition, '/');
+		partition = (partition == NULL) ? thread->partition :
+			partition + 1;
+
+		printf("%7d %-10s %-8s %4lu %6s %10s %10s %8.1f %8.1f %8s %-18s %s\n",
+		       (int) thread->tid, partition,
+		       policy_name(thread->policy), thread->rt_priority, run,
+		       wait, delay,
+		       rate(cur->voluntary, prev->voluntary, seconds),
+		       rate(cur->involuntary, prev->involuntary, seconds),
+		       migrations, flags, thread->comm);
+	}
+	putchar('\n');
+	fflush(stdout);
+}
+
+/* Real time threads that were preempted or migrated during the run */
+static void print_summary(void)
+{
+	size_t nr_flagged = 0;
+	size_t idx;
+
+	for (idx = 0; idx < nr_threads; idx++)
+		if (threads[idx].preempted || threads[idx].migrated)
+			nr_flagged++;
+
+	printf("%zu real-time threads preempted or migrated\n", nr_flagged);
+	if (nr_flagged == 0)
+		return;
+
+	printf("%7s %10s %10s %12s %11s %s\n", "TID", "Preempted",
+	       "Migrated", "Involuntary", "Migrations", "Command");
+	for (idx = 0; idx < nr_threads; idx++) {
+		const struct thread_t *const thread = &threads[idx];
+
+		if (!thread->preempted && !thread->migrated)
+			continue;
+
+		printf("%7d %10lu %10lu %12llu %11llu %s\n",
+		       (int) thread->tid, thread->preempted, thread->migrated,
+		       thread->cur.involuntary - thread->first.involuntary,
+		       thread->cur.migrations - thread->first.migrations,
+		       thread->comm);
+	}
+}
+
+static void cleanup(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_threads; idx++)
+		close_thread(&threads[idx]);
+	free(threads);
+	free(partitions);
+	if (netlink_fd != -1)
+		close(netlink_fd);
+}
+
+/* Two files are kept open per thread, so allow as many as we may */
+static void raise_file_limit(void)
+{
+	struct rlimit limit;
+
+	if ((getrlimit(RLIMIT_NOFILE, &limit) == 0) &&
+	    (limit.rlim_cur < limit.rlim_max)) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+static void usage(void)
+{
+	puts("partrt-top - Monitor scheduling of tasks in CPU partitions\n"
+	     "Usage:\n"
+	     "partrt-top [options] <partition dir>...\n"
+	     "\n"
+	     "Samples every thread in the given cpuset partitions each period, and\n"
+	     "shows per second rates of run time, run queue wait, other delays,\n"
+	     "voluntary and involuntary switches and migrations. Real time threads\n"
+	     "that were preempted or migrated are flagged. Normally started by\n"
+	     "'partrt top'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-b, --batch             Do not clear the screen between samples.\n"
+	     "-f, --flagged           Only show flagged threads.\n"
+	     "-n, --count=<count>     Stop after <count> samples and print which real\n"
+	     "                        time threads were preempted or migrated.\n"
+	     "                        Default: run until interrupted\n"
+	     "-p, --period=<ms>       Sample period in milliseconds. Default: 1000\n"
+	     "-T, --no-taskstats      Do not query taskstats for delays.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-top %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"batch", no_argument, NULL, 'b'},
+		{"flagged", no_argument, NULL, 'f'},
+		{"count", required_argument, NULL, 'n'},
+		{"period", required_argument, NULL, 'p'},
+		{"no-taskstats", no_argument, NULL, 'T'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVbfn:p:T";
+	struct sigaction action;
+	struct timespec next;
+	struct timespec last;
+	struct timespec now;
+	unsigned long nr_samples;
+	char *check;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'b':
+			option_batch = 1;
+			break;
+		case 'f':
+			option_flagged = 1;
+			break;
+		case 'n':
+			option_count = strtoul(optarg, &check, 0);
+			if ((*check != '\0') || (check == optarg) ||
+			    (option_count == 0))
+				fail("'%s': Not a valid count", optarg);
+			break;
+		case 'p':
+			option_period_ms = strtoul(optarg, &check, 0);
+			if ((*check != '\0') || (check == optarg) ||
+			    (option_period_ms == 0))
+				fail("'%s': Not a valid period", optarg);
+			break;
+		case 'T':
+			option_taskstats = 0;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind < 1)
+		fail("Expected <partition dir>");
+	nr_partitions = (size_t) (argc - optind);
+	partitions = checked_malloc(nr_partitions * sizeof(*partitions));
+	for (c = 0; c < argc - optind; c++)
+		partitions[c] = argv[optind + c];
+
+	/* Tasks of a fake tree do not exist for the kernel */
+	if (option_taskstats && (sysfs_root()[0] == '\0'))
+		taskstats_open();
+
+	raise_file_limit();
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	update_threads();
+	sample_threads();
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	next = last;
+
+	for (nr_samples = 0;
+	     !stop && ((option_count == 0) || (nr_samples < option_count));
+	     nr_samples++) {
+		next.tv_sec += (time_t) (option_period_ms / 1000);
+		next.tv_nsec += (long) (option_period_ms % 1000) * 1000000L;
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				    NULL) != 0)
+			break;
+
+		update_threads();
+		sample_threads();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		print_sample((double) (now.tv_sec - last.tv_sec) +
+			     (double) (now.tv_nsec - last.tv_nsec) / 1e9);
+		last = now;
+	}
+
+	print_summary();
+	cleanup();
+
+	return 0;
+}
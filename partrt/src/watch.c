@@ -0,0 +1,771 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * partrt-watch: Keeps a partition created by "partrt create" in shape.
+ *
+ * New tasks are detected through the netlink proc connector, hot-plugged
+ * devices through kernel uevents. Neither procfs nor sysfs support inotify,
+ * so IRQ affinities and the knobs logged in the settings file are also
+ * checked in a periodic sweep. The settings file itself is watched with
+ * inotify, so the knob list is reloaded whenever partrt rewrites it.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "sysfs.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+
+#define DEFAULT_PERIOD_MS 1000
+#define VALUE_SIZE 4096
+#define NETLINK_BUF_SIZE 8192
+#define MAX_EVENTS 8
+
+/* Tasks or IRQs that could not be moved. Kept so that per-CPU kernel
+ * threads and IRQs are not retried and reported over and over. */
+struct id_set_t {
+	int *ids;
+	size_t nr;
+	size_t size;
+};
+
+/* A knob logged by partrt, and the value it should have */
+struct knob_t {
+	char *file;
+	char *value;
+};
+
+static const char *option_cpuset_root = NULL;
+static const char *option_partition = NULL;
+static const char *option_settings = NULL;
+static unsigned long option_period_ms = DEFAULT_PERIOD_MS;
+static int option_tasks = 1;
+static int option_irqs = 1;
+static int option_knobs = 1;
+static int option_once = 0;
+
+static struct bitmap_t *rt_mask;
+static const char *nrt_mask;
+
+static struct id_set_t unmovable_tasks;
+static struct id_set_t unmovable_irqs;
+
+static struct knob_t *knobs = NULL;
+static size_t nr_knobs = 0;
+
+static unsigned long nr_corrections = 0;
+
+static int id_set_contains(const struct id_set_t *set, int id)
+{
+	size_t idx;
+
+	for (idx = 0; idx < set->nr; idx++)
+		if (set->ids[idx] == id)
+			return 1;
+
+	return 0;
+}
+
+static void id_set_add(struct id_set_t *set, int id)
+{
+	if (id_set_contains(set, id))
+		return;
+
+	if (set->nr == set->size) {
+		set->size = (set->size == 0) ? 64 : set->size * 2;
+		set->ids = checked_realloc(set->ids,
+					   set->size * sizeof(*set->ids));
+	}
+	set->ids[set->nr++] = id;
+}
+
+/* Log a correction to stdout, prefixed with wall clock time */
+static void log_correction(const char *format, ...)
+	__attribute__((format(printf, 1, 2)));
+
+static void log_correction(const char *format, ...)
+{
+	struct timespec now;
+	struct tm tm;
+	char timestr[32];
+	va_list va;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	localtime_r(&now.tv_sec, &tm);
+	strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &tm);
+	printf("%s.%03ld: ", timestr, now.tv_nsec / 1000000);
+
+	va_start(va, format);
+	vprintf(format, va);
+	va_end(va);
+
+	putchar('\n');
+	fflush(stdout);
+
+	nr_corrections++;
+}
+
+/*
+ * Tasks
+ */
+
+static void repair_task(pid_t tid)
+{
+	char path[PATH_MAX];
+	char value[16];
+	char comm[32];
+
+	if (id_set_contains(&unmovable_tasks, tid))
+		return;
+
+	snprintf(path, sizeof(path), "%s/%s/tasks", option_cpuset_root,
+		 option_partition);
+	snprintf(value, sizeof(value), "%d", (int) tid);
+
+	if (sysfs_write(path, value) == 0) {
+		sysfs_task_comm(tid, comm, sizeof(comm));
+		log_correction("Task %d (%s): Moved from root cpuset to %s",
+			       (int) tid, comm, option_partition);
+		return;
+	}
+
+	/* The task might already be gone */
+	if (errno == ESRCH)
+		return;
+
+	sysfs_task_comm(tid, comm, sizeof(comm));
+	info("Task %d (%s): Could not be moved to %s: %s", (int) tid, comm,
+	     option_partition, strerror(errno));
+	id_set_add(&unmovable_tasks, tid);
+}
+
+/* Called for each new task. New tasks inherit the cpuset of their parent,
+ * so this only finds children of tasks that are in the root cpuset. */
+static void handle_new_task(pid_t tid)
+{
+	char path[PATH_MAX];
+	char cpuset[PATH_MAX];
+
+	sysfs_path(path, sizeof(path), "/proc/%d/cpuset", (int) tid);
+	if (sysfs_read(path, cpuset, sizeof(cpuset)) == -1)
+		return;
+
+	if (strcmp(cpuset, "/") == 0)
+		repair_task(tid);
+}
+
+static void sweep_tasks(void)
+{
+	struct id_set_t still_unmovable = { NULL, 0, 0 };
+	char path[PATH_MAX];
+	FILE *stream;
+	size_t idx;
+	int tid;
+
+	snprintf(path, sizeof(path), "%s/tasks", option_cpuset_root);
+	stream = fopen(path, "r");
+	if (stream == NULL)
+		fail("%s: Could not open: %s", path, strerror(errno));
+
+	while (fscanf(stream, "%d", &tid) == 1) {
+		if (id_set_contains(&unmovable_tasks, tid))
+			id_set_add(&still_unmovable, tid);
+		else
+			repair_task(tid);
+	}
+	fclose(stream);
+
+	/* Forget tasks that have left the root cpuset, the TIDs might be
+	 * reused by tasks that can be moved. */
+	for (idx = 0; idx < unmovable_tasks.nr; idx++)
+		if (!id_set_contains(&still_unmovable, unmovable_tasks.ids[idx]))
+			debug("Task %d: No longer in root cpuset",
+			      unmovable_tasks.ids[idx]);
+	free(unmovable_tasks.ids);
+	unmovable_tasks = still_unmovable;
+}
+
+/*
+ * IRQs
+ */
+
+/* Set affinity of irq to the NRT CPUs if it includes any RT CPU.
+ * irq is -1 for the default affinity. */
+static void repair_irq(const char *file, int irq)
+{
+	char value[VALUE_SIZE];
+	struct bitmap_t *affinity;
+	struct bitmap_t *overlap;
+	size_t nr_rt_cpus;
+
+	if (id_set_contains(&unmovable_irqs, irq))
+		return;
+
+	if (sysfs_read(file, value, sizeof(value)) == -1)
+		return;
+
+	affinity = bitmap_alloc_from_u32_list(value);
+	overlap = bitmap_and(affinity, rt_mask);
+	nr_rt_cpus = bitmap_bit_count(overlap);
+	bitmap_free(affinity);
+	bitmap_free(overlap);
+
+	if (nr_rt_cpus == 0)
+		return;
+
+	if (sysfs_write(file, nrt_mask) == 0) {
+		if (irq == -1)
+			log_correction("Default IRQ affinity: %s included RT CPUs, set to %s",
+				       value, nrt_mask);
+		else
+			log_correction("IRQ %d: Affinity %s included RT CPUs, set to %s",
+				       irq, value, nrt_mask);
+	} else {
+		info("%s: Could not set affinity %s: %s", file, nrt_mask,
+		     strerror(errno));
+		id_set_add(&unmovable_irqs, irq);
+	}
+}
+
+static void sweep_irqs(void)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+
+	sysfs_path(path, sizeof(path), "/proc/irq/default_smp_affinity");
+	repair_irq(path, -1);
+
+	sysfs_path(path, sizeof(path), "/proc/irq");
+	dir = opendir(path);
+	if (dir == NULL)
+		fail("%s: Could not open: %s", path, strerror(errno));
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (!isdigit((unsigned char) entry->d_name[0]))
+			continue;
+		sysfs_path(path, sizeof(path), "/proc/irq/%s/smp_affinity",
+			   entry->d_name);
+		repair_irq(path, atoi(entry->d_name));
+	}
+
+	closedir(dir);
+}
+
+/*
+ * Knobs
+ */
+
+static void free_knobs(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_knobs; idx++) {
+		free(knobs[idx].file);
+		free(knobs[idx].value);
+	}
+	free(knobs);
+	knobs = NULL;
+	nr_knobs = 0;
+}
+
+/* The settings file holds "<file> <previous value>" for each knob partrt
+ * changed. The value the knob has right now is taken as the wanted one. */
+static void load_knobs(void)
+{
+	char *line = NULL;
+	size_t line_size = 0;
+	char value[VALUE_SIZE];
+	FILE *stream;
+
+	free_knobs();
+
+	stream = fopen(option_settings, "r");
+	if (stream == NULL) {
+		info("%s: Could not open, knobs are not watched: %s",
+		     option_settings, strerror(errno));
+		return;
+	}
+
+	if ((getline(&line, &line_size, stream) == -1) ||
+	    (strncmp(line, "partrt_settings:", 16) != 0)) {
+		info("%s: Not a partrt settings file, knobs are not watched",
+		     option_settings);
+		free(line);
+		fclose(stream);
+		return;
+	}
+
+	while (getline(&line, &line_size, stream) != -1) {
+		char *const file = strtok(line, " \t\n");
+
+		if ((file == NULL) || (sysfs_read(file, value, sizeof(value)) == -1))
+			continue;
+
+		knobs = checked_realloc(knobs, (nr_knobs + 1) * sizeof(*knobs));
+		knobs[nr_knobs].file = strdup(file);
+		knobs[nr_knobs].value = strdup(value);
+		if ((knobs[nr_knobs].file == NULL) ||
+		    (knobs[nr_knobs].value == NULL))
+			fail("Out of memory, aborting");
+		debug("%s: Watching, value '%s'", file, value);
+		nr_knobs++;
+	}
+
+	free(line);
+	fclose(stream);
+}
+
+static void sweep_knobs(void)
+{
+	char value[VALUE_SIZE];
+	size_t idx;
+
+	for (idx = 0; idx < nr_knobs; idx++) {
+		if ((sysfs_read(knobs[idx].file, value, sizeof(value)) == -1) ||
+		    (strcmp(value, knobs[idx].value) == 0))
+			continue;
+
+		if (sysfs_write(knobs[idx].file, knobs[idx].value) == 0)
+			log_correction("%s: Changed to '%s', restored '%s'",
+				       knobs[idx].file, value,
+				       knobs[idx].value);
+		else
+			info("%s: Could not restore '%s': %s",
+			     knobs[idx].file, knobs[idx].value,
+			     strerror(errno));
+	}
+}
+
+static void sweep(void)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", option_cpuset_root,
+		 option_partition);
+	if (access(path, F_OK) == -1) {
+		printf("%s: Partition removed, stopping\n", path);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (option_tasks)
+		sweep_tasks();
+	if (option_irqs)
+		sweep_irqs();
+	if (option_knobs)
+		sweep_knobs();
+}
+
+/*
+ * Event sources
+ */
+
+/* Subscribe to process events. Requires CAP_NET_ADMIN. */
+static int proc_connector_open(void)
+{
+	struct sockaddr_nl addr;
+	struct {
+		struct nlmsghdr header;
+		struct cn_msg msg;
+		enum proc_cn_mcast_op op;
+	} __attribute__((packed)) request;
+	const int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+				NETLINK_CONNECTOR);
+
+	if (sock == -1)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	addr.nl_pid = (__u32) getpid();
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	memset(&request, 0, sizeof(request));
+	request.header.nlmsg_len = sizeof(request);
+	request.header.nlmsg_type = NLMSG_DONE;
+	request.header.nlmsg_pid = (__u32) getpid();
+	request.msg.id.idx = CN_IDX_PROC;
+	request.msg.id.val = CN_VAL_PROC;
+	request.msg.len = sizeof(request.op);
+	request.op = PROC_CN_MCAST_LISTEN;
+	if (send(sock, &request, sizeof(request), 0) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+static void handle_proc_events(int sock)
+{
+	char buf[NETLINK_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	ssize_t status;
+	size_t offset;
+
+	status = recv(sock, buf, sizeof(buf), 0);
+	if (status == -1) {
+		/* Events were lost, find new tasks the slow way */
+		if (errno == ENOBUFS) {
+			info("Proc connector overrun, sweeping tasks");
+			sweep_tasks();
+			return;
+		}
+		fail("Proc connector: %s", strerror(errno));
+	}
+
+	/* NLMSG_OK()/NLMSG_NEXT() mix signed and unsigned, walk by hand */
+	for (offset = 0; offset + sizeof(struct nlmsghdr) <= (size_t) status;
+	     offset += NLMSG_ALIGN(((const struct nlmsghdr *) &buf[offset])->nlmsg_len)) {
+		const struct nlmsghdr *const header =
+			(const struct nlmsghdr *) &buf[offset];
+		const struct cn_msg *const msg = NLMSG_DATA(header);
+		const struct proc_event *const event =
+			(const struct proc_event *) msg->data;
+
+		if ((header->nlmsg_len < sizeof(*header)) ||
+		    (offset + header->nlmsg_len > (size_t) status))
+			break;
+		if ((header->nlmsg_type == NLMSG_ERROR) ||
+		    (header->nlmsg_type == NLMSG_NOOP))
+			continue;
+
+		if (event->what == PROC_EVENT_FORK)
+			handle_new_task(event->event_data.fork.child_pid);
+	}
+}
+
+/* Subscribe to kernel uevents, used for detecting new devices */
+static int uevent_open(void)
+{
+	struct sockaddr_nl addr;
+	const int sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+				NETLINK_KOBJECT_UEVENT);
+
+	if (sock == -1)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+static void handle_uevent(int sock)
+{
+	char buf[NETLINK_BUF_SIZE];
+	const ssize_t len = recv(sock, buf, sizeof(buf) - 1, 0);
+
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	/* A new device might come with new IRQs */
+	if ((strncmp(buf, "add@", 4) == 0) && option_irqs) {
+		debug("uevent: %s", buf);
+		sweep_irqs();
+	}
+}
+
+static int settings_watch_open(char **name)
+{
+	char *const dir_copy = strdup(option_settings);
+	char *const name_copy = strdup(option_settings);
+	const int fd = inotify_init1(IN_CLOEXEC);
+
+	if ((dir_copy == NULL) || (name_copy == NULL))
+		fail("Out of memory, aborting");
+
+	if ((fd == -1) ||
+	    (inotify_add_watch(fd, dirname(dir_copy),
+			       IN_CLOSE_WRITE | IN_MOVED_TO) == -1)) {
+		info("%s: Could not watch: %s", option_settings,
+		     strerror(errno));
+		if (fd != -1)
+			close(fd);
+		free(dir_copy);
+		free(name_copy);
+		return -1;
+	}
+
+	*name = strdup(basename(name_copy));
+	free(dir_copy);
+	free(name_copy);
+
+	return fd;
+}
+
+static void handle_settings_change(int fd, const char *name)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const ssize_t len = read(fd, buf, sizeof(buf));
+	const struct inotify_event *event;
+	ssize_t offset;
+
+	for (offset = 0; offset < len;
+	     offset += (ssize_t) (sizeof(*event) + event->len)) {
+		event = (const struct inotify_event *) &buf[offset];
+		if ((event->len > 0) && (strcmp(event->name, name) == 0)) {
+			info("%s: Changed, reloading knobs", option_settings);
+			load_knobs();
+		}
+	}
+}
+
+static void epoll_add(int epoll_fd, int fd)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+		fail("epoll_ctl(): %s", strerror(errno));
+}
+
+static int timer_open(void)
+{
+	struct itimerspec spec;
+	const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+	if (fd == -1)
+		fail("timerfd_create(): %s", strerror(errno));
+
+	spec.it_interval.tv_sec = (time_t) (option_period_ms / 1000);
+	spec.it_interval.tv_nsec = (long) (option_period_ms % 1000) * 1000000L;
+	spec.it_value = spec.it_interval;
+	if (timerfd_settime(fd, 0, &spec, NULL) == -1)
+		fail("timerfd_settime(): %s", strerror(errno));
+
+	return fd;
+}
+
+static void watch(void)
+{
+	struct epoll_event events[MAX_EVENTS];
+	const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	const int timer_fd = timer_open();
+	const int proc_fd = option_tasks ? proc_connector_open() : -1;
+	const int uevent_fd = option_irqs ? uevent_open() : -1;
+	char *settings_name = NULL;
+	const int settings_fd =
+		option_knobs ? settings_watch_open(&settings_name) : -1;
+
+	if (epoll_fd == -1)
+		fail("epoll_create1(): %s", strerror(errno));
+
+	epoll_add(epoll_fd, timer_fd);
+	if (proc_fd != -1)
+		epoll_add(epoll_fd, proc_fd);
+	else if (option_tasks)
+		info("Proc connector not available, new tasks are found by the periodic sweep");
+	if (uevent_fd != -1)
+		epoll_add(epoll_fd, uevent_fd);
+	if (settings_fd != -1)
+		epoll_add(epoll_fd, settings_fd);
+
+	for (;;) {
+		const int nr_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		int idx;
+
+		if (nr_events == -1) {
+			if (errno == EINTR)
+				continue;
+			fail("epoll_wait(): %s", strerror(errno));
+		}
+
+		for (idx = 0; idx < nr_events; idx++) {
+			const int fd = events[idx].data.fd;
+
+			if (fd == timer_fd) {
+				uint64_t expirations;
+
+				if (read(fd, &expirations, sizeof(expirations)) > 0)
+					sweep();
+			} else if (fd == proc_fd) {
+				handle_proc_events(fd);
+			} else if (fd == uevent_fd) {
+				handle_uevent(fd);
+			} else if (fd == settings_fd) {
+				handle_settings_change(fd, settings_name);
+			}
+		}
+	}
+}
+
+static void usage(void)
+{
+	puts("partrt-watch - Detect and repair affinity drift of a partition\n"
+	     "Usage:\n"
+	     "partrt-watch [options] <cpuset root> <partition> <rt mask> <nrt mask>\n"
+	     "\n"
+	     "Moves tasks that end up in the root cpuset into <partition>, sets the\n"
+	     "affinity of IRQs that include CPUs in <rt mask> to <nrt mask>, and\n"
+	     "restores knobs logged in the settings file. Every correction is logged\n"
+	     "to stdout. Normally started by 'partrt watch'.\n"
+	     "\n"
+	     "Options:\n"
+	     "-s, --settings=<file>   partrt settings file with knobs to watch.\n"
+	     "-p, --period=<ms>       Period of the full sweep. Default: 1000\n"
+	     "-t, --no-tasks          Do not move tasks.\n"
+	     "-i, --no-irqs           Do not change IRQ affinities.\n"
+	     "-k, --no-knobs          Do not restore knobs.\n"
+	     "-o, --once              Do a single sweep and exit.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n");
+}
+
+static void version(void)
+{
+	printf("partrt-watch %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       partrt_VERSION_MAJOR, partrt_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"settings", required_argument, NULL, 's'},
+		{"period", required_argument, NULL, 'p'},
+		{"no-tasks", no_argument, NULL, 't'},
+		{"no-irqs", no_argument, NULL, 'i'},
+		{"no-knobs", no_argument, NULL, 'k'},
+		{"once", no_argument, NULL, 'o'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVs:p:tiko";
+	char *check;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 's':
+			option_settings = optarg;
+			break;
+		case 'p':
+			option_period_ms = strtoul(optarg, &check, 0);
+			if ((*optarg == '\0') || (*check != '\0') ||
+			    (option_period_ms == 0))
+				fail("'%s': Not a valid period", optarg);
+			break;
+		case 't':
+			option_tasks = 0;
+			break;
+		case 'i':
+			option_irqs = 0;
+			break;
+		case 'k':
+			option_knobs = 0;
+			break;
+		case 'o':
+			option_once = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (argc - optind != 4)
+		fail("Expected <cpuset root> <partition> <rt mask> <nrt mask>");
+
+	option_cpuset_root = argv[optind];
+	option_partition = argv[optind + 1];
+	parse_scope = "RT mask";
+	rt_mask = bitmap_alloc_from_u32_list(argv[optind + 2]);
+	parse_scope = NULL;
+	nrt_mask = argv[optind + 3];
+
+	if (option_settings == NULL)
+		option_knobs = 0;
+	if (option_knobs)
+		load_knobs();
+
+	sweep();
+
+	if (!option_once)
+		watch();
+
+	info("%lu correction%s made", nr_corrections,
+	     (nr_corrections == 1) ? "" : "s");
+
+	free_knobs();
+	free(unmovable_tasks.ids);
+	free(unmovable_irqs.ids);
+	bitmap_free(rt_mask);
+
+	return 0;
+}
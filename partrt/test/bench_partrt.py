@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2014 by Enea Software AB
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of Enea Software AB nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+# OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Times partrt create, run, move and undo, and each phase of create and
+# undo, against fake trees made by fake_sysfs.py. No privileges are needed.
+# Results are written as an rtreport, one phase per size, so that runs can
+# be compared with rtcompare.
+
+import getopt
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import fake_sysfs
+
+# <cpus>,<tasks>,<irqs>,<workqueues>
+DEFAULT_SIZES = ["4,100,16,8", "64,1000,128,32", "256,5000,512,128"]
+DEFAULT_RUNS = 3
+
+
+def usage():
+    print("bench_partrt.py - Time partrt sub-commands on fake sysfs trees\n"
+          "Usage:\n"
+          "bench_partrt.py [options]\n"
+          "\n"
+          "Options:\n"
+          "-p, --partrt=<file>     partrt script to time. Default: ../partrt\n"
+          "-P, --path=<dirs>       Directories with bitcalc and the partrt helpers,\n"
+          "                        put first in PATH.\n"
+          "-s, --size=<c>,<t>,<i>,<w>\n"
+          "                        Time with <c> CPUs, <t> tasks, <i> IRQs and <w>\n"
+          "                        workqueues. Can be given multiple times.\n"
+          "                        Default: " + " ".join(DEFAULT_SIZES) + "\n"
+          "-n, --runs=<n>          Runs per size, the median is reported.\n"
+          "                        Default: " + str(DEFAULT_RUNS) + "\n"
+          "-r, --report=<file>     Write an rtreport to <file>, '-' for stdout.\n"
+          "-d, --dir=<dir>         Build the fake trees in <dir>.\n"
+          "-h, --help              Print this help text and exit.")
+
+
+# Run a partrt sub-command, and return its time and the time of each of its
+# phases, all in ns
+def time_command(partrt, root, env, command, args):
+    phase_log = os.path.join(root, "phases")
+    if os.path.exists(phase_log):
+        os.remove(phase_log)
+    env = dict(env, PARTRT_SYSROOT=root, PARTRT_PHASE_LOG=phase_log)
+
+    start = time.time_ns()
+    result = subprocess.run([partrt, command] + args, env=env,
+                            stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                            universal_newlines=True)
+    end = time.time_ns()
+    if result.returncode != 0:
+        raise RuntimeError("partrt %s %s: %s" % (command, " ".join(args),
+                                                 result.stderr.strip()))
+
+    times = {command + ".total_ns": end - start}
+    stamps = []
+    if os.path.exists(phase_log):
+        with open(phase_log) as f:
+            stamps = [(name, int(stamp)) for name, stamp in
+                      (line.split() for line in f)]
+    if stamps:
+        times[command + ".setup_ns"] = stamps[0][1] - start
+    for (name, stamp), (_, next_stamp) in zip(stamps, stamps[1:]):
+        times["%s.%s_ns" % (command, name)] = next_stamp - stamp
+
+    return times
+
+
+# Build a fresh tree, as undo on a fake tree does not bring back the tasks
+# of the root cpuset, and time all sub-commands on it
+def time_run(partrt, root, env, cpus, tasks, irqs, workqueues):
+    _, pids = fake_sysfs.make_tree(root, cpus, tasks, irqs, workqueues)
+    rt_mask = "%x" % (1 << (cpus - 1))
+    settings = os.path.join(root, "tmp", "partrt_env")
+    times = {}
+
+    times.update(time_command(partrt, root, env, "create", [rt_mask]))
+    times.update(time_command(partrt, root, env, "run", ["rt", "true"]))
+    times.update(time_command(partrt, root, env, "move",
+                              [str(pids[-1]), "rt"]))
+    times.update(time_command(partrt, root, env, "undo", ["-s", settings]))
+
+    return times
+
+
+def parse_size(text):
+    try:
+        size = [int(value) for value in text.split(",")]
+    except ValueError:
+        size = []
+    if (len(size) != 4) or (min(size) < 0) or (size[0] < 2) or (size[1] < 4):
+        raise ValueError("'%s': Expected <cpus>,<tasks>,<irqs>,<workqueues>, "
+                         "at least 2 CPUs and 4 tasks" % text)
+    return size
+
+
+def main(argv):
+    partrt = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          "..", "partrt")
+    path = None
+    sizes = []
+    runs = DEFAULT_RUNS
+    report_path = None
+    work_dir = None
+
+    try:
+        opts, args = getopt.getopt(argv, "p:P:s:n:r:d:h",
+                                   ["partrt=", "path=", "size=", "runs=",
+                                    "report=", "dir=", "help"])
+        for opt, arg in opts:
+            if opt in ("-h", "--help"):
+                usage()
+                return 0
+            elif opt in ("-p", "--partrt"):
+                partrt = arg
+            elif opt in ("-P", "--path"):
+                path = arg
+            elif opt in ("-s", "--size"):
+                sizes.append(parse_size(arg))
+            elif opt in ("-n", "--runs"):
+                if not arg.isdigit() or int(arg) == 0:
+                    raise ValueError("'%s': Not a valid number of runs" % arg)
+                runs = int(arg)
+            elif opt in ("-r", "--report"):
+                report_path = arg
+            elif opt in ("-d", "--dir"):
+                work_dir = arg
+        if args:
+            raise ValueError("Unexpected argument: " + args[0])
+    except (getopt.GetoptError, ValueError) as err:
+        print("bench_partrt.py: " + str(err), file=sys.stderr)
+        return 1
+
+    if not sizes:
+        sizes = [parse_size(size) for size in DEFAULT_SIZES]
+
+    env = dict(os.environ)
+    if path is not None:
+        env["PATH"] = path + os.pathsep + env.get("PATH", "")
+
+    results = []
+    with tempfile.TemporaryDirectory(dir=work_dir) as tmp_dir:
+        root = os.path.join(tmp_dir, "sysroot")
+        for cpus, tasks, irqs, workqueues in sizes:
+            label = "c%d_t%d_i%d_w%d" % (cpus, tasks, irqs, workqueues)
+            samples = {}
+            try:
+                for _ in range(runs):
+                    times = time_run(partrt, root, env, cpus, tasks, irqs,
+                                     workqueues)
+                    for metric, value in times.items():
+                        samples.setdefault(metric, []).append(value)
+            except (OSError, RuntimeError) as err:
+                print("bench_partrt.py: %s: %s" % (label, err), file=sys.stderr)
+                return 1
+            results.append((label, {metric: int(statistics.median(values))
+                                    for metric, values in samples.items()}))
+
+    print("%-28s %-24s %12s" % ("Size", "Metric", "Median us"))
+    for label, medians in results:
+        for metric in sorted(medians):
+            print("%-28s %-24s %12d" % (label, metric, medians[metric] // 1000))
+
+    if report_path is not None:
+        report = sys.stdout if report_path == "-" else open(report_path, "w")
+        report.write("# rtreport 1 partrt-bench\n")
+        for label, medians in results:
+            for metric in sorted(medians):
+                report.write("%s all %s %d\n" % (label, metric, medians[metric]))
+        if report is not sys.stdout:
+            report.close()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2014 by Enea Software AB
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of Enea Software AB nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+# OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Builds a fake sysfs, procfs and cgroupfs tree for running partrt without
+# privileges. Point partrt and its helpers at it with PARTRT_SYSROOT=<root>.
+#
+# The tree has the files partrt and its helpers read and write on a real
+# system, with <cpus> CPUs on one NUMA node, <tasks> tasks of which a
+# quarter are kernel threads, <irqs> IRQs, <workqueues> workqueues in sysfs
+# and an eth0 with a queue pair per CPU, up to 8.
+
+import getopt
+import os
+import shutil
+import sys
+
+MARKER = ".fake_sysfs"
+PF_KTHREAD = 0x00200000
+KTHREAD_NAMES = ["kworker/%d:1", "ksoftirqd/%d", "migration/%d",
+                 "rcuc/%d", "cpuhp/%d", "kworker/u%d:2", "rcuop/%d",
+                 "kswapd%d"]
+USER_NAMES = ["systemd", "sshd", "bash", "rtapp", "logger", "dbus-daemon"]
+
+
+def usage():
+    print("fake_sysfs.py - Build a fake sysfs and procfs tree for partrt\n"
+          "Usage:\n"
+          "fake_sysfs.py [options] <root>\n"
+          "\n"
+          "Options:\n"
+          "-c, --cpus=<n>          Number of CPUs. Default: 4\n"
+          "-t, --tasks=<n>         Number of tasks, threads included. Default: 100\n"
+          "-i, --irqs=<n>          Number of IRQs. Default: 16\n"
+          "-w, --workqueues=<n>    Number of workqueues in sysfs. Default: 8\n"
+          "-h, --help              Print this help text and exit.")
+
+
+def write(root, path, value):
+    path = os.path.join(root, path)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as f:
+        f.write(str(value) + "\n")
+
+
+# Kernel format of a cpumask, 32 bit groups separated by commas
+def cpumask(cpus):
+    mask = (1 << cpus) - 1
+    groups = []
+    while True:
+        groups.append(mask & 0xffffffff)
+        mask >>= 32
+        if mask == 0:
+            break
+    return ",".join(["%x" % groups[-1]] +
+                    ["%08x" % group for group in reversed(groups[:-1])])
+
+
+# /proc/<pid>/stat, with the fields the helpers read: flags (9),
+# processor (39), rt_priority (40) and policy (41)
+def stat(tid, comm, flags, cpu, rt_priority, policy):
+    fields = ["0"] * 52
+    fields[0] = str(tid)
+    fields[1] = "(%s)" % comm
+    fields[2] = "S"
+    fields[3] = "1"
+    fields[8] = str(flags)
+    fields[38] = str(cpu)
+    fields[39] = str(rt_priority)
+    fields[40] = str(policy)
+    return " ".join(fields)
+
+
+# /proc/<tid>/sched, with the lines partrt-top reads
+def sched(tid, comm, threads, rt_priority, policy):
+    prio = 99 - rt_priority if policy else 120
+    lines = ["%s (%d, #threads: %d)" % (comm, tid, threads), "-" * 67]
+    for key, value in [("se.nr_migrations", 0), ("nr_switches", 0),
+                       ("nr_voluntary_switches", 0),
+                       ("nr_involuntary_switches", 0),
+                       ("policy", policy), ("prio", prio)]:
+        lines.append("%-45s:%21d" % (key, value))
+    return "\n".join(lines)
+
+
+def make_cpus(root, cpus):
+    cpu_list = "0-%d" % (cpus - 1) if cpus > 1 else "0"
+    cpu_dir = "sys/devices/system/cpu"
+
+    for name in ["present", "possible", "online"]:
+        write(root, os.path.join(cpu_dir, name), cpu_list)
+    write(root, os.path.join(cpu_dir, "isolated"), "")
+    write(root, os.path.join(cpu_dir, "nohz_full"), "(null)")
+    for cpu in range(cpus):
+        write(root, "%s/cpu%d/online" % (cpu_dir, cpu), 1)
+        write(root, "%s/cpu%d/topology/physical_package_id" % (cpu_dir, cpu), 0)
+        write(root, "%s/cpu%d/topology/core_id" % (cpu_dir, cpu), cpu // 2)
+
+    write(root, "sys/devices/system/node/possible", 0)
+    write(root, "sys/devices/system/node/node0/cpulist", cpu_list)
+    return cpu_list
+
+
+def make_cpuset(root, cpu_list, tids, pids):
+    cpuset = "sys/fs/cgroup/cpuset"
+
+    write(root, "proc/filesystems", "nodev\tcgroup\nnodev\tcpuset")
+    for name, value in [("cpus", cpu_list), ("mems", 0),
+                        ("cpu_exclusive", 1), ("mem_exclusive", 1),
+                        ("memory_migrate", 0), ("sched_load_balance", 1)]:
+        write(root, "%s/cpuset.%s" % (cpuset, name), value)
+    write(root, cpuset + "/tasks", "\n".join(str(tid) for tid in tids))
+    write(root, cpuset + "/cgroup.procs", "\n".join(str(pid) for pid in pids))
+
+
+# Kernel threads are single threaded and come first, the remaining tasks
+# are spread over user processes of one to four threads
+def make_tasks(root, cpus, tasks):
+    kthreads = tasks // 4
+    tids = []
+    pids = []
+    tid = 2
+    mask = cpumask(cpus)
+    cpu_list = "0-%d" % (cpus - 1) if cpus > 1 else "0"
+
+    while len(tids) < tasks:
+        kthread = len(tids) < kthreads
+        cpu = len(tids) % cpus
+        if kthread:
+            comm = KTHREAD_NAMES[len(tids) % len(KTHREAD_NAMES)] % cpu
+            threads = 1
+            flags = PF_KTHREAD
+        else:
+            comm = USER_NAMES[len(pids) % len(USER_NAMES)]
+            threads = min(1 + len(pids) % 4, tasks - len(tids))
+            flags = 0
+        rt_priority = 99 if comm.startswith("migration") else 0
+        policy = 1 if rt_priority else 0
+
+        pid = tid
+        proc = "proc/%d" % pid
+        status = "Name:\t%s\nTgid:\t%d\nCpus_allowed:\t%s\nCpus_allowed_list:\t%s" % (
+            comm, pid, mask, cpu_list)
+        write(root, proc + "/comm", comm)
+        write(root, proc + "/status", status)
+        write(root, proc + "/cpuset", "/")
+        write(root, proc + "/stat", stat(pid, comm, flags, cpu, rt_priority, policy))
+        for thread in range(threads):
+            task = "%s/task/%d" % (proc, tid)
+            write(root, task + "/comm", comm)
+            write(root, task + "/stat", stat(tid, comm, flags, cpu, rt_priority, policy))
+            if thread > 0:
+                write(root, "proc/%d/status" % tid, status)
+            write(root, "proc/%d/sched" % tid,
+                  sched(tid, comm, threads, rt_priority, policy))
+            write(root, "proc/%d/schedstat" % tid, "0 0 0")
+            tids.append(tid)
+            tid += 1
+        pids.append(pid)
+
+    return tids, pids
+
+
+def make_irqs(root, cpus, irqs):
+    mask = cpumask(cpus)
+    cpu_list = "0-%d" % (cpus - 1) if cpus > 1 else "0"
+
+    write(root, "proc/irq/default_smp_affinity", mask)
+    for irq in range(irqs):
+        irq_dir = "proc/irq/%d" % irq
+        write(root, irq_dir + "/smp_affinity", mask)
+        write(root, irq_dir + "/smp_affinity_list", cpu_list)
+        write(root, irq_dir + "/effective_affinity_list", irq % cpus)
+        os.makedirs(os.path.join(root, irq_dir, "dev%d" % irq), exist_ok=True)
+
+
+def make_workqueues(root, cpus, workqueues):
+    mask = cpumask(cpus)
+    wq_dir = "sys/bus/workqueue/devices"
+
+    write(root, wq_dir + "/writeback/cpumask", mask)
+    write(root, wq_dir + "/writeback/numa", 1)
+    for wq in range(1, workqueues):
+        write(root, "%s/wq%d/cpumask" % (wq_dir, wq), mask)
+    write(root, "sys/devices/virtual/workqueue/cpumask", mask)
+
+
+def make_knobs(root, cpus):
+    for path, value in [("proc/sys/kernel/sched_rt_runtime_us", 950000),
+                        ("proc/sys/kernel/watchdog", 1),
+                        ("proc/sys/vm/stat_interval", 1),
+                        ("proc/sys/net/core/rps_sock_flow_entries", 0),
+                        ("sys/kernel/debug/sched_tick_max_deferment", 100),
+                        ("sys/devices/system/machinecheck/machinecheck0/check_interval", 300)]:
+        write(root, path, value)
+
+    for queue in range(min(cpus, 8)):
+        write(root, "sys/class/net/eth0/queues/rx-%d/rps_cpus" % queue, 0)
+        write(root, "sys/class/net/eth0/queues/rx-%d/rps_flow_cnt" % queue, 0)
+        write(root, "sys/class/net/eth0/queues/tx-%d/xps_cpus" % queue, 0)
+
+
+def make_tree(root, cpus, tasks, irqs, workqueues):
+    if os.path.exists(root):
+        if os.listdir(root) and not os.path.exists(os.path.join(root, MARKER)):
+            raise ValueError("%s: Not empty, and not made by fake_sysfs.py" % root)
+        shutil.rmtree(root)
+
+    os.makedirs(os.path.join(root, "tmp"))
+    write(root, MARKER, "%d %d %d %d" % (cpus, tasks, irqs, workqueues))
+
+    cpu_list = make_cpus(root, cpus)
+    tids, pids = make_tasks(root, cpus, tasks)
+    make_cpuset(root, cpu_list, tids, pids)
+    make_irqs(root, cpus, irqs)
+    make_workqueues(root, cpus, workqueues)
+    make_knobs(root, cpus)
+
+    return tids, pids
+
+
+def main(argv):
+    sizes = {"cpus": 4, "tasks": 100, "irqs": 16, "workqueues": 8}
+
+    try:
+        opts, args = getopt.getopt(argv, "c:t:i:w:h",
+                                   ["cpus=", "tasks=", "irqs=", "workqueues=", "help"])
+    except getopt.GetoptError as err:
+        print("fake_sysfs.py: " + str(err), file=sys.stderr)
+        return 1
+
+    for opt, arg in opts:
+        if opt in ("-h", "--help"):
+            usage()
+            return 0
+        for name in sizes:
+            if opt in ("-" + name[0], "--" + name):
+                if not arg.isdigit() or (int(arg) == 0 and name in ("cpus", "tasks")):
+                    print("fake_sysfs.py: '%s': Not a valid number of %s" % (arg, name),
+                          file=sys.stderr)
+                    return 1
+                sizes[name] = int(arg)
+
+    if len(args) != 1:
+        print("fake_sysfs.py: Expected <root>", file=sys.stderr)
+        return 1
+
+    try:
+        make_tree(args[0], sizes["cpus"], sizes["tasks"], sizes["irqs"],
+                  sizes["workqueues"])
+    except (OSError, ValueError) as err:
+        print("fake_sysfs.py: " + str(err), file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements fixed bucket width latency histograms.
+ */
+
+#include "common.h"
+#include "histogram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+void histogram_init(struct histogram_t *hist, uint64_t bucket_ns,
+		    size_t nr_buckets)
+{
+	assert(bucket_ns > 0);
+
+	hist->bucket_ns = bucket_ns;
+	hist->nr_buckets = nr_buckets;
+	/* checked_malloc() zeroes the memory, which also pre-faults it */
+	hist->buckets = checked_malloc(nr_buckets * sizeof(*hist->buckets));
+	hist->overflow = 0;
+	hist->samples = 0;
+	hist->min_ns = UINT64_MAX;
+	hist->max_ns = 0;
+	hist->sum_ns = 0;
+}
+
+void histogram_destroy(struct histogram_t *hist)
+{
+	free(hist->buckets);
+	hist->buckets = NULL;
+	hist->nr_buckets = 0;
+}
+
+void histogram_merge(struct histogram_t *dst, const struct histogram_t *src)
+{
+	size_t idx;
+
+	assert(dst->bucket_ns == src->bucket_ns);
+	assert(dst->nr_buckets == src->nr_buckets);
+
+	for (idx = 0; idx < src->nr_buckets; idx++)
+		dst->buckets[idx] += src->buckets[idx];
+
+	dst->overflow += src->overflow;
+	dst->samples += src->samples;
+	dst->sum_ns += src->sum_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+	if (src->min_ns < dst->min_ns)
+		dst->min_ns = src->min_ns;
+}
+
+uint64_t histogram_percentile(const struct histogram_t *hist, double fraction)
+{
+	uint64_t wanted;
+	uint64_t seen = 0;
+	size_t idx;
+
+	if (hist->samples == 0)
+		return 0;
+
+	wanted = (uint64_t) (fraction * (double) hist->samples);
+	if (wanted == 0)
+		wanted = 1;
+
+	for (idx = 0; idx < hist->nr_buckets; idx++) {
+		seen += hist->buckets[idx];
+		if (seen >= wanted) {
+			const uint64_t upper = (idx + 1) * hist->bucket_ns;
+
+			return (upper < hist->max_ns) ? upper : hist->max_ns;
+		}
+	}
+
+	return hist->max_ns;
+}
+
+uint64_t histogram_avg(const struct histogram_t *hist)
+{
+	if (hist->samples == 0)
+		return 0;
+
+	return hist->sum_ns / hist->samples;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Latency histogram with fixed width buckets. Samples larger than the last
+ * bucket are counted as overflow, but still contribute to max and sum.
+ */
+struct histogram_t {
+	/* Width of each bucket in nanoseconds */
+	uint64_t bucket_ns;
+
+	/* Number of buckets in buckets[] */
+	size_t nr_buckets;
+
+	/* The malloc'ed buckets */
+	uint64_t *buckets;
+
+	/* Samples that did not fit into any bucket */
+	uint64_t overflow;
+
+	uint64_t samples;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t sum_ns;
+};
+
+/* Allocate bucket memory and reset all counters. The bucket memory is
+ * written to, so it is faulted in when this function returns. */
+extern void histogram_init(struct histogram_t *hist, uint64_t bucket_ns,
+			   size_t nr_buckets);
+
+extern void histogram_destroy(struct histogram_t *hist);
+
+/* Add one sample. Called from the measurement loops, so keep it short. */
+static inline void histogram_add(struct histogram_t *hist, uint64_t ns)
+{
+	const uint64_t idx = ns / hist->bucket_ns;
+
+	if (idx < hist->nr_buckets)
+		hist->buckets[idx]++;
+	else
+		hist->overflow++;
+
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+	if (ns < hist->min_ns)
+		hist->min_ns = ns;
+	hist->sum_ns += ns;
+	hist->samples++;
+}
+
+/* Add all samples in src to dst. Both must have the same bucket layout. */
+extern void histogram_merge(struct histogram_t *dst,
+			    const struct histogram_t *src);
+
+/* Return the upper bound in nanoseconds of the bucket containing the given
+ * fraction (0.0 - 1.0) of all samples. If the fraction ends up among the
+ * overflow samples, the max value is returned. */
+extern uint64_t histogram_percentile(const struct histogram_t *hist,
+				     double fraction);
+
+/* Return the average sample value, 0 if there are no samples. */
+extern uint64_t histogram_avg(const struct histogram_t *hist);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements reading of interrupt and SMI counters.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "irqstat.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSR_SMI_COUNT 0x34
+
+int irqstat_read(uint64_t *counts, int nr_cpus)
+{
+	FILE *stream = fopen("/proc/interrupts", "r");
+	char *line = NULL;
+	size_t line_size = 0;
+	int *column_cpu;
+	int nr_columns = 0;
+	char *curr;
+	char *end;
+
+	memset(counts, 0, (size_t) nr_cpus * sizeof(*counts));
+
+	if (stream == NULL) {
+		info("/proc/interrupts: Could not open: %s", strerror(errno));
+		return -1;
+	}
+
+	/* Header line, "CPU0 CPU2 ..." with offline CPUs left out */
+	if (getline(&line, &line_size, stream) == -1) {
+		fclose(stream);
+		free(line);
+		return -1;
+	}
+
+	column_cpu = checked_malloc(((size_t) nr_cpus + 1) * sizeof(*column_cpu));
+	for (curr = strstr(line, "CPU"); (curr != NULL) && (nr_columns < nr_cpus);
+	     curr = strstr(curr, "CPU")) {
+		curr += 3;
+		column_cpu[nr_columns++] = (int) strtol(curr, NULL, 10);
+	}
+
+	while (getline(&line, &line_size, stream) != -1) {
+		int column;
+
+		curr = strchr(line, ':');
+		if (curr == NULL)
+			continue;
+		curr++;
+
+		for (column = 0; column < nr_columns; column++) {
+			const unsigned long long val = strtoull(curr, &end, 10);
+
+			if (end == curr)
+				break;
+			curr = end;
+			if (column_cpu[column] < nr_cpus)
+				counts[column_cpu[column]] += val;
+		}
+	}
+
+	free(column_cpu);
+	free(line);
+	fclose(stream);
+
+	return 0;
+}
+
+int irqstat_read_smi(int cpu, uint64_t *count)
+{
+	char path[64];
+	int fd;
+	ssize_t status;
+
+	snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu);
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		debug("%s: Could not open: %s", path, strerror(errno));
+		return -1;
+	}
+
+	status = pread(fd, count, sizeof(*count), MSR_SMI_COUNT);
+	close(fd);
+
+	if (status != sizeof(*count)) {
+		debug("%s: MSR_SMI_COUNT not readable", path);
+		return -1;
+	}
+
+	return 0;
+}
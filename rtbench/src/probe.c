@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements placement and memory setup of measurement threads.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "probe.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int probe_nr_cpus(void)
+{
+	const long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	if (nr_cpus < 1)
+		fail("Could not determine number of CPUs: %s", strerror(errno));
+
+	return (int) nr_cpus;
+}
+
+void probe_lock_memory(void)
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+		fail("mlockall(): %s", strerror(errno));
+
+	/* Never trim the heap, and never use mmap() for malloc(), so freed
+	 * memory stays locked and faulted in. */
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+}
+
+void probe_prefault_stack(void)
+{
+	volatile char stack[PROBE_PREFAULT_SIZE];
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(stack); idx++)
+		stack[idx] = 0;
+}
+
+void probe_place_in_cpuset(const char *cpuset)
+{
+	char path[256];
+	FILE *tasks;
+
+	snprintf(path, sizeof(path), "%s/%s/tasks", DEFAULT_CPUSET_ROOT,
+		 cpuset);
+
+	tasks = fopen(path, "w");
+	if (tasks == NULL)
+		fail("%s: Error opening for writing: %s", path,
+		     strerror(errno));
+
+	fprintf(tasks, "%ld\n", (long) syscall(SYS_gettid));
+
+	if (fclose(tasks) == EOF)
+		fail("%s: Could not move thread into cpuset: %s", path,
+		     strerror(errno));
+}
+
+void probe_pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+	int status;
+
+	CPU_ZERO(&set);
+	CPU_SET((size_t) cpu, &set);
+
+	status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (status != 0)
+		fail("CPU %d: Could not set affinity: %s", cpu,
+		     strerror(status));
+}
+
+void probe_set_fifo(int prio)
+{
+	struct sched_param param;
+	int status;
+
+	if (prio == 0)
+		return;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = prio;
+
+	status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (status != 0)
+		fail("Could not set SCHED_FIFO priority %d: %s", prio,
+		     strerror(status));
+}
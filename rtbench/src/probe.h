@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Helpers for setting up measurement threads: placement, scheduling policy
+ * and memory locking.
+ */
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_USEC 1000ULL
+
+#define DEFAULT_CPUSET_ROOT "/sys/fs/cgroup/cpuset"
+
+/* Stack size for measurement threads, and how much of it to pre-fault */
+#define PROBE_STACK_SIZE (256 * 1024)
+#define PROBE_PREFAULT_SIZE (64 * 1024)
+
+static inline uint64_t probe_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+}
+
+static inline void probe_ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = (time_t) (ns / NSEC_PER_SEC);
+	ts->tv_nsec = (long) (ns % NSEC_PER_SEC);
+}
+
+/* Number of configured CPUs, i.e. the highest CPU number plus one */
+extern int probe_nr_cpus(void);
+
+/* Lock all current and future memory, and keep glibc from giving heap
+ * memory back to the kernel. */
+extern void probe_lock_memory(void);
+
+/* Touch PROBE_PREFAULT_SIZE bytes of the calling thread's stack */
+extern void probe_prefault_stack(void);
+
+/* Move calling thread into cpuset <DEFAULT_CPUSET_ROOT>/<cpuset> */
+extern void probe_place_in_cpuset(const char *cpuset);
+
+/* Restrict calling thread to run on cpu only */
+extern void probe_pin_to_cpu(int cpu);
+
+/* Set SCHED_FIFO with priority prio for calling thread. Priority 0 means
+ * SCHED_OTHER, which is left untouched. */
+extern void probe_set_fifo(int prio);
+
+#endif
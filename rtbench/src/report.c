@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements the writer and reader sides of the rtreport format.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "histogram.h"
+#include "report.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct {
+	const char *name;
+	double fraction;
+} report_percentiles[] = {
+	{ "p50_ns", 0.5 },
+	{ "p99_ns", 0.99 },
+	{ "p99.9_ns", 0.999 },
+	{ "p99.99_ns", 0.9999 },
+};
+
+FILE *report_open(const char *path, const char *tool)
+{
+	FILE *report;
+
+	if (strcmp(path, "-") == 0) {
+		report = stdout;
+	} else {
+		report = fopen(path, "w");
+		if (report == NULL)
+			fail("%s: Error opening report for writing: %s",
+			     path, strerror(errno));
+	}
+
+	fprintf(report, "# rtreport %d %s\n", REPORT_VERSION, tool);
+
+	return report;
+}
+
+void report_close(FILE *report)
+{
+	if (report == stdout) {
+		fflush(report);
+		return;
+	}
+
+	if (fclose(report) == EOF)
+		fail("Error closing report: %s", strerror(errno));
+}
+
+static void report_scope(FILE *report, const char *phase, int cpu)
+{
+	if (cpu == REPORT_ALL_CPUS)
+		fprintf(report, "%s all ", phase);
+	else
+		fprintf(report, "%s %d ", phase, cpu);
+}
+
+void report_value(FILE *report, const char *phase, int cpu,
+		  const char *metric, uint64_t value)
+{
+	report_scope(report, phase, cpu);
+	fprintf(report, "%s %llu\n", metric, (unsigned long long) value);
+}
+
+void report_histogram(FILE *report, const char *phase, int cpu,
+		      const char *prefix, const struct histogram_t *hist)
+{
+	char metric[64];
+	size_t idx;
+
+#define REPORT_HIST_VALUE(name, value) \
+	do { \
+		snprintf(metric, sizeof(metric), "%s.%s", prefix, name); \
+		report_value(report, phase, cpu, metric, value); \
+	} while (0)
+
+	REPORT_HIST_VALUE("samples", hist->samples);
+	REPORT_HIST_VALUE("min_ns", (hist->samples > 0) ? hist->min_ns : 0);
+	REPORT_HIST_VALUE("avg_ns", histogram_avg(hist));
+	REPORT_HIST_VALUE("max_ns", hist->max_ns);
+	for (idx = 0; idx < sizeof(report_percentiles) / sizeof(report_percentiles[0]); idx++)
+		REPORT_HIST_VALUE(report_percentiles[idx].name,
+				  histogram_percentile(hist, report_percentiles[idx].fraction));
+	REPORT_HIST_VALUE("overflow", hist->overflow);
+
+#undef REPORT_HIST_VALUE
+
+	/* Sparse histogram: "<bucket width> <index>:<count>..." */
+	report_scope(report, phase, cpu);
+	fprintf(report, "%s.hist %llu", prefix,
+		(unsigned long long) hist->bucket_ns);
+	for (idx = 0; idx < hist->nr_buckets; idx++)
+		if (hist->buckets[idx] != 0)
+			fprintf(report, " %zu:%llu", idx,
+				(unsigned long long) hist->buckets[idx]);
+	fputc('\n', report);
+}
+
+/*
+ * Reader side
+ */
+
+/* Bucket records with more buckets than this are rejected */
+#define REPORT_MAX_BUCKETS (16 * 1024 * 1024)
+
+static char *report_strdup(const char *str)
+{
+	const size_t size = strlen(str) + 1;
+	char *const copy = checked_malloc(size);
+
+	memcpy(copy, str, size);
+
+	return copy;
+}
+
+static int report_parse_cpu(const char *token, int *cpu)
+{
+	char *end;
+	long val;
+
+	if (strcmp(token, "all") == 0) {
+		*cpu = REPORT_ALL_CPUS;
+		return 0;
+	}
+
+	errno = 0;
+	val = strtol(token, &end, 10);
+	if ((token[0] == '\0') || (end[0] != '\0') || (errno != 0) ||
+	    (val < 0) || (val > 65535))
+		return -1;
+	*cpu = (int) val;
+
+	return 0;
+}
+
+static int report_parse_u64(const char *token, uint64_t *value)
+{
+	char *end;
+	unsigned long long val;
+
+	if ((token[0] < '0') || (token[0] > '9'))
+		return -1;
+
+	errno = 0;
+	val = strtoull(token, &end, 10);
+	if ((end[0] != '\0') || (errno != 0))
+		return -1;
+	*value = (uint64_t) val;
+
+	return 0;
+}
+
+/* Parse "<bucket width> <index>:<count>..." into a new histogram */
+static struct histogram_t *report_parse_hist(char *save)
+{
+	struct histogram_t *hist;
+	uint64_t bucket_ns;
+	uint64_t *indexes = NULL;
+	uint64_t *counts = NULL;
+	size_t nr_entries = 0;
+	size_t nr_buckets = 0;
+	size_t idx;
+	char *token;
+
+	token = strtok_r(NULL, " \t\n", &save);
+	if ((token == NULL) || (report_parse_u64(token, &bucket_ns) == -1) ||
+	    (bucket_ns == 0))
+		return NULL;
+
+	while ((token = strtok_r(NULL, " \t\n", &save)) != NULL) {
+		char *const colon = strchr(token, ':');
+		uint64_t index;
+		uint64_t count;
+
+		if (colon == NULL)
+			goto error;
+		*colon = '\0';
+		if ((report_parse_u64(token, &index) == -1) ||
+		    (report_parse_u64(colon + 1, &count) == -1) ||
+		    (index >= REPORT_MAX_BUCKETS))
+			goto error;
+
+		indexes = checked_realloc(indexes,
+					  (nr_entries + 1) * sizeof(*indexes));
+		counts = checked_realloc(counts,
+					 (nr_entries + 1) * sizeof(*counts));
+		indexes[nr_entries] = index;
+		counts[nr_entries] = count;
+		nr_entries++;
+		if (index + 1 > nr_buckets)
+			nr_buckets = (size_t) index + 1;
+	}
+
+	hist = checked_malloc(sizeof(*hist));
+	histogram_init(hist, bucket_ns, (nr_buckets > 0) ? nr_buckets : 1);
+	for (idx = 0; idx < nr_entries; idx++) {
+		hist->buckets[indexes[idx]] += counts[idx];
+		hist->samples += counts[idx];
+	}
+	free(indexes);
+	free(counts);
+
+	return hist;
+
+error:
+	free(indexes);
+	free(counts);
+
+	return NULL;
+}
+
+/* Fill in what the bucket record does not tell from the summary records */
+static void report_complete_hist(const struct report_t *report,
+				 struct report_hist_t *entry)
+{
+	struct histogram_t *const hist = entry->hist;
+	const struct report_value_t *value;
+	char metric[128];
+
+#define REPORT_HIST_LOOKUP(name) \
+	(snprintf(metric, sizeof(metric), "%s.%s", entry->prefix, name), \
+	 report_find_value(report, entry->phase, entry->cpu, metric))
+
+	value = REPORT_HIST_LOOKUP("overflow");
+	if (value != NULL) {
+		hist->overflow = value->value;
+		hist->samples += value->value;
+	}
+	value = REPORT_HIST_LOOKUP("max_ns");
+	if (value != NULL)
+		hist->max_ns = value->value;
+	value = REPORT_HIST_LOOKUP("min_ns");
+	if (value != NULL)
+		hist->min_ns = value->value;
+	value = REPORT_HIST_LOOKUP("avg_ns");
+	if (value != NULL)
+		hist->sum_ns = value->value * hist->samples;
+
+#undef REPORT_HIST_LOOKUP
+}
+
+struct report_t *report_load(const char *path)
+{
+	struct report_t *report;
+	FILE *stream;
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t line_nr = 0;
+	size_t idx;
+
+	if (strcmp(path, "-") == 0) {
+		stream = stdin;
+	} else {
+		stream = fopen(path, "r");
+		if (stream == NULL)
+			fail("%s: Error opening report for reading: %s",
+			     path, strerror(errno));
+	}
+
+	report = checked_malloc(sizeof(*report));
+	report->path = report_strdup(path);
+
+	while (getline(&line, &line_size, stream) != -1) {
+		char *save;
+		char *phase;
+		char *cpu_token;
+		char *metric;
+		char *token;
+		size_t len;
+		int cpu;
+
+		line_nr++;
+
+		if (line_nr == 1) {
+			char tool[64];
+			int version;
+
+			if (sscanf(line, "# rtreport %d %63s", &version,
+				   tool) != 2)
+				fail("%s: Not an rtreport file", path);
+			if (version > REPORT_VERSION)
+				fail("%s: rtreport version %d is not supported",
+				     path, version);
+			report->tool = report_strdup(tool);
+			continue;
+		}
+
+		phase = strtok_r(line, " \t\n", &save);
+		if ((phase == NULL) || (phase[0] == '#'))
+			continue;
+
+		cpu_token = strtok_r(NULL, " \t\n", &save);
+		metric = strtok_r(NULL, " \t\n", &save);
+		if ((cpu_token == NULL) || (metric == NULL) ||
+		    (report_parse_cpu(cpu_token, &cpu) == -1))
+			fail("%s:%zu: Malformed record", path, line_nr);
+
+		len = strlen(metric);
+		if ((len > 5) && (strcmp(metric + len - 5, ".hist") == 0)) {
+			struct report_hist_t *entry;
+
+			report->hists = checked_realloc(report->hists,
+				(report->nr_hists + 1) * sizeof(*report->hists));
+			entry = &report->hists[report->nr_hists];
+			entry->hist = report_parse_hist(save);
+			if (entry->hist == NULL)
+				fail("%s:%zu: Malformed histogram", path,
+				     line_nr);
+			metric[len - 5] = '\0';
+			entry->phase = report_strdup(phase);
+			entry->cpu = cpu;
+			entry->prefix = report_strdup(metric);
+			report->nr_hists++;
+			continue;
+		}
+
+		report->values = checked_realloc(report->values,
+			(report->nr_values + 1) * sizeof(*report->values));
+		token = strtok_r(NULL, " \t\n", &save);
+		if ((token == NULL) ||
+		    (report_parse_u64(token,
+				      &report->values[report->nr_values].value) == -1))
+			fail("%s:%zu: Malformed value", path, line_nr);
+		report->values[report->nr_values].phase = report_strdup(phase);
+		report->values[report->nr_values].cpu = cpu;
+		report->values[report->nr_values].metric = report_strdup(metric);
+		report->nr_values++;
+	}
+
+	if (ferror(stream))
+		fail("%s: Error reading report: %s", path, strerror(errno));
+	if (line_nr == 0)
+		fail("%s: Not an rtreport file", path);
+	free(line);
+	if (stream != stdin)
+		fclose(stream);
+
+	for (idx = 0; idx < report->nr_hists; idx++)
+		report_complete_hist(report, &report->hists[idx]);
+
+	return report;
+}
+
+void report_free(struct report_t *report)
+{
+	size_t idx;
+
+	for (idx = 0; idx < report->nr_values; idx++) {
+		free(report->values[idx].phase);
+		free(report->values[idx].metric);
+	}
+	for (idx = 0; idx < report->nr_hists; idx++) {
+		free(report->hists[idx].phase);
+		free(report->hists[idx].prefix);
+		histogram_destroy(report->hists[idx].hist);
+		free(report->hists[idx].hist);
+	}
+	free(report->values);
+	free(report->hists);
+	free(report->tool);
+	free(report->path);
+	free(report);
+}
+
+const struct report_value_t *report_find_value(
+	const struct report_t *report, const char *phase, int cpu,
+	const char *metric)
+{
+	size_t idx;
+
+	for (idx = 0; idx < report->nr_values; idx++) {
+		const struct report_value_t *const value = &report->values[idx];
+
+		if ((value->cpu == cpu) && (strcmp(value->metric, metric) == 0) &&
+		    (strcmp(value->phase, phase) == 0))
+			return value;
+	}
+
+	return NULL;
+}
+
+const struct report_hist_t *report_find_hist(
+	const struct report_t *report, const char *phase, int cpu,
+	const char *prefix)
+{
+	size_t idx;
+
+	for (idx = 0; idx < report->nr_hists; idx++) {
+		const struct report_hist_t *const hist = &report->hists[idx];
+
+		if ((hist->cpu == cpu) && (strcmp(hist->prefix, prefix) == 0) &&
+		    (strcmp(hist->phase, phase) == 0))
+			return hist;
+	}
+
+	return NULL;
+}
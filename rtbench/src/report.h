@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct histogram_t;
+
+/*
+ * Writer for the line based rtreport format, see rtbench/README.md.
+ */
+
+#define REPORT_VERSION 1
+
+/* Used as cpu argument for values that are not tied to a single CPU */
+#define REPORT_ALL_CPUS (-1)
+
+/* Open report file and write the header. "-" means stdout. */
+extern FILE *report_open(const char *path, const char *tool);
+
+extern void report_close(FILE *report);
+
+/* Write a single "<phase> <cpu> <metric> <value>" record */
+extern void report_value(FILE *report, const char *phase, int cpu,
+			 const char *metric, uint64_t value);
+
+/* Write summary records (samples, min, avg, max, percentiles) and the
+ * non-empty buckets for hist, using prefix as metric name prefix. */
+extern void report_histogram(FILE *report, const char *phase, int cpu,
+			     const char *prefix,
+			     const struct histogram_t *hist);
+
+/*
+ * Reader for the rtreport format. Histograms are rebuilt from the bucket
+ * record and the summary records of the same prefix.
+ */
+
+struct report_value_t {
+	char *phase;
+	int cpu;
+	char *metric;
+	uint64_t value;
+};
+
+struct report_hist_t {
+	char *phase;
+	int cpu;
+	char *prefix;
+	struct histogram_t *hist;
+};
+
+struct report_t {
+	char *path;
+	char *tool;
+
+	/* Records in file order */
+	struct report_value_t *values;
+	size_t nr_values;
+	struct report_hist_t *hists;
+	size_t nr_hists;
+};
+
+/* Read report file. "-" means stdin. Calls fail() on syntax errors. */
+extern struct report_t *report_load(const char *path);
+
+extern void report_free(struct report_t *report);
+
+/* Return the record of metric, NULL if there is none */
+extern const struct report_value_t *report_find_value(
+	const struct report_t *report, const char *phase, int cpu,
+	const char *metric);
+
+/* Return the histogram with metric name prefix, NULL if there is none */
+extern const struct report_hist_t *report_find_hist(
+	const struct report_t *report, const char *phase, int cpu,
+	const char *prefix);
+
+#endif
@@ -0,0 +1,700 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * rtcompare compares two rtreports, e.g. from before and after a kernel or
+ * partrt configuration change, and tells which differences are larger than
+ * what can be explained by measurement noise.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "histogram.h"
+#include "report.h"
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CONFIDENCE 95.0
+
+/* Exit status when a regression budget is exceeded */
+#define EXIT_REGRESSION 2
+
+/* Limit for how much worse a metric may get, see --budget */
+struct budget_t {
+	const char *pattern;
+	double limit;
+	int percent;
+};
+
+/* Difference between the base and the new value of a metric */
+struct delta_t {
+	double base;
+	double new;
+	double delta;
+
+	/* Confidence interval of delta, only valid if has_ci is set */
+	int has_ci;
+	double lo;
+	double hi;
+
+	/* Set if the values are per second rates rather than raw values */
+	int rate;
+};
+
+static double option_confidence = DEFAULT_CONFIDENCE;
+static const char *option_base_phase = NULL;
+static const char *option_new_phase = NULL;
+static int option_all = 0;
+
+static struct budget_t *budgets = NULL;
+static size_t nr_budgets = 0;
+
+/* Normal distribution quantile for the two sided confidence interval */
+static double z_value;
+
+static double str_to_double(const char *value, const char *what)
+{
+	char *check;
+	double val;
+
+	errno = 0;
+	val = strtod(value, &check);
+	if ((value[0] == '\0') || (check[0] != '\0') || (errno != 0))
+		fail("'%s': Not a valid %s", value, what);
+
+	return val;
+}
+
+/* Find z such that a standard normal variable is within +-z with the given
+ * probability. erfc() is monotonic, so bisection is good enough. */
+static double normal_quantile(double probability)
+{
+	double lo = 0.0;
+	double hi = 10.0;
+	int iteration;
+
+	for (iteration = 0; iteration < 100; iteration++) {
+		const double mid = (lo + hi) / 2;
+
+		if (erfc(mid / sqrt(2.0)) > 1.0 - probability)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return (lo + hi) / 2;
+}
+
+static void add_budget(const char *arg)
+{
+	char *const copy = checked_malloc(strlen(arg) + 1);
+	struct budget_t *budget;
+	char *equal;
+	size_t len;
+
+	strcpy(copy, arg);
+	equal = strrchr(copy, '=');
+	if ((equal == NULL) || (equal == copy))
+		fail("'%s': Budget must be <metric>=<limit>[%%]", arg);
+	*equal = '\0';
+
+	budgets = checked_realloc(budgets, (nr_budgets + 1) * sizeof(*budgets));
+	budget = &budgets[nr_budgets];
+	budget->pattern = copy;
+
+	len = strlen(equal + 1);
+	budget->percent = (len > 0) && (equal[len] == '%');
+	if (budget->percent)
+		equal[len] = '\0';
+	budget->limit = str_to_double(equal + 1, "budget limit");
+	nr_budgets++;
+}
+
+/* Return the budget of metric, NULL if it has none. First match wins. */
+static const struct budget_t *find_budget(const char *metric)
+{
+	size_t idx;
+
+	for (idx = 0; idx < nr_budgets; idx++)
+		if (fnmatch(budgets[idx].pattern, metric, 0) == 0)
+			return &budgets[idx];
+
+	return NULL;
+}
+
+/* Return the length of the measurement in seconds, 0 if unknown. The value
+ * for the CPU is used if there is one, otherwise the one for all CPUs. */
+static double duration_s(const struct report_t *report, const char *phase,
+			 int cpu)
+{
+	const struct report_value_t *value;
+
+	value = report_find_value(report, phase, cpu, "duration_ns");
+	if (value == NULL)
+		value = report_find_value(report, phase, REPORT_ALL_CPUS,
+					  "duration_ns");
+	if ((value == NULL) || (value->value == 0))
+		return 0.0;
+
+	return (double) value->value / 1e9;
+}
+
+/* Event counts are compared as rates if the durations are known. The
+ * counts are assumed to be Poisson distributed, so the variance of a count
+ * is the count itself. */
+static void compare_count(struct delta_t *delta, uint64_t base, double base_s,
+			  uint64_t new, double new_s)
+{
+	double variance;
+
+	if ((base_s > 0.0) && (new_s > 0.0)) {
+		delta->rate = 1;
+		delta->base = (double) base / base_s;
+		delta->new = (double) new / new_s;
+		variance = (double) base / (base_s * base_s) +
+			(double) new / (new_s * new_s);
+	} else {
+		delta->base = (double) base;
+		delta->new = (double) new;
+		variance = (double) base + (double) new;
+	}
+
+	delta->delta = delta->new - delta->base;
+	delta->has_ci = 1;
+	delta->lo = delta->delta - z_value * sqrt(variance);
+	delta->hi = delta->delta + z_value * sqrt(variance);
+}
+
+/* Return the lower or upper bound of the value with the given rank, 1 being
+ * the smallest sample */
+static double hist_rank_value(const struct histogram_t *hist, double rank,
+			      int upper)
+{
+	double seen = 0.0;
+	size_t idx;
+
+	for (idx = 0; idx < hist->nr_buckets; idx++) {
+		seen += (double) hist->buckets[idx];
+		if (seen >= rank) {
+			const double bound = (double) ((idx + (upper ? 1 : 0)) *
+						       hist->bucket_ns);
+
+			return (bound < (double) hist->max_ns) ?
+				bound : (double) hist->max_ns;
+		}
+	}
+
+	return (double) hist->max_ns;
+}
+
+/* Distribution free confidence interval of a percentile, using the normal
+ * approximation of the binomial distribution of the rank. */
+static void percentile_ci(const struct histogram_t *hist, double fraction,
+			  double *lo, double *hi)
+{
+	const double samples = (double) hist->samples;
+	const double rank = fraction * samples;
+	const double spread = z_value * sqrt(samples * fraction * (1.0 - fraction));
+
+	*lo = hist_rank_value(hist, fmax(1.0, floor(rank - spread)), 0);
+	*hi = hist_rank_value(hist, fmin(samples, ceil(rank + spread)), 1);
+}
+
+static void compare_percentile(struct delta_t *delta,
+			       const struct histogram_t *base,
+			       const struct histogram_t *new, double fraction)
+{
+	double base_lo;
+	double base_hi;
+	double new_lo;
+	double new_hi;
+
+	if ((base->samples == 0) || (new->samples == 0))
+		return;
+
+	percentile_ci(base, fraction, &base_lo, &base_hi);
+	percentile_ci(new, fraction, &new_lo, &new_hi);
+	delta->has_ci = 1;
+	delta->lo = new_lo - base_hi;
+	delta->hi = new_hi - base_lo;
+}
+
+/* Sample variance estimated from the bucket midpoints. Overflow samples
+ * are counted as the max value. */
+static double hist_variance(const struct histogram_t *hist, double avg)
+{
+	double sum = 0.0;
+	size_t idx;
+
+	for (idx = 0; idx < hist->nr_buckets; idx++) {
+		const double mid = ((double) idx + 0.5) * (double) hist->bucket_ns;
+
+		sum += (double) hist->buckets[idx] * (mid - avg) * (mid - avg);
+	}
+	sum += (double) hist->overflow * ((double) hist->max_ns - avg) *
+		((double) hist->max_ns - avg);
+
+	return sum / (double) (hist->samples - 1);
+}
+
+/* Welch's interval for the difference of two means */
+static void compare_avg(struct delta_t *delta, const struct histogram_t *base,
+			const struct histogram_t *new)
+{
+	double se;
+
+	if ((base->samples < 2) || (new->samples < 2))
+		return;
+
+	se = sqrt(hist_variance(base, delta->base) / (double) base->samples +
+		  hist_variance(new, delta->new) / (double) new->samples);
+	delta->has_ci = 1;
+	delta->lo = delta->delta - z_value * se;
+	delta->hi = delta->delta + z_value * se;
+}
+
+/* Fill in delta for metric. Returns -1 if the metric is not compared. */
+static int compare_metric(struct delta_t *delta,
+			  const struct report_t *base_report,
+			  const struct report_value_t *base,
+			  const struct report_t *new_report,
+			  const struct report_value_t *new)
+{
+	const struct report_hist_t *base_hist = NULL;
+	const struct report_hist_t *new_hist = NULL;
+	const char *const metric = base->metric;
+	const char *suffix = strchr(metric, '.');
+	const size_t len = strlen(metric);
+	int is_ns;
+
+	memset(delta, 0, sizeof(*delta));
+
+	/* Histogram summaries are named "<prefix>.<summary>", where both the
+	 * prefix and the summary may contain dots, e.g. "gap.p99.9_ns" */
+	for (; suffix != NULL; suffix = strchr(suffix + 1, '.')) {
+		char prefix[128];
+
+		snprintf(prefix, sizeof(prefix), "%.*s",
+			 (int) (suffix - metric), metric);
+		base_hist = report_find_hist(base_report, base->phase,
+					     base->cpu, prefix);
+		if (base_hist != NULL) {
+			new_hist = report_find_hist(new_report, new->phase,
+						    new->cpu, prefix);
+			break;
+		}
+	}
+
+	/* Sample counts and lengths only tell how much was measured */
+	if ((strcmp(metric, "duration_ns") == 0) ||
+	    ((suffix != NULL) && (strcmp(suffix, ".samples") == 0)))
+		return -1;
+
+	is_ns = (len > 3) && (strcmp(metric + len - 3, "_ns") == 0);
+	if (!is_ns) {
+		compare_count(delta, base->value,
+			      duration_s(base_report, base->phase, base->cpu),
+			      new->value,
+			      duration_s(new_report, new->phase, new->cpu));
+		return 0;
+	}
+
+	delta->base = (double) base->value;
+	delta->new = (double) new->value;
+	delta->delta = delta->new - delta->base;
+
+	if ((base_hist == NULL) || (new_hist == NULL) ||
+	    (base_hist->hist->bucket_ns != new_hist->hist->bucket_ns))
+		return 0;
+
+	if ((suffix[1] == 'p') && (suffix[2] >= '0') && (suffix[2] <= '9'))
+		compare_percentile(delta, base_hist->hist, new_hist->hist,
+				   strtod(suffix + 2, NULL) / 100.0);
+	else if (strcmp(suffix, ".avg_ns") == 0)
+		compare_avg(delta, base_hist->hist, new_hist->hist);
+
+	return 0;
+}
+
+static void format_value(char *buf, size_t size, double value, int rate,
+			 int sign)
+{
+	if (rate)
+		snprintf(buf, size, sign ? "%+.3f" : "%.3f", value);
+	else
+		snprintf(buf, size, sign ? "%+.0f" : "%.0f", value);
+}
+
+/* Print the comparison of one metric, and return 1 if it exceeds its
+ * budget */
+static int print_delta(const struct report_value_t *base,
+		       const struct delta_t *delta)
+{
+	const struct budget_t *const budget = find_budget(base->metric);
+	char cpu[16];
+	char metric[96];
+	char base_str[32];
+	char new_str[32];
+	char delta_str[32];
+	char lo_str[32];
+	char hi_str[32];
+	char ci_str[72] = "";
+	char verdict[64] = "";
+	int regression = 0;
+
+	if (base->cpu == REPORT_ALL_CPUS)
+		snprintf(cpu, sizeof(cpu), "all");
+	else
+		snprintf(cpu, sizeof(cpu), "%d", base->cpu);
+	snprintf(metric, sizeof(metric), "%s%s", base->metric,
+		 delta->rate ? "/s" : "");
+	format_value(base_str, sizeof(base_str), delta->base, delta->rate, 0);
+	format_value(new_str, sizeof(new_str), delta->new, delta->rate, 0);
+	format_value(delta_str, sizeof(delta_str), delta->delta, delta->rate, 1);
+	if (delta->has_ci) {
+		format_value(lo_str, sizeof(lo_str), delta->lo, delta->rate, 1);
+		format_value(hi_str, sizeof(hi_str), delta->hi, delta->rate, 1);
+		snprintf(ci_str, sizeof(ci_str), "[%s, %s]", lo_str, hi_str);
+	}
+
+	if (budget != NULL) {
+		const double limit = budget->percent ?
+			delta->base * budget->limit / 100.0 : budget->limit;
+
+		/* Only regressions that are not explained by noise count */
+		regression = (delta->has_ci ? delta->lo : delta->delta) > limit;
+		snprintf(verdict, sizeof(verdict), "%s (budget %+g%s)",
+			 regression ? "REGRESSION" : "ok", budget->limit,
+			 budget->percent ? "%" : "");
+	} else if (delta->has_ci && (delta->lo > 0.0)) {
+		snprintf(verdict, sizeof(verdict), "worse");
+	} else if (delta->has_ci && (delta->hi < 0.0)) {
+		snprintf(verdict, sizeof(verdict), "better");
+	}
+
+	if (option_all || (verdict[0] != '\0'))
+		printf("%4s %-24s %12s %12s %12s %-27s %s\n", cpu, metric,
+		       base_str, new_str, delta_str, ci_str, verdict);
+
+	return regression;
+}
+
+/* Compare all metrics in base phase of base_report with the same metrics
+ * in new phase of new_report. Returns the number of regressions. */
+static size_t compare_reports(const struct report_t *base_report,
+			      const struct report_t *new_report)
+{
+	size_t nr_compared = 0;
+	size_t nr_regressions = 0;
+	size_t idx;
+
+	printf("%4s %-24s %12s %12s %12s %-27s %s\n", "CPU", "Metric", "Base",
+	       "New", "Delta", "Confidence interval", "");
+
+	for (idx = 0; idx < base_report->nr_values; idx++) {
+		const struct report_value_t *const base = &base_report->values[idx];
+		const struct report_value_t *new;
+		struct delta_t delta;
+		const char *new_phase = base->phase;
+
+		if (option_base_phase != NULL) {
+			if (strcmp(base->phase, option_base_phase) != 0)
+				continue;
+			new_phase = option_new_phase;
+		}
+
+		new = report_find_value(new_report, new_phase, base->cpu,
+					base->metric);
+		if (new == NULL)
+			continue;
+		if (compare_metric(&delta, base_report, base, new_report,
+				   new) == -1)
+			continue;
+
+		nr_compared++;
+		nr_regressions += (size_t) print_delta(base, &delta);
+	}
+
+	if (nr_compared == 0)
+		fail("%s, %s: No metrics in common", base_report->path,
+		     new_report->path);
+
+	return nr_regressions;
+}
+
+/*****************************************************************************
+ * This is the man page using POD text format.
+ *
+ * For syntax description:
+ *     http://perldoc.perl.org/perlpod.html
+
+=head1 NAME
+
+rtcompare - compare two rtreports and gate on regressions
+
+=head1 SYNOPSIS
+
+rtcompare [options] <base report> <new report>
+
+=head1 DESCRIPTION
+
+rtcompare compares the metrics in B<new report> with the same metrics in
+B<base report>, per CPU, and prints the difference with a confidence
+interval. The reports can be written by rtjitter, rtgap or
+"count_ticks --report".
+
+Event counts, like B<ticks> and B<irqs>, are compared as rates per second
+when the reports contain the measurement duration. They are assumed to be
+Poisson distributed. Percentiles get a distribution free confidence
+interval from the histograms in the reports, and averages a Welch
+interval. Max and min values have no confidence interval.
+
+Only metrics where the confidence interval lies entirely above or below
+zero are printed, marked B<worse> or B<better>, together with all metrics
+that have a budget. All metrics are treated as higher is worse.
+
+A metric exceeds its budget when its confidence interval lies entirely
+above the budget limit, or for metrics without confidence interval, when
+the difference does. rtcompare then exits with status 2, so it can be used
+to gate kernel or configuration changes.
+
+=head1 OPTIONS
+
+B<-b, --budget=METRIC=LIMIT[%]>
+       Allow METRIC to get worse by at most LIMIT, in the unit of the
+       metric, or LIMIT percent of the base value. METRIC is a shell
+       pattern, e.g. '*.p99_ns'. Rates are limited per second. Can be
+       given multiple times, first match wins.
+
+B<-p, --phase=BASE[:NEW]>
+       Compare phase BASE of the base report with phase NEW of the new
+       report. Default is to compare phases with the same name. Useful
+       for comparing the before and after phases of "rtjitter --partrt".
+
+B<-c, --confidence=PERCENT>
+       Confidence level of the intervals. Default: 95
+
+B<-a, --all>
+       Print all metrics, not only significant changes.
+
+B<-v, --verbose>
+       Produce informational message to stderr.
+
+B<-V, --version>
+       Show version information and exit
+
+B<-h, --help>
+       Show help text and exit
+
+=head1 EXIT STATUS
+
+0 if no budget is exceeded, 1 on errors and 2 if a budget is exceeded.
+
+=head1 EXAMPLE
+
+B<rtcompare -b '*.p99_ns=10%' -b 'ticks=0' old-kernel.rtreport new-kernel.rtreport>
+
+Fail if the 99th percentile latency of any probe gets more than 10% worse,
+or if the tick rate increases on any CPU.
+
+B<rtjitter -o jitter.rtreport --partrt 0xc && rtcompare -a -p before:after jitter.rtreport jitter.rtreport>
+
+Show everything that changed when the partition was created.
+
+=head1 AUTHOR
+
+Enea Software AB
+
+=head1 REPORTING BUGS
+
+Report bugs to openenealinux@lists.openenealinux.org
+
+=head1 COPYRIGHT
+
+Copyright (c) 2014 by Enea Software AB
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Enea Software AB nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=cut
+
+*****************************************************************************/
+
+static void usage(void)
+{
+	puts("rtcompare - Compare two rtreports and gate on regressions\n"
+	     "Usage:\n"
+	     "rtcompare [options] <base report> <new report>\n"
+	     "\n"
+	     "Compares the metrics in <new report> with <base report> per CPU, and\n"
+	     "prints the changes that are larger than the measurement noise, with\n"
+	     "confidence intervals. Counts are compared as rates if the duration is\n"
+	     "known. Exits with status 2 if a budget is exceeded.\n"
+	     "\n"
+	     "Options:\n"
+	     "-b, --budget=<m>=<l>[%] Allow metric <m> to get at most <l> worse, or\n"
+	     "                        <l> percent. <m> is a shell pattern. Can be\n"
+	     "                        given multiple times, first match wins.\n"
+	     "-p, --phase=<b>[:<n>]   Compare phase <b> of the base report with phase\n"
+	     "                        <n> of the new report. Default: same names\n"
+	     "-c, --confidence=<pct>  Confidence level. Default: 95\n"
+	     "-a, --all               Print all metrics, not only significant changes.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Example:\n"
+	     "   rtcompare -b '*.p99_ns=10%' -b ticks=0 old.rtreport new.rtreport\n");
+}
+
+static void version(void)
+{
+	printf("rtcompare %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       rtbench_VERSION_MAJOR, rtbench_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"budget", required_argument, NULL, 'b'},
+		{"phase", required_argument, NULL, 'p'},
+		{"confidence", required_argument, NULL, 'c'},
+		{"all", no_argument, NULL, 'a'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVb:p:c:a";
+	struct report_t *base_report;
+	struct report_t *new_report;
+	size_t nr_regressions;
+	char *colon;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'b':
+			add_budget(optarg);
+			break;
+		case 'p':
+			option_base_phase = optarg;
+			option_new_phase = optarg;
+			colon = strchr(optarg, ':');
+			if (colon != NULL) {
+				*colon = '\0';
+				option_new_phase = colon + 1;
+			}
+			if ((option_base_phase[0] == '\0') ||
+			    (option_new_phase[0] == '\0'))
+				fail("Phase must be <base>[:<new>]");
+			break;
+		case 'c':
+			option_confidence = str_to_double(optarg, "confidence");
+			if ((option_confidence <= 0.0) ||
+			    (option_confidence >= 100.0))
+				fail("'%s': Confidence must be between 0 and 100",
+				     optarg);
+			break;
+		case 'a':
+			option_all = 1;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind + 2 > argc)
+		fail("Missing report to compare");
+	if (optind + 2 < argc)
+		fail("%s: Unexpected argument", argv[optind + 2]);
+
+	z_value = normal_quantile(option_confidence / 100.0);
+	info("%.1f%% confidence: z = %.3f", option_confidence, z_value);
+
+	base_report = report_load(argv[optind]);
+	new_report = report_load(argv[optind + 1]);
+	info("Comparing %s report %s with %s report %s",
+	     base_report->tool, base_report->path,
+	     new_report->tool, new_report->path);
+
+	nr_regressions = compare_reports(base_report, new_report);
+	if (nr_budgets > 0)
+		printf("%zu regression%s\n", nr_regressions,
+		       (nr_regressions == 1) ? "" : "s");
+
+	report_free(base_report);
+	report_free(new_report);
+
+	return (nr_regressions > 0) ? EXIT_REGRESSION : 0;
+}
@@ -0,0 +1,924 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "histogram.h"
+#include "irqstat.h"
+#include "probe.h"
+#include "report.h"
+#include "tracefs.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define DEFAULT_DURATION_S 10
+#define DEFAULT_THRESHOLD_US 10
+#define DEFAULT_MAX_GAPS 10000
+#define DEFAULT_PRIORITY 80
+#define DEFAULT_BUFFER_KB 4096
+#define DEFAULT_PHASE "run"
+
+/* Gap length histogram layout */
+#define GAP_HIST_RESOLUTION_NS 1000
+#define GAP_HIST_BUCKETS 10000
+
+/* Trace timestamps only have microsecond resolution, so widen each gap by
+ * this much when looking for kernel events within it. */
+#define TRACE_SLACK_NS 1000
+
+#define TSC_CALIBRATION_US 100000
+
+enum gap_class_t {
+	gap_unknown,
+	gap_kernel,
+	gap_hw,
+	nr_gap_classes
+};
+
+static const char *const gap_class_names[nr_gap_classes] = {
+	"unknown",
+	"kernel",
+	"hw"
+};
+
+struct gap_t {
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	enum gap_class_t class;
+
+	/* First kernel event seen within the gap, if any */
+	char event[32];
+};
+
+struct cpu_state_t {
+	pthread_t thread;
+	int cpu;
+
+	/* Recorded gaps, sorted by start time */
+	struct gap_t *gaps;
+	size_t nr_gaps;
+
+	/* Gaps that did not fit into gaps[] */
+	uint64_t dropped;
+
+	uint64_t start_ns;
+	uint64_t end_ns;
+	uint64_t total_gap_ns;
+	struct histogram_t hist;
+
+	uint64_t irqs;
+	uint64_t smis;
+	int smis_valid;
+
+	/* Counters from the trace, only valid if traced is set */
+	int traced;
+	uint64_t ticks;
+	uint64_t nr_class[nr_gap_classes];
+};
+
+static uint64_t option_duration_ns = DEFAULT_DURATION_S * NSEC_PER_SEC;
+static uint64_t option_threshold_ns = DEFAULT_THRESHOLD_US * NSEC_PER_USEC;
+static size_t option_max_gaps = DEFAULT_MAX_GAPS;
+static int option_priority = DEFAULT_PRIORITY;
+static int option_mlock = 1;
+static int option_tsc = 0;
+static int option_trace = 1;
+static unsigned long option_buffer_kb = DEFAULT_BUFFER_KB;
+static const char *option_phase = DEFAULT_PHASE;
+static const char *option_cpuset = NULL;
+static const char *option_output = NULL;
+
+static pthread_barrier_t start_barrier;
+
+/* Trace instance used for classifying gaps, NULL if not tracing */
+static char *trace_instance = NULL;
+
+/* Kernel events that explain a gap if they occur within it */
+static const char *const trace_events[] = {
+	"irq",
+	"irq_vectors",
+	"ipi",
+	"nmi",
+	"sched/sched_switch",
+	"timer/hrtimer_expire_entry",
+	"timer/timer_expire_entry",
+	"workqueue/workqueue_execute_start",
+};
+
+static unsigned long str_to_ulong(const char *value, const char *what)
+{
+	char *check;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(value, &check, 0);
+	if ((value[0] == '\0') || (check[0] != '\0') || (errno != 0))
+		fail("'%s': Not a valid %s", value, what);
+
+	return val;
+}
+
+/*
+ * Time stamp counter
+ */
+
+static double tsc_ns_per_cycle;
+static uint64_t tsc_base_cycles;
+static uint64_t tsc_base_ns;
+
+#if HAVE_TSC
+
+static inline uint64_t tsc_read(void)
+{
+	return __rdtsc();
+}
+
+/* Assumes an invariant TSC that is synchronized between CPUs */
+static void tsc_calibrate(void)
+{
+	const uint64_t start_ns = probe_now_ns();
+	const uint64_t start_cycles = tsc_read();
+
+	usleep(TSC_CALIBRATION_US);
+
+	tsc_ns_per_cycle = (double) (probe_now_ns() - start_ns) /
+		(double) (tsc_read() - start_cycles);
+	tsc_base_cycles = start_cycles;
+	tsc_base_ns = start_ns;
+
+	info("TSC: %.3f ns per cycle", tsc_ns_per_cycle);
+}
+
+#else
+
+static inline uint64_t tsc_read(void)
+{
+	return 0;
+}
+
+static void tsc_calibrate(void)
+{
+	fail("Time stamp counter is not supported on this architecture");
+}
+
+#endif
+
+static inline uint64_t tsc_cycles_to_ns(uint64_t cycles)
+{
+	return (uint64_t) ((double) cycles * tsc_ns_per_cycle);
+}
+
+static inline uint64_t tsc_ns_to_cycles(uint64_t ns)
+{
+	return (uint64_t) ((double) ns / tsc_ns_per_cycle);
+}
+
+/*
+ * Measurement threads
+ */
+
+static inline void record_gap(struct cpu_state_t *state, uint64_t start_ns,
+			      uint64_t duration_ns)
+{
+	histogram_add(&state->hist, duration_ns);
+	state->total_gap_ns += duration_ns;
+
+	if (state->nr_gaps < option_max_gaps) {
+		state->gaps[state->nr_gaps].start_ns = start_ns;
+		state->gaps[state->nr_gaps].duration_ns = duration_ns;
+		state->nr_gaps++;
+	} else {
+		state->dropped++;
+	}
+}
+
+static void spin_clock(struct cpu_state_t *state)
+{
+	uint64_t prev = probe_now_ns();
+	const uint64_t end = prev + option_duration_ns;
+
+	state->start_ns = prev;
+	while (prev < end) {
+		const uint64_t now = probe_now_ns();
+
+		if (now - prev > option_threshold_ns)
+			record_gap(state, prev, now - prev);
+		prev = now;
+	}
+	state->end_ns = prev;
+}
+
+static void spin_tsc(struct cpu_state_t *state)
+{
+	const uint64_t threshold = tsc_ns_to_cycles(option_threshold_ns);
+	uint64_t prev = tsc_read();
+	const uint64_t end = prev + tsc_ns_to_cycles(option_duration_ns);
+
+	state->start_ns = tsc_base_ns + tsc_cycles_to_ns(prev - tsc_base_cycles);
+	while (prev < end) {
+		const uint64_t now = tsc_read();
+
+		if (now - prev > threshold)
+			record_gap(state,
+				   tsc_base_ns + tsc_cycles_to_ns(prev - tsc_base_cycles),
+				   tsc_cycles_to_ns(now - prev));
+		prev = now;
+	}
+	state->end_ns = tsc_base_ns + tsc_cycles_to_ns(prev - tsc_base_cycles);
+}
+
+static void *spin_main(void *arg)
+{
+	struct cpu_state_t *const state = arg;
+
+	if (option_cpuset != NULL)
+		probe_place_in_cpuset(option_cpuset);
+	probe_pin_to_cpu(state->cpu);
+	probe_set_fifo(option_priority);
+	probe_prefault_stack();
+
+	pthread_barrier_wait(&start_barrier);
+
+	if (option_tsc)
+		spin_tsc(state);
+	else
+		spin_clock(state);
+
+	return NULL;
+}
+
+static void start_thread(pthread_t *thread, void *(*func) (void *),
+			 void *arg)
+{
+	pthread_attr_t attr;
+	int status;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PROBE_STACK_SIZE);
+	status = pthread_create(thread, &attr, func, arg);
+	if (status != 0)
+		fail("Could not create thread: %s", strerror(status));
+	pthread_attr_destroy(&attr);
+}
+
+/*
+ * Trace handling
+ */
+
+static void trace_cleanup(void)
+{
+	if (trace_instance == NULL)
+		return;
+
+	tracefs_write(trace_instance, "tracing_on", "0");
+	tracefs_instance_remove(trace_instance);
+	trace_instance = NULL;
+}
+
+/* Set up a private trace instance recording kernel activity on the
+ * measured CPUs. The global trace buffer is left alone. */
+static void trace_setup(const struct bitmap_t *cpus)
+{
+	const char *const root = tracefs_root();
+	char value[64];
+	char *mask;
+	size_t idx;
+
+	if (root == NULL) {
+		info("tracefs not found, gaps will not be classified");
+		return;
+	}
+
+	snprintf(value, sizeof(value), "rtgap-%d", (int) getpid());
+	trace_instance = tracefs_instance_create(root, value);
+	if (trace_instance == NULL) {
+		info("No trace instance, gaps will not be classified");
+		return;
+	}
+	atexit(trace_cleanup);
+
+	tracefs_write(trace_instance, "tracing_on", "0");
+
+	/* Trace time stamps must be comparable with CLOCK_MONOTONIC */
+	if (tracefs_write(trace_instance, "trace_clock", "mono") == -1) {
+		info("Trace clock 'mono' not supported, gaps will not be classified");
+		trace_cleanup();
+		return;
+	}
+
+	snprintf(value, sizeof(value), "%lu", option_buffer_kb);
+	tracefs_write(trace_instance, "buffer_size_kb", value);
+
+	mask = bitmap_u32list(cpus);
+	tracefs_write(trace_instance, "tracing_cpumask", mask);
+	free(mask);
+
+	for (idx = 0; idx < sizeof(trace_events) / sizeof(trace_events[0]); idx++) {
+		char file[128];
+
+		snprintf(file, sizeof(file), "events/%s/enable", trace_events[idx]);
+		if (tracefs_write(trace_instance, file, "1") == -1)
+			debug("%s: Trace event not available", trace_events[idx]);
+	}
+}
+
+/* Return the number of events lost on cpu because the buffer was full */
+static uint64_t trace_overrun(int cpu)
+{
+	char path[256];
+	char line[128];
+	unsigned long long overrun = 0;
+	FILE *stream;
+
+	snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/stats", trace_instance,
+		 cpu);
+	stream = fopen(path, "r");
+	if (stream == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), stream) != NULL)
+		if (sscanf(line, "overrun: %llu", &overrun) == 1)
+			break;
+	fclose(stream);
+
+	return overrun;
+}
+
+/* Walk through the trace of the CPU, and mark each gap that has a kernel
+ * event within it as kernel noise. Gaps without any kernel activity are
+ * caused by something the kernel does not see, e.g. SMIs or a hypervisor. */
+static void classify_gaps(struct cpu_state_t *state)
+{
+	char path[256];
+	char *line = NULL;
+	size_t line_size = 0;
+	char event[32];
+	uint64_t ts_ns;
+	uint64_t first_ts_ns = UINT64_MAX;
+	size_t gap = 0;
+	size_t idx;
+	FILE *stream;
+
+	for (idx = 0; idx < state->nr_gaps; idx++)
+		state->gaps[idx].class = gap_unknown;
+
+	if (trace_instance == NULL)
+		return;
+
+	snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/trace", trace_instance,
+		 state->cpu);
+	stream = fopen(path, "r");
+	if (stream == NULL) {
+		info("%s: Could not open: %s", path, strerror(errno));
+		return;
+	}
+
+	while (getline(&line, &line_size, stream) != -1) {
+		if (!tracefs_parse_line(line, &ts_ns, event, sizeof(event)))
+			continue;
+
+		if (first_ts_ns == UINT64_MAX)
+			first_ts_ns = ts_ns;
+
+		if ((strcmp(event, "hrtimer_expire_entry") == 0) &&
+		    (strstr(line, "function=tick_sched_timer") != NULL))
+			state->ticks++;
+
+		while ((gap < state->nr_gaps) &&
+		       (state->gaps[gap].start_ns + state->gaps[gap].duration_ns +
+			TRACE_SLACK_NS < ts_ns))
+			gap++;
+
+		/* Events are sorted, so gaps that start later might still
+		 * contain this event. */
+		for (idx = gap; (idx < state->nr_gaps) &&
+			     (state->gaps[idx].start_ns <= ts_ns + TRACE_SLACK_NS);
+		     idx++) {
+			if (state->gaps[idx].class == gap_unknown) {
+				state->gaps[idx].class = gap_kernel;
+				snprintf(state->gaps[idx].event,
+					 sizeof(state->gaps[idx].event), "%s",
+					 event);
+			}
+		}
+	}
+
+	free(line);
+	fclose(stream);
+
+	/* If the buffer overflowed, nothing is known about gaps before the
+	 * first event left in it. */
+	if (trace_overrun(state->cpu) > 0)
+		info("CPU %d: Trace buffer overrun, consider a larger --buffer-kb",
+		     state->cpu);
+	else
+		first_ts_ns = 0;
+
+	for (idx = 0; idx < state->nr_gaps; idx++)
+		if ((state->gaps[idx].class == gap_unknown) &&
+		    (state->gaps[idx].start_ns >= first_ts_ns))
+			state->gaps[idx].class = gap_hw;
+
+	state->traced = 1;
+}
+
+/*
+ * Output
+ */
+
+static void print_results(const struct cpu_state_t *states, size_t nr_states)
+{
+	size_t idx;
+	size_t gap;
+
+	printf("%4s %8s %8s %8s %8s %11s %13s %8s %6s %6s\n",
+	       "CPU", "Gaps", "Kernel", "HW", "Unknown", "Max(ns)",
+	       "Total(ns)", "IRQs", "SMIs", "Ticks");
+
+	for (idx = 0; idx < nr_states; idx++) {
+		const struct cpu_state_t *const state = &states[idx];
+		char smis[24] = "-";
+		char ticks[24] = "-";
+
+		if (state->smis_valid)
+			snprintf(smis, sizeof(smis), "%llu",
+				 (unsigned long long) state->smis);
+		if (state->traced)
+			snprintf(ticks, sizeof(ticks), "%llu",
+				 (unsigned long long) state->ticks);
+
+		printf("%4d %8llu %8llu %8llu %8llu %11llu %13llu %8llu %6s %6s\n",
+		       state->cpu,
+		       (unsigned long long) state->hist.samples,
+		       (unsigned long long) state->nr_class[gap_kernel],
+		       (unsigned long long) state->nr_class[gap_hw],
+		       (unsigned long long) state->nr_class[gap_unknown],
+		       (unsigned long long) state->hist.max_ns,
+		       (unsigned long long) state->total_gap_ns,
+		       (unsigned long long) state->irqs, smis, ticks);
+
+		if (state->dropped > 0)
+			printf("%4d: %llu gaps not recorded, consider a larger --max-gaps\n",
+			       state->cpu, (unsigned long long) state->dropped);
+	}
+
+	if (option_verbose < 1)
+		return;
+
+	for (idx = 0; idx < nr_states; idx++) {
+		const struct cpu_state_t *const state = &states[idx];
+
+		for (gap = 0; gap < state->nr_gaps; gap++)
+			fprintf(stderr, "CPU %d: +%llu ns: %llu ns gap, %s%s%s\n",
+				state->cpu,
+				(unsigned long long) (state->gaps[gap].start_ns -
+						      state->start_ns),
+				(unsigned long long) state->gaps[gap].duration_ns,
+				gap_class_names[state->gaps[gap].class],
+				(state->gaps[gap].class == gap_kernel) ? ": " : "",
+				state->gaps[gap].event);
+	}
+}
+
+static void report_results(FILE *report, const struct cpu_state_t *states,
+			   size_t nr_states)
+{
+	size_t idx;
+	size_t gap;
+	int class;
+
+	for (idx = 0; idx < nr_states; idx++) {
+		const struct cpu_state_t *const state = &states[idx];
+		char metric[64];
+
+		report_value(report, option_phase, state->cpu, "duration_ns",
+			     state->end_ns - state->start_ns);
+		report_histogram(report, option_phase, state->cpu, "gap",
+				 &state->hist);
+		for (class = 0; class < nr_gap_classes; class++) {
+			snprintf(metric, sizeof(metric), "gap.%s.count",
+				 gap_class_names[class]);
+			report_value(report, option_phase, state->cpu, metric,
+				     state->nr_class[class]);
+		}
+		report_value(report, option_phase, state->cpu, "gap.dropped",
+			     state->dropped);
+		report_value(report, option_phase, state->cpu, "gap.total_ns",
+			     state->total_gap_ns);
+		report_value(report, option_phase, state->cpu, "irqs",
+			     state->irqs);
+		if (state->smis_valid)
+			report_value(report, option_phase, state->cpu, "smis",
+				     state->smis);
+		if (state->traced)
+			report_value(report, option_phase, state->cpu, "ticks",
+				     state->ticks);
+
+		/* Each gap: "gap.<class> <offset ns> <duration ns>" */
+		for (gap = 0; gap < state->nr_gaps; gap++)
+			fprintf(report, "%s %d gap.%s %llu %llu\n", option_phase,
+				state->cpu,
+				gap_class_names[state->gaps[gap].class],
+				(unsigned long long) (state->gaps[gap].start_ns -
+						      state->start_ns),
+				(unsigned long long) state->gaps[gap].duration_ns);
+	}
+}
+
+/*****************************************************************************
+ * This is the man page using POD text format.
+ *
+ * For syntax description:
+ *     http://perldoc.perl.org/perlpod.html
+
+=head1 NAME
+
+rtgap - detect hardware latencies and SMIs on isolated CPUs
+
+=head1 SYNOPSIS
+
+rtgap [options] <rt cpumask>
+
+=head1 DESCRIPTION
+
+rtgap runs one thread on each CPU in B<rt cpumask> that reads the clock in a
+tight loop. Whenever two consecutive reads are further apart than the
+threshold, the gap is recorded.
+
+To tell kernel noise from noise the kernel never sees, rtgap records
+interrupts, timers, IPIs, NMIs, work items and context switches on the
+measured CPUs in a private ftrace instance, so any tracing already running
+on the system is left alone. Gaps with a kernel event within them are
+classified as B<kernel>. Gaps without kernel activity are classified as
+B<hw>, which means firmware (SMIs), a hypervisor or the hardware itself.
+If tracing is not available, gaps are classified as B<unknown>.
+
+The per-CPU interrupt count from /proc/interrupts and, where the msr driver
+provides it, the SMI count (MSR_SMI_COUNT) are recorded for the measurement
+period as well. The number of scheduler ticks is taken from the trace.
+
+Results are printed per CPU. With B<--output> they are also written in
+rtreport format, the same format as "count_ticks --report" uses.
+
+=head1 OPTIONS
+
+B<-d, --duration=SECONDS>
+       Measure for SECONDS seconds. Default: 10
+
+B<-t, --threshold=USEC>
+       Record gaps longer than USEC microseconds. Default: 10
+
+B<-m, --max-gaps=NUMBER>
+       Record at most NUMBER gaps per CPU. Further gaps are still counted.
+       Default: 10000
+
+B<-p, --priority=PRIO>
+       SCHED_FIFO priority of the measurement threads, 0 means SCHED_OTHER.
+       Default: 80
+
+B<-T, --tsc>
+       Read the time stamp counter instead of clock_gettime() (x86 only).
+       Requires an invariant TSC that is synchronized between CPUs.
+
+B<-k, --no-trace>
+       Do not use ftrace for classifying gaps.
+
+B<-b, --buffer-kb=KB>
+       Per-CPU trace buffer size. Default: 4096
+
+B<-c, --cpuset=NAME>
+       Move the measurement threads into cpuset NAME before measuring.
+
+B<-L, --no-mlock>
+       Do not lock memory. Mostly useful for testing.
+
+B<-o, --output=FILE>
+       Write results in rtreport format to FILE, '-' means stdout.
+
+B<-l, --label=NAME>
+       Name of the measurement phase in the output. Default: 'run'
+
+B<-v, --verbose>
+       Produce informational message to stderr, including every
+       recorded gap.
+
+B<-V, --version>
+       Show version information and exit
+
+B<-h, --help>
+       Show help text and exit
+
+=head1 EXAMPLE
+
+B<partrt run rt rtgap -d 60 -t 5 0xc>
+
+Look for gaps longer than 5 microseconds on CPU 2 and 3 for a minute.
+
+=head1 AUTHOR
+
+Enea Software AB
+
+=head1 REPORTING BUGS
+
+Report bugs to openenealinux@lists.openenealinux.org
+
+=head1 COPYRIGHT
+
+Copyright (c) 2014 by Enea Software AB
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Enea Software AB nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=cut
+
+*****************************************************************************/
+
+static void usage(void)
+{
+	puts("rtgap - Detect hardware latencies and SMIs on isolated CPUs\n"
+	     "Usage:\n"
+	     "rtgap [options] <rt cpumask>\n"
+	     "\n"
+	     "Spins on each CPU in the hexadecimal <rt cpumask> reading the clock, and\n"
+	     "records every gap above the threshold. Gaps are classified as kernel or\n"
+	     "hardware/firmware noise using ftrace.\n"
+	     "\n"
+	     "Options:\n"
+	     "-d, --duration=<s>      Measure for <s> seconds. Default: 10\n"
+	     "-t, --threshold=<us>    Record gaps longer than <us>. Default: 10\n"
+	     "-m, --max-gaps=<n>      Record at most <n> gaps per CPU. Default: 10000\n"
+	     "-p, --priority=<prio>   SCHED_FIFO priority, 0 for SCHED_OTHER.\n"
+	     "                        Default: 80\n"
+	     "-T, --tsc               Read time stamp counter instead of clock.\n"
+	     "-k, --no-trace          Do not classify gaps using ftrace.\n"
+	     "-b, --buffer-kb=<kb>    Per-CPU trace buffer size. Default: 4096\n"
+	     "-c, --cpuset=<name>     Move threads into cpuset <name>.\n"
+	     "-L, --no-mlock          Do not lock memory.\n"
+	     "-o, --output=<file>     Write rtreport to <file>, '-' means stdout.\n"
+	     "-l, --label=<name>      Phase name in output. Default: 'run'\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Example:\n"
+	     "   partrt run rt rtgap -d 60 0xc\n");
+}
+
+static void version(void)
+{
+	printf("rtgap %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       rtbench_VERSION_MAJOR, rtbench_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"duration", required_argument, NULL, 'd'},
+		{"threshold", required_argument, NULL, 't'},
+		{"max-gaps", required_argument, NULL, 'm'},
+		{"priority", required_argument, NULL, 'p'},
+		{"tsc", no_argument, NULL, 'T'},
+		{"no-trace", no_argument, NULL, 'k'},
+		{"buffer-kb", required_argument, NULL, 'b'},
+		{"cpuset", required_argument, NULL, 'c'},
+		{"no-mlock", no_argument, NULL, 'L'},
+		{"output", required_argument, NULL, 'o'},
+		{"label", required_argument, NULL, 'l'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVd:t:m:p:Tkb:c:Lo:l:";
+	const int nr_cpus = probe_nr_cpus();
+	struct bitmap_t *rt_mask;
+	struct cpu_state_t *states;
+	uint64_t *irqs_before;
+	uint64_t *irqs_after;
+	size_t nr_states = 0;
+	size_t idx;
+	int irqs_valid;
+	int cpu;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'd':
+			option_duration_ns = str_to_ulong(optarg, "duration") *
+				NSEC_PER_SEC;
+			break;
+		case 't':
+			option_threshold_ns = str_to_ulong(optarg, "threshold") *
+				NSEC_PER_USEC;
+			break;
+		case 'm':
+			option_max_gaps = str_to_ulong(optarg, "gap count");
+			break;
+		case 'p':
+			option_priority = (int) str_to_ulong(optarg, "priority");
+			break;
+		case 'T':
+			option_tsc = 1;
+			break;
+		case 'k':
+			option_trace = 0;
+			break;
+		case 'b':
+			option_buffer_kb = str_to_ulong(optarg, "buffer size");
+			break;
+		case 'c':
+			option_cpuset = optarg;
+			break;
+		case 'L':
+			option_mlock = 0;
+			break;
+		case 'o':
+			option_output = optarg;
+			break;
+		case 'l':
+			option_phase = optarg;
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind >= argc)
+		fail("Missing mandatory RT cpumask");
+	if (optind + 1 < argc)
+		fail("%s: Unexpected argument", argv[optind + 1]);
+
+	parse_scope = "RT cpumask";
+	rt_mask = bitmap_alloc_from_u32_list(argv[optind]);
+	parse_scope = NULL;
+
+	states = checked_malloc((size_t) nr_cpus * sizeof(*states));
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (!bitmap_isset((size_t) cpu, rt_mask))
+			continue;
+		states[nr_states].cpu = cpu;
+		states[nr_states].gaps =
+			checked_malloc(option_max_gaps * sizeof(struct gap_t));
+		histogram_init(&states[nr_states].hist, GAP_HIST_RESOLUTION_NS,
+			       GAP_HIST_BUCKETS);
+		nr_states++;
+	}
+
+	if (nr_states == 0)
+		fail("%s: No existing CPU in RT cpumask", argv[optind]);
+	if (nr_states != bitmap_bit_count(rt_mask))
+		fail("%s: RT cpumask contains CPUs that do not exist",
+		     argv[optind]);
+
+	if (option_tsc)
+		tsc_calibrate();
+	if (option_trace)
+		trace_setup(rt_mask);
+	if (option_mlock)
+		probe_lock_memory();
+
+	irqs_before = checked_malloc((size_t) nr_cpus * sizeof(*irqs_before));
+	irqs_after = checked_malloc((size_t) nr_cpus * sizeof(*irqs_after));
+	for (idx = 0; idx < nr_states; idx++)
+		states[idx].smis_valid =
+			(irqstat_read_smi(states[idx].cpu, &states[idx].smis) == 0);
+	irqs_valid = (irqstat_read(irqs_before, nr_cpus) == 0);
+
+	if (trace_instance != NULL)
+		tracefs_write(trace_instance, "tracing_on", "1");
+
+	info("Measuring on %zu CPU%s", nr_states, (nr_states == 1) ? "" : "s");
+	pthread_barrier_init(&start_barrier, NULL, (unsigned) nr_states);
+	for (idx = 0; idx < nr_states; idx++)
+		start_thread(&states[idx].thread, spin_main, &states[idx]);
+	for (idx = 0; idx < nr_states; idx++) {
+		const int status = pthread_join(states[idx].thread, NULL);
+
+		if (status != 0)
+			fail("Could not join thread: %s", strerror(status));
+	}
+	pthread_barrier_destroy(&start_barrier);
+
+	if (trace_instance != NULL)
+		tracefs_write(trace_instance, "tracing_on", "0");
+
+	irqs_valid &= (irqstat_read(irqs_after, nr_cpus) == 0);
+	for (idx = 0; idx < nr_states; idx++) {
+		struct cpu_state_t *const state = &states[idx];
+		uint64_t smis;
+		size_t gap;
+
+		if (irqs_valid)
+			state->irqs = irqs_after[state->cpu] -
+				irqs_before[state->cpu];
+		if (state->smis_valid) {
+			state->smis_valid =
+				(irqstat_read_smi(state->cpu, &smis) == 0);
+			state->smis = smis - state->smis;
+		}
+
+		classify_gaps(state);
+		for (gap = 0; gap < state->nr_gaps; gap++)
+			state->nr_class[state->gaps[gap].class]++;
+		state->nr_class[gap_unknown] += state->dropped;
+	}
+
+	print_results(states, nr_states);
+
+	if (option_output != NULL) {
+		FILE *const report = report_open(option_output, "rtgap");
+
+		report_results(report, states, nr_states);
+		report_close(report);
+	}
+
+	trace_cleanup();
+
+	for (idx = 0; idx < nr_states; idx++) {
+		free(states[idx].gaps);
+		histogram_destroy(&states[idx].hist);
+	}
+	free(states);
+	free(irqs_before);
+	free(irqs_after);
+	bitmap_free(rt_mask);
+
+	return 0;
+}
@@ -0,0 +1,969 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "bitmap.h"
+#include "histogram.h"
+#include "probe.h"
+#include "report.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_DURATION_S 10
+#define DEFAULT_INTERVAL_US 1000
+#define DEFAULT_RESOLUTION_NS 1000
+#define DEFAULT_MAX_LATENCY_US 1000
+#define DEFAULT_PRIORITY 80
+#define DEFAULT_PHASE "run"
+#define DEFAULT_RT_PARTITION "rt"
+#define DEFAULT_NRT_PARTITION "nrt"
+/* Below $PARTRT_SYSROOT, like in the partrt script */
+#define PARTRT_SETTINGS_FILE "/tmp/partrt_env"
+
+/* Size of the buffer each memory noise thread keeps rewriting. Should be
+ * larger than the last level cache. */
+#define NOISE_MEM_SIZE (32 * 1024 * 1024)
+#define CACHE_LINE_SIZE 64
+
+enum probe_type_t {
+	probe_timer,
+	probe_busy,
+	nr_probe_types
+};
+
+static const char *const probe_names[nr_probe_types] = {
+	"timer",
+	"busy"
+};
+
+enum noise_type_t {
+	noise_cpu,
+	noise_mem,
+	noise_syscall,
+	nr_noise_types
+};
+
+static const char *const noise_names[nr_noise_types] = {
+	"cpu",
+	"mem",
+	"syscall"
+};
+
+struct probe_thread_t {
+	pthread_t thread;
+	int cpu;
+	enum probe_type_t type;
+	const char *cpuset;
+	struct histogram_t hist;
+};
+
+struct noise_thread_t {
+	pthread_t thread;
+	int cpu;
+	enum noise_type_t type;
+	const char *cpuset;
+};
+
+/* Result of one measurement phase */
+struct phase_t {
+	const char *name;
+	struct probe_thread_t *probes;
+	size_t nr_probes;
+};
+
+static uint64_t option_duration_ns = DEFAULT_DURATION_S * NSEC_PER_SEC;
+static uint64_t option_interval_ns = DEFAULT_INTERVAL_US * NSEC_PER_USEC;
+static uint64_t option_resolution_ns = DEFAULT_RESOLUTION_NS;
+static uint64_t option_max_latency_ns = DEFAULT_MAX_LATENCY_US * NSEC_PER_USEC;
+static int option_priority = DEFAULT_PRIORITY;
+static int option_mlock = 1;
+static int option_probe[nr_probe_types] = { 1, 1 };
+static unsigned option_noise[nr_noise_types];
+static const char *option_phase = DEFAULT_PHASE;
+static const char *option_cpuset = NULL;
+static const char *option_output = NULL;
+static const char *option_partrt = NULL;
+
+static pthread_barrier_t start_barrier;
+static int noise_stop;
+
+/* "partrt undo" command, set while the system is partitioned by --partrt */
+static char *partrt_undo = NULL;
+
+static unsigned long str_to_ulong(const char *value, const char *what)
+{
+	char *check;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(value, &check, 0);
+	if ((value[0] == '\0') || (check[0] != '\0') || (errno != 0))
+		fail("'%s': Not a valid %s", value, what);
+
+	return val;
+}
+
+/* Parse noise specification "<type>[:<threads>],..." */
+static void parse_noise(const char *spec)
+{
+	char *str = strdup(spec);
+	char *token;
+	char *saveptr;
+
+	if (str == NULL)
+		fail("Out of memory, aborting");
+
+	parse_scope = "noise specification";
+
+	for (token = strtok_r(str, ",", &saveptr); token != NULL;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		char *count = strchr(token, ':');
+		unsigned threads = 1;
+		int type;
+
+		if (count != NULL) {
+			*count++ = '\0';
+			threads = (unsigned) str_to_ulong(count, "thread count");
+		}
+
+		if (strcmp(token, "none") == 0) {
+			memset(option_noise, 0, sizeof(option_noise));
+			continue;
+		}
+
+		for (type = 0; type < nr_noise_types; type++)
+			if (strcmp(token, noise_names[type]) == 0)
+				break;
+
+		if (type == nr_noise_types)
+			fail("%s: Unknown noise type", token);
+
+		option_noise[type] = threads;
+	}
+
+	parse_scope = NULL;
+	free(str);
+}
+
+static void parse_probes(const char *spec)
+{
+	if (strcmp(spec, "both") == 0) {
+		option_probe[probe_timer] = 1;
+		option_probe[probe_busy] = 1;
+	} else if (strcmp(spec, probe_names[probe_timer]) == 0) {
+		option_probe[probe_timer] = 1;
+		option_probe[probe_busy] = 0;
+	} else if (strcmp(spec, probe_names[probe_busy]) == 0) {
+		option_probe[probe_timer] = 0;
+		option_probe[probe_busy] = 1;
+	} else {
+		fail("%s: Unknown probe, must be one of 'timer', 'busy' and 'both'",
+		     spec);
+	}
+}
+
+/*
+ * Measurement threads
+ */
+
+/* Wake up periodically using an absolute timer, record the wake-up
+ * latency. */
+static void run_timer_probe(struct probe_thread_t *probe)
+{
+	uint64_t next = probe_now_ns() + option_interval_ns;
+	const uint64_t end = next + option_duration_ns;
+	struct timespec ts;
+
+	while (next < end) {
+		uint64_t now;
+		int status;
+
+		probe_ns_to_timespec(next, &ts);
+		status = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					 NULL);
+		if ((status != 0) && (status != EINTR))
+			fail("CPU %d: clock_nanosleep(): %s", probe->cpu,
+			     strerror(status));
+
+		now = probe_now_ns();
+		histogram_add(&probe->hist, now - next);
+
+		/* Skip periods that were missed completely */
+		do {
+			next += option_interval_ns;
+		} while (next <= now);
+	}
+}
+
+/* Read the clock as fast as possible, record the time between each read.
+ * Anything that steals the CPU shows up as a large gap. */
+static void run_busy_probe(struct probe_thread_t *probe)
+{
+	uint64_t prev = probe_now_ns();
+	const uint64_t end = prev + option_duration_ns;
+
+	while (prev < end) {
+		const uint64_t now = probe_now_ns();
+
+		histogram_add(&probe->hist, now - prev);
+		prev = now;
+	}
+}
+
+static void *probe_main(void *arg)
+{
+	struct probe_thread_t *const probe = arg;
+
+	if (probe->cpuset != NULL)
+		probe_place_in_cpuset(probe->cpuset);
+	probe_pin_to_cpu(probe->cpu);
+	if (probe->type == probe_timer)
+		probe_set_fifo(option_priority);
+	probe_prefault_stack();
+
+	pthread_barrier_wait(&start_barrier);
+
+	if (probe->type == probe_timer)
+		run_timer_probe(probe);
+	else
+		run_busy_probe(probe);
+
+	return NULL;
+}
+
+static void *noise_main(void *arg)
+{
+	struct noise_thread_t *const noise = arg;
+	volatile uint64_t sink = 0;
+	char *buf;
+	size_t idx;
+
+	if (noise->cpuset != NULL)
+		probe_place_in_cpuset(noise->cpuset);
+	probe_pin_to_cpu(noise->cpu);
+
+	switch (noise->type) {
+	case noise_cpu:
+		while (!__atomic_load_n(&noise_stop, __ATOMIC_RELAXED))
+			sink = sink * 6364136223846793005ULL + 1;
+		break;
+	case noise_mem:
+		buf = checked_malloc(NOISE_MEM_SIZE);
+		while (!__atomic_load_n(&noise_stop, __ATOMIC_RELAXED))
+			for (idx = 0; idx < NOISE_MEM_SIZE; idx += CACHE_LINE_SIZE)
+				buf[idx]++;
+		free(buf);
+		break;
+	case noise_syscall:
+		while (!__atomic_load_n(&noise_stop, __ATOMIC_RELAXED))
+			syscall(SYS_getppid);
+		break;
+	case nr_noise_types:
+		break;
+	}
+
+	return NULL;
+}
+
+static void start_thread(pthread_t *thread, void *(*func) (void *),
+			 void *arg)
+{
+	pthread_attr_t attr;
+	int status;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PROBE_STACK_SIZE);
+	status = pthread_create(thread, &attr, func, arg);
+	if (status != 0)
+		fail("Could not create thread: %s", strerror(status));
+	pthread_attr_destroy(&attr);
+}
+
+static void join_thread(pthread_t thread)
+{
+	const int status = pthread_join(thread, NULL);
+
+	if (status != 0)
+		fail("Could not join thread: %s", strerror(status));
+}
+
+/*
+ * Phase handling
+ */
+
+static size_t mask_cpus(const struct bitmap_t *mask, int nr_cpus, int *cpus)
+{
+	size_t nr = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		if (bitmap_isset((size_t) cpu, mask))
+			cpus[nr++] = cpu;
+
+	return nr;
+}
+
+static void run_phase(struct phase_t *phase, const int *rt_cpus,
+		      size_t nr_rt_cpus, const int *nrt_cpus,
+		      size_t nr_nrt_cpus, const char *probe_cpuset,
+		      const char *noise_cpuset)
+{
+	struct noise_thread_t *noise;
+	size_t nr_noise = 0;
+	size_t idx;
+	int type;
+
+	info("%s: Starting phase", phase->name);
+
+	for (type = 0; type < nr_noise_types; type++)
+		nr_noise += option_noise[type];
+	noise = checked_malloc((nr_noise + 1) * sizeof(*noise));
+
+	phase->nr_probes = 0;
+	phase->probes = checked_malloc(nr_probe_types * nr_rt_cpus *
+				       sizeof(*phase->probes));
+
+	/* Spread noise threads round-robin over the non-RT CPUs */
+	__atomic_store_n(&noise_stop, 0, __ATOMIC_RELAXED);
+	idx = 0;
+	for (type = 0; type < nr_noise_types; type++) {
+		unsigned nr;
+
+		for (nr = 0; nr < option_noise[type]; nr++, idx++) {
+			noise[idx].cpu = nrt_cpus[idx % nr_nrt_cpus];
+			noise[idx].type = (enum noise_type_t) type;
+			noise[idx].cpuset = noise_cpuset;
+			debug("CPU %d: Starting %s noise", noise[idx].cpu,
+			      noise_names[type]);
+			start_thread(&noise[idx].thread, noise_main,
+				     &noise[idx]);
+		}
+	}
+
+	/* Run one probe type at a time, so they do not disturb each other */
+	for (type = 0; type < nr_probe_types; type++) {
+		struct probe_thread_t *const probes =
+			&phase->probes[phase->nr_probes];
+
+		if (!option_probe[type])
+			continue;
+
+		info("%s: Running %s probe on %zu CPU%s", phase->name,
+		     probe_names[type], nr_rt_cpus,
+		     (nr_rt_cpus == 1) ? "" : "s");
+
+		pthread_barrier_init(&start_barrier, NULL,
+				     (unsigned) nr_rt_cpus);
+		for (idx = 0; idx < nr_rt_cpus; idx++) {
+			probes[idx].cpu = rt_cpus[idx];
+			probes[idx].type = (enum probe_type_t) type;
+			probes[idx].cpuset = probe_cpuset;
+			histogram_init(&probes[idx].hist, option_resolution_ns,
+				       (size_t) (option_max_latency_ns /
+						 option_resolution_ns));
+			start_thread(&probes[idx].thread, probe_main,
+				     &probes[idx]);
+		}
+		for (idx = 0; idx < nr_rt_cpus; idx++)
+			join_thread(probes[idx].thread);
+		pthread_barrier_destroy(&start_barrier);
+
+		phase->nr_probes += nr_rt_cpus;
+	}
+
+	__atomic_store_n(&noise_stop, 1, __ATOMIC_RELAXED);
+	for (idx = 0; idx < nr_noise; idx++)
+		join_thread(noise[idx].thread);
+	free(noise);
+}
+
+static void free_phase(struct phase_t *phase)
+{
+	size_t idx;
+
+	for (idx = 0; idx < phase->nr_probes; idx++)
+		histogram_destroy(&phase->probes[idx].hist);
+	free(phase->probes);
+}
+
+static void print_phase(const struct phase_t *phase)
+{
+	size_t idx;
+
+	printf("%-8s %4s %-6s %12s %9s %9s %9s %11s %11s\n",
+	       "Phase", "CPU", "Probe", "Samples", "Avg(ns)", "P99(ns)",
+	       "P99.9(ns)", "P99.99(ns)", "Max(ns)");
+	for (idx = 0; idx < phase->nr_probes; idx++) {
+		const struct probe_thread_t *const probe = &phase->probes[idx];
+		const struct histogram_t *const hist = &probe->hist;
+
+		printf("%-8s %4d %-6s %12llu %9llu %9llu %9llu %11llu %11llu\n",
+		       phase->name, probe->cpu, probe_names[probe->type],
+		       (unsigned long long) hist->samples,
+		       (unsigned long long) histogram_avg(hist),
+		       (unsigned long long) histogram_percentile(hist, 0.99),
+		       (unsigned long long) histogram_percentile(hist, 0.999),
+		       (unsigned long long) histogram_percentile(hist, 0.9999),
+		       (unsigned long long) hist->max_ns);
+	}
+}
+
+static double percent_change(uint64_t before, uint64_t after)
+{
+	if (before == 0)
+		return 0.0;
+
+	return 100.0 * ((double) after - (double) before) / (double) before;
+}
+
+/* Both phases were run with identical CPU and probe setup, so entries with
+ * the same index can be compared directly. */
+static void print_comparison(const struct phase_t *before,
+			     const struct phase_t *after)
+{
+	size_t idx;
+
+	printf("\n%4s %-6s %11s %11s %8s %11s %11s %8s\n",
+	       "CPU", "Probe", "P99.99 pre", "P99.99 post", "Change",
+	       "Max pre", "Max post", "Change");
+	for (idx = 0; idx < before->nr_probes; idx++) {
+		const struct histogram_t *const pre = &before->probes[idx].hist;
+		const struct histogram_t *const post = &after->probes[idx].hist;
+		const uint64_t pre_p = histogram_percentile(pre, 0.9999);
+		const uint64_t post_p = histogram_percentile(post, 0.9999);
+
+		printf("%4d %-6s %11llu %11llu %7.1f%% %11llu %11llu %7.1f%%\n",
+		       before->probes[idx].cpu,
+		       probe_names[before->probes[idx].type],
+		       (unsigned long long) pre_p,
+		       (unsigned long long) post_p,
+		       percent_change(pre_p, post_p),
+		       (unsigned long long) pre->max_ns,
+		       (unsigned long long) post->max_ns,
+		       percent_change(pre->max_ns, post->max_ns));
+	}
+}
+
+static void report_phase(FILE *report, const struct phase_t *phase)
+{
+	size_t idx;
+
+	for (idx = 0; idx < phase->nr_probes; idx++)
+		report_histogram(report, phase->name, phase->probes[idx].cpu,
+				 probe_names[phase->probes[idx].type],
+				 &phase->probes[idx].hist);
+}
+
+static void run_partrt(const char *command)
+{
+	int status;
+
+	info("Executing: %s", command);
+	status = system(command);
+	if (status == -1)
+		fail("%s: Could not execute: %s", command, strerror(errno));
+	if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		fail("%s: Command failed", command);
+}
+
+/* Undo the partitioning, once, whether rtjitter finishes, fails or is
+ * interrupted. Returns -1 if the undo failed. Also runs from exit(), so
+ * it must not call fail(). */
+static int partrt_undo_once(void)
+{
+	char *const command = __atomic_exchange_n(&partrt_undo, NULL,
+						  __ATOMIC_SEQ_CST);
+	int status;
+
+	if (command == NULL)
+		return 0;
+
+	info("Executing: %s", command);
+	status = system(command);
+	if ((status == -1) || !WIFEXITED(status) ||
+	    (WEXITSTATUS(status) != 0)) {
+		fprintf(stderr, "%s: Command failed, the system is still "
+			"partitioned\n", command);
+		status = -1;
+	} else {
+		status = 0;
+	}
+	free(command);
+
+	return status;
+}
+
+static void partrt_cleanup(void)
+{
+	partrt_undo_once();
+}
+
+/* Signals that would end rtjitter without running exit handlers */
+static void partrt_signals(sigset_t *set)
+{
+	sigemptyset(set);
+	sigaddset(set, SIGINT);
+	sigaddset(set, SIGTERM);
+	sigaddset(set, SIGHUP);
+}
+
+static void *partrt_signal_main(void *arg)
+{
+	sigset_t set;
+	int sig;
+
+	(void) arg;
+	partrt_signals(&set);
+	if (sigwait(&set, &sig) != 0)
+		return NULL;
+
+	partrt_undo_once();
+	_exit(128 + sig);
+}
+
+/* Run "partrt create", and make sure "partrt undo" runs afterwards. The
+ * signals are blocked in every thread started later, and taken by a
+ * thread that undoes the partitioning before exiting. */
+static void partrt_create(const char *options, const char *rt_mask)
+{
+	const char *root = getenv("PARTRT_SYSROOT");
+	pthread_t thread;
+	sigset_t set;
+	char *command;
+	int status;
+
+	if (root == NULL)
+		root = "";
+
+	if (asprintf(&command, "partrt create %s %s", options, rt_mask) == -1)
+		fail("Out of memory, aborting");
+	run_partrt(command);
+	free(command);
+
+	if (asprintf(&partrt_undo, "partrt undo -s %s" PARTRT_SETTINGS_FILE,
+		     root) == -1)
+		fail("Out of memory, aborting");
+	atexit(partrt_cleanup);
+
+	partrt_signals(&set);
+	status = pthread_sigmask(SIG_BLOCK, &set, NULL);
+	if (status != 0)
+		fail("Could not block signals: %s", strerror(status));
+	start_thread(&thread, partrt_signal_main, NULL);
+}
+
+/*****************************************************************************
+ * This is the man page using POD text format.
+ *
+ * For syntax description:
+ *     http://perldoc.perl.org/perlpod.html
+
+=head1 NAME
+
+rtjitter - measure scheduling jitter on real-time CPUs
+
+=head1 SYNOPSIS
+
+rtjitter [options] <rt cpumask>
+
+=head1 DESCRIPTION
+
+rtjitter validates a CPU partition by measuring how much the CPUs in
+B<rt cpumask> are disturbed. For each CPU, two probes are run, one after the
+other:
+
+B<timer> is a SCHED_FIFO thread that wakes up periodically using an absolute
+timer, and records how late each wake-up was.
+
+B<busy> is a SCHED_OTHER thread that reads the clock in a tight loop, and
+records the time between each read. Anything that steals the CPU from the
+thread, be it interrupts, ticks or other tasks, shows up as a large gap.
+
+All memory is locked and pre-faulted before measurements start. The results
+are recorded in per-CPU histograms, and average, maximum and percentiles are
+printed when the measurements are done.
+
+While measuring, rtjitter can generate noise on the non-real-time CPUs, to
+show whether the real-time CPUs are shielded from it.
+
+=head1 OPTIONS
+
+B<-d, --duration=SECONDS>
+       Run each probe for SECONDS seconds. Default: 10
+
+B<-i, --interval=USEC>
+       Wake-up period for the timer probe. Default: 1000
+
+B<-R, --resolution=NSEC>
+       Histogram bucket width. Default: 1000
+
+B<-m, --max-latency=USEC>
+       Latencies above this are counted as overflow in the histogram, but
+       are still part of maximum and average. Default: 1000
+
+B<-p, --priority=PRIO>
+       SCHED_FIFO priority of the timer probe, 0 means SCHED_OTHER.
+       Default: 80
+
+B<-P, --probe=PROBE>
+       Run only the given probe. One of 'timer', 'busy' and 'both'.
+       Default: 'both'
+
+B<-N, --noise=SPEC>
+       Generate noise on the non-real-time CPUs. SPEC is a comma separated
+       list of TYPE[:THREADS], where TYPE is one of 'cpu' (spinning),
+       'mem' (streaming writes to a buffer larger than the cache) and
+       'syscall' (system calls in a loop), or 'none'. Default: 'none'
+
+B<-n, --nrt=MASK>
+       CPUs to run noise on. Default: all CPUs not in B<rt cpumask>
+
+B<-c, --cpuset=NAME>
+       Move the probe threads into cpuset NAME before measuring.
+
+B<-L, --no-mlock>
+       Do not lock memory. Mostly useful for testing.
+
+B<-o, --output=FILE>
+       Write results in rtreport format to FILE, '-' means stdout.
+
+B<-l, --label=NAME>
+       Name of the measurement phase in the output. Default: 'run'
+
+B<--partrt[=OPTIONS]>
+       Measure before and after partitioning. rtjitter first measures on
+       the unpartitioned system, then runs "partrt create OPTIONS <rt cpumask>",
+       measures again with probes in the "rt" partition and noise in the
+       "nrt" partition, and finally runs "partrt undo". The undo also runs
+       when the second measurement fails or rtjitter is interrupted with
+       SIGINT, SIGTERM or SIGHUP. The settings file is looked for below
+       $PARTRT_SYSROOT when it is set. The two phases are called "before"
+       and "after", and a comparison is printed at the end.
+
+B<-v, --verbose>
+       Produce informational message to stderr
+
+B<-V, --version>
+       Show version information and exit
+
+B<-h, --help>
+       Show help text and exit
+
+=head1 EXAMPLE
+
+B<rtjitter --partrt --noise=mem:2,syscall 0xc>
+
+Compare jitter on CPU 2 and 3 before and after "partrt create 0xc", with
+memory and system call noise on the remaining CPUs.
+
+B<partrt run rt rtjitter -d 60 -o after.txt 0xc>
+
+Measure for a minute within an already created partition, and save the
+result.
+
+=head1 AUTHOR
+
+Enea Software AB
+
+=head1 REPORTING BUGS
+
+Report bugs to openenealinux@lists.openenealinux.org
+
+=head1 COPYRIGHT
+
+Copyright (c) 2014 by Enea Software AB
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Enea Software AB nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=cut
+
+*****************************************************************************/
+
+static void usage(void)
+{
+	puts("rtjitter - Measure scheduling jitter on real-time CPUs\n"
+	     "Usage:\n"
+	     "rtjitter [options] <rt cpumask>\n"
+	     "\n"
+	     "Runs a timer wake-up probe and a busy-poll probe on each CPU in the\n"
+	     "hexadecimal <rt cpumask>, and prints latency statistics per CPU.\n"
+	     "\n"
+	     "Options:\n"
+	     "-d, --duration=<s>      Run each probe for <s> seconds. Default: 10\n"
+	     "-i, --interval=<us>     Timer probe period. Default: 1000\n"
+	     "-R, --resolution=<ns>   Histogram bucket width. Default: 1000\n"
+	     "-m, --max-latency=<us>  Histogram range. Default: 1000\n"
+	     "-p, --priority=<prio>   SCHED_FIFO priority of timer probe, 0 for\n"
+	     "                        SCHED_OTHER. Default: 80\n"
+	     "-P, --probe=<probe>     One of 'timer', 'busy' and 'both'.\n"
+	     "                        Default: 'both'\n"
+	     "-N, --noise=<spec>      Noise on non-RT CPUs, comma separated list of\n"
+	     "                        <type>[:<threads>], where <type> is one of\n"
+	     "                        'cpu', 'mem', 'syscall' and 'none'.\n"
+	     "-n, --nrt=<cpumask>     CPUs for noise. Default: all but <rt cpumask>\n"
+	     "-c, --cpuset=<name>     Move probe threads into cpuset <name>.\n"
+	     "-L, --no-mlock          Do not lock memory.\n"
+	     "-o, --output=<file>     Write rtreport to <file>, '-' means stdout.\n"
+	     "-l, --label=<name>      Phase name in output. Default: 'run'\n"
+	     "--partrt[=<options>]    Measure before and after\n"
+	     "                        'partrt create <options> <rt cpumask>'.\n"
+	     "-v, --verbose           Produce informational message to stderr. Can be\n"
+	     "                        given multiple times for more verbosity.\n"
+	     "-V, --version           Show version information and exit.\n"
+	     "-h, --help              Print this help text and exit.\n"
+	     "\n"
+	     "Example:\n"
+	     "   rtjitter --partrt --noise=mem:2 0xc\n");
+}
+
+static void version(void)
+{
+	printf("rtjitter %d.%d\n"
+	       "\n"
+	       "Copyright (C) 2014 by Enea Software AB.\n"
+	       "This is free software; see the source for copying conditions.  There is NO\n"
+	       "warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE,\n"
+	       "to the extent permitted by law.\n",
+	       rtbench_VERSION_MAJOR, rtbench_VERSION_MINOR);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"version", no_argument, NULL, 'V'},
+		{"duration", required_argument, NULL, 'd'},
+		{"interval", required_argument, NULL, 'i'},
+		{"resolution", required_argument, NULL, 'R'},
+		{"max-latency", required_argument, NULL, 'm'},
+		{"priority", required_argument, NULL, 'p'},
+		{"probe", required_argument, NULL, 'P'},
+		{"noise", required_argument, NULL, 'N'},
+		{"nrt", required_argument, NULL, 'n'},
+		{"cpuset", required_argument, NULL, 'c'},
+		{"no-mlock", no_argument, NULL, 'L'},
+		{"output", required_argument, NULL, 'o'},
+		{"label", required_argument, NULL, 'l'},
+		{"partrt", optional_argument, NULL, 'X'},
+		{NULL, 0, NULL, '\0'}
+	};
+	static const char short_options[] = "hvVd:i:R:m:p:P:N:n:c:Lo:l:";
+	const int nr_cpus = probe_nr_cpus();
+	const char *option_nrt = NULL;
+	struct bitmap_t *rt_mask;
+	struct bitmap_t *nrt_mask;
+	int *rt_cpus;
+	int *nrt_cpus;
+	size_t nr_rt_cpus;
+	size_t nr_nrt_cpus;
+	size_t nr_noise = 0;
+	struct phase_t phases[2];
+	size_t nr_phases;
+	size_t idx;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_options, long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage();
+			return 0;
+		case 'V':
+			version();
+			return 0;
+		case 'v':
+			option_verbose++;
+			break;
+		case 'd':
+			option_duration_ns = str_to_ulong(optarg, "duration") *
+				NSEC_PER_SEC;
+			break;
+		case 'i':
+			option_interval_ns = str_to_ulong(optarg, "interval") *
+				NSEC_PER_USEC;
+			break;
+		case 'R':
+			option_resolution_ns = str_to_ulong(optarg, "resolution");
+			break;
+		case 'm':
+			option_max_latency_ns = str_to_ulong(optarg, "latency") *
+				NSEC_PER_USEC;
+			break;
+		case 'p':
+			option_priority = (int) str_to_ulong(optarg, "priority");
+			break;
+		case 'P':
+			parse_probes(optarg);
+			break;
+		case 'N':
+			parse_noise(optarg);
+			break;
+		case 'n':
+			option_nrt = optarg;
+			break;
+		case 'c':
+			option_cpuset = optarg;
+			break;
+		case 'L':
+			option_mlock = 0;
+			break;
+		case 'o':
+			option_output = optarg;
+			break;
+		case 'l':
+			option_phase = optarg;
+			break;
+		case 'X':
+			option_partrt = (optarg != NULL) ? optarg : "";
+			break;
+		case '?':
+			exit(1);
+		default:
+			fail("Internal error: '-%c': Switch accepted but not implemented\n", c);
+		}
+	}
+
+	if (optind >= argc)
+		fail("Missing mandatory RT cpumask");
+	if (optind + 1 < argc)
+		fail("%s: Unexpected argument", argv[optind + 1]);
+	if ((option_resolution_ns == 0) || (option_interval_ns == 0))
+		fail("Resolution and interval must be larger than zero");
+	if (option_max_latency_ns < option_resolution_ns)
+		fail("Max latency must be at least one histogram bucket");
+
+	parse_scope = "RT cpumask";
+	rt_mask = bitmap_alloc_from_u32_list(argv[optind]);
+	parse_scope = NULL;
+
+	if (option_nrt != NULL) {
+		parse_scope = "NRT cpumask";
+		nrt_mask = bitmap_alloc_from_u32_list(option_nrt);
+		parse_scope = NULL;
+	} else {
+		struct bitmap_t *const all = bitmap_alloc_nr_bits((size_t) nr_cpus);
+
+		nrt_mask = bitmap_xor(all, rt_mask);
+		bitmap_free(all);
+	}
+
+	rt_cpus = checked_malloc((size_t) nr_cpus * sizeof(*rt_cpus));
+	nrt_cpus = checked_malloc((size_t) nr_cpus * sizeof(*nrt_cpus));
+	nr_rt_cpus = mask_cpus(rt_mask, nr_cpus, rt_cpus);
+	nr_nrt_cpus = mask_cpus(nrt_mask, nr_cpus, nrt_cpus);
+
+	if (nr_rt_cpus == 0)
+		fail("%s: No existing CPU in RT cpumask", argv[optind]);
+	if (nr_rt_cpus != bitmap_bit_count(rt_mask))
+		fail("%s: RT cpumask contains CPUs that do not exist",
+		     argv[optind]);
+
+	for (c = 0; c < nr_noise_types; c++)
+		nr_noise += option_noise[c];
+	if ((nr_noise > 0) && (nr_nrt_cpus == 0))
+		fail("Noise requested, but there are no non-RT CPUs to run it on");
+
+	if (option_mlock)
+		probe_lock_memory();
+
+	if (option_partrt != NULL) {
+		phases[0].name = "before";
+		run_phase(&phases[0], rt_cpus, nr_rt_cpus, nrt_cpus,
+			  nr_nrt_cpus, option_cpuset, NULL);
+
+		partrt_create(option_partrt, argv[optind]);
+
+		phases[1].name = "after";
+		run_phase(&phases[1], rt_cpus, nr_rt_cpus, nrt_cpus,
+			  nr_nrt_cpus, DEFAULT_RT_PARTITION,
+			  DEFAULT_NRT_PARTITION);
+
+		if (partrt_undo_once() == -1)
+			fail("Could not undo the partitioning");
+		nr_phases = 2;
+	} else {
+		phases[0].name = option_phase;
+		run_phase(&phases[0], rt_cpus, nr_rt_cpus, nrt_cpus,
+			  nr_nrt_cpus, option_cpuset, NULL);
+		nr_phases = 1;
+	}
+
+	for (idx = 0; idx < nr_phases; idx++)
+		print_phase(&phases[idx]);
+	if (nr_phases == 2)
+		print_comparison(&phases[0], &phases[1]);
+
+	if (option_output != NULL) {
+		FILE *const report = report_open(option_output, "rtjitter");
+
+		for (idx = 0; idx < nr_phases; idx++)
+			report_phase(report, &phases[idx]);
+		report_close(report);
+	}
+
+	for (idx = 0; idx < nr_phases; idx++)
+		free_phase(&phases[idx]);
+	free(rt_cpus);
+	free(nrt_cpus);
+	bitmap_free(rt_mask);
+	bitmap_free(nrt_mask);
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements tracefs helpers.
+ */
+
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "tracefs.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *const tracefs_candidates[] = {
+	"/sys/kernel/tracing",
+	"/sys/kernel/debug/tracing"
+};
+
+const char *tracefs_root(void)
+{
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(tracefs_candidates) / sizeof(tracefs_candidates[0]); idx++) {
+		char path[128];
+
+		snprintf(path, sizeof(path), "%s/trace", tracefs_candidates[idx]);
+		if (access(path, F_OK) == 0)
+			return tracefs_candidates[idx];
+	}
+
+	return NULL;
+}
+
+char *tracefs_instance_create(const char *root, const char *name)
+{
+	char *instance;
+
+	if (asprintf(&instance, "%s/instances/%s", root, name) == -1)
+		fail("Out of memory, aborting");
+
+	if (mkdir(instance, 0755) == -1) {
+		info("%s: Could not create trace instance: %s", instance,
+		     strerror(errno));
+		free(instance);
+		return NULL;
+	}
+
+	return instance;
+}
+
+void tracefs_instance_remove(char *instance)
+{
+	if (rmdir(instance) == -1)
+		info("%s: Could not remove trace instance: %s", instance,
+		     strerror(errno));
+	free(instance);
+}
+
+int tracefs_write(const char *dir, const char *file, const char *value)
+{
+	char path[256];
+	FILE *stream;
+	int saved_errno;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+	stream = fopen(path, "w");
+	if (stream == NULL) {
+		debug("%s: Could not open: %s", path, strerror(errno));
+		return -1;
+	}
+
+	if ((fputs(value, stream) == EOF) | (fclose(stream) == EOF)) {
+		saved_errno = errno;
+		debug("%s: Could not write '%s': %s", path, value,
+		      strerror(errno));
+		errno = saved_errno;
+		return -1;
+	}
+
+	debug("echo %s > %s", value, path);
+
+	return 0;
+}
+
+/* Parse "<seconds>.<fraction>:" into nanoseconds. Returns the number of
+ * characters consumed, 0 if str does not start with a timestamp. */
+static size_t parse_timestamp(const char *str, uint64_t *ts_ns)
+{
+	const char *curr = str;
+	uint64_t sec = 0;
+	uint64_t frac = 0;
+	uint64_t scale = 1000000000ULL;
+
+	if (!isdigit((unsigned char) *curr))
+		return 0;
+	while (isdigit((unsigned char) *curr))
+		sec = sec * 10 + (uint64_t) (*curr++ - '0');
+
+	if (*curr++ != '.')
+		return 0;
+	while (isdigit((unsigned char) *curr)) {
+		if (scale > 1) {
+			scale /= 10;
+			frac += (uint64_t) (*curr - '0') * scale;
+		}
+		curr++;
+	}
+
+	if (*curr++ != ':')
+		return 0;
+
+	*ts_ns = sec * 1000000000ULL + frac;
+
+	return (size_t) (curr - str);
+}
+
+int tracefs_parse_line(const char *line, uint64_t *ts_ns, char *event,
+		       size_t event_size)
+{
+	const char *curr;
+	size_t len;
+
+	if (line[0] == '#')
+		return 0;
+
+	/* Everything up to the CPU field, e.g. "<idle>-0 [003]", may
+	 * contain arbitrary characters from the task name. */
+	curr = strstr(line, "] ");
+	if (curr == NULL)
+		return 0;
+	curr += 2;
+
+	/* Skip optional irq-info flags, find the timestamp */
+	for (;;) {
+		while (*curr == ' ')
+			curr++;
+		if (*curr == '\0')
+			return 0;
+		len = parse_timestamp(curr, ts_ns);
+		if (len > 0)
+			break;
+		curr += strcspn(curr, " ");
+	}
+	curr += len;
+
+	while (*curr == ' ')
+		curr++;
+
+	len = strcspn(curr, ": ");
+	if ((curr[len] != ':') || (len == 0))
+		return 0;
+	if (len >= event_size)
+		len = event_size - 1;
+	memcpy(event, curr, len);
+	event[len] = '\0';
+
+	return 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014 by Enea Software AB
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Enea Software AB nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRACEFS_H
+#define TRACEFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Helpers for using ftrace through tracefs.
+ */
+
+/* Return the tracefs mount point, or NULL if tracefs is not available.
+ * /sys/kernel/tracing is preferred over the debugfs location. */
+extern const char *tracefs_root(void);
+
+/* Create trace instance <root>/instances/<name>, and return its malloc'ed
+ * path, or NULL if it could not be created. */
+extern char *tracefs_instance_create(const char *root, const char *name);
+
+/* Remove a trace instance, and free the path */
+extern void tracefs_instance_remove(char *instance);
+
+/* Write value to <dir>/<file>. Returns 0 on success, otherwise -1 with
+ * errno set. */
+extern int tracefs_write(const char *dir, const char *file, const char *value);
+
+/* Parse one line of trace output. On success 1 is returned, the event time
+ * is stored in ts_ns, and the event name, without trailing ':', in event.
+ * Comments and lines that cannot be parsed give 0. */
+extern int tracefs_parse_line(const char *line, uint64_t *ts_ns,
+			      char *event, size_t event_size);
+
+#endif